@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
@@ -16,12 +17,17 @@
 #include "driver/dac_continuous.h"
 #include <codec_manager.hh>
 #include <common.hh>
+#include "mixer.hh"
+#include "resampler.hh"
+#include "stream_source.hh"
+#include "synth.hh"
 
 #define MINIMP3_ONLY_MP3
-#define MINIMP3_NO_SIMD
+#define MINIMP3_NO_SIMD //the scalar path of the ESP32 targets, also on the host (see host_test/minimp3_bench.cc)
 #define MINIMP3_NONSTANDARD_BUT_LOGICAL
 #define MINIMP3_IMPLEMENTATION
 #include "minimp3.h"
+#include "mp3_index.hh"
 
 // https://voicemaker.in/
 // Neural TTS, German, Katja, 24000Hz, VoiceSpeed+20%
@@ -37,8 +43,9 @@ namespace AudioPlayer
 
         constexpr size_t FRAME_MAX_SIZE_BYTES = 1024;
         constexpr size_t HEADER_LENGTH_BYTES = 4;
-        constexpr uint8_t SYNCWORDH = 0xff;
-        constexpr uint8_t SYNCWORDL = 0xf0;
+
+        constexpr size_t INDEX_CACHE_SIZE = 4; //number of files, whose frame index is kept; 4 bytes per frame each, about 90KB per 10 minutes of MP3
+        constexpr uint32_t SEEK_PREROLL_FRAMES = 2; //decoded and dropped before a seek position to refill the bit reservoir and the filterbank
     }
 
     enum class AudioType
@@ -47,7 +54,123 @@ namespace AudioPlayer
         MP3,
         PCM,
         VOLTAGE, //for future use
-        SYNTHESIZER, // for future use
+        SYNTHESIZER, // note sequence, rendered by the Synthesizer
+        MP3_STREAM, // MP3 read by StreamReader from an iByteSource (SPIFFS file, HTTP)
+    };
+
+    // Decodes an MP3 file from memory frame by frame; used to play MP3 files as overlay on top of the main stream
+    class Mp3Source : public iAudioSource
+    {
+    private:
+        mp3dec_t decoder;
+        const uint8_t *file;
+        size_t fileLen;
+        int32_t frameStart{0};
+        uint32_t sampleRate{0};
+        int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+        size_t pcmFrames{0};
+        size_t pcmPos{0};
+
+        // decodes the next frame into pcm (always stereo)
+        bool DecodeNextFrame(){
+            mp3dec_frame_info_t info = {};
+            while (frameStart < (int32_t)fileLen)
+            {
+                int samples = mp3dec_decode_frame(&decoder, file + frameStart, fileLen - frameStart, pcm, &info);
+                if (info.frame_bytes == 0)
+                    break;
+                frameStart += info.frame_bytes;
+                if (samples == 0)
+                    continue;
+                if (info.channels == 1)
+                {
+                    for (int i = samples - 1; i >= 0; i--)
+                    {
+                        pcm[2 * i] = pcm[2 * i + 1] = pcm[i];
+                    }
+                }
+                pcmFrames = samples;
+                pcmPos = 0;
+                return true;
+            }
+            frameStart = fileLen;
+            return false;
+        }
+
+    public:
+        Mp3Source(const uint8_t *file, size_t fileLen) : file(file), fileLen(fileLen)
+        {
+            Rewind();
+        }
+
+        void SetFile(const uint8_t *file, size_t fileLen){
+            this->file=file;
+            this->fileLen=fileLen;
+            Rewind();
+        }
+
+        // Takes over a running decode (e.g. of the player) at frameStart. With the copied decoder state, bit reservoir and filterbank
+        // continue seamlessly, so the stream can be faded out without a gap
+        void Continue(const uint8_t *file, size_t fileLen, int32_t frameStart, const mp3dec_t &state){
+            this->file=file;
+            this->fileLen=fileLen;
+            this->frameStart=frameStart;
+            decoder=state;
+            pcmFrames = pcmPos = 0;
+            if(frameStart+HDR_SIZE<=(int32_t)fileLen && hdr_valid(file+frameStart)){
+                sampleRate = hdr_sample_rate_hz(file+frameStart);
+            }else{
+                this->frameStart=fileLen;
+            }
+        }
+
+        void Rewind(){
+            mp3dec_init(&decoder);
+            pcmFrames = pcmPos = 0;
+            frameStart = Mp3Index::FindFrame(file, fileLen, 0);
+            if (frameStart < 0)
+            {
+                frameStart = fileLen;
+                return;
+            }
+            sampleRate = hdr_sample_rate_hz(file + frameStart);
+        }
+
+        uint32_t GetSampleRate() override { return sampleRate; }
+
+        size_t Read(int16_t *buf, size_t frames) override
+        {
+            size_t written = 0;
+            while (written < frames)
+            {
+                if (pcmPos == pcmFrames && !DecodeNextFrame())
+                    break;
+                size_t n = std::min(frames - written, pcmFrames - pcmPos);
+                memcpy(buf + 2 * written, pcm + 2 * pcmPos, n * 2 * sizeof(int16_t));
+                pcmPos += n;
+                written += n;
+            }
+            return written;
+        }
+    };
+
+    enum class Priority : uint8_t
+    {
+        MUSIC,        // played in the order of arrival, paused by announcements
+        ANNOUNCEMENT, // pre-empts music; the interrupted music resumes afterwards
+    };
+
+    constexpr size_t ORDER_QUEUE_LENGTH = 8;
+
+    constexpr uint16_t DEFAULT_RAMP_MS = 10; //gain changes and overlay stops are ramped over this time
+    constexpr uint16_t DUCK_ATTACK_MS = 50;
+    constexpr uint16_t DUCK_RELEASE_MS = 400;
+    constexpr uint16_t DEFAULT_DUCK_GAIN_Q15 = GAIN_UNITY_Q15 / 4; //-12dB
+
+    enum class AnnouncementMode : uint8_t
+    {
+        PREEMPT, // announcements pause the music, it resumes afterwards
+        DUCK,    // MP3 and PCM announcements are mixed on top of the attenuated music; other announcements still pre-empt
     };
 
     struct AudioOrder{
@@ -56,80 +179,498 @@ namespace AudioPlayer
         size_t fileLen;
         uint32_t sampleRate;//0 means "auto detect"
         uint8_t volume;//0 means: do not change volume
-        bool cancelPrevious; //false means: play current AudioOrder to its end
+        bool cancelPrevious; //false means: play current AudioOrder to its end; true means: drop all pending orders of the same priority and start immediately
+        Priority priority{Priority::MUSIC};
+        uint32_t startMs{0}; //MP3 only: start position within the file
+        iByteSource *source{nullptr}; //MP3_STREAM only
+        const Note *notes{nullptr}; //SYNTHESIZER only, terminated by {0,0}
+        const Instrument *instrument{nullptr}; //SYNTHESIZER only
     };
 
     constexpr AudioOrder SILENCE_ORDER{AudioType::SILENCE, nullptr, 0, 0, 0, true};
+    constexpr AudioOrder STOP_ORDER{AudioType::SILENCE, nullptr, 0, 0, 0, true, Priority::ANNOUNCEMENT};
+
+    struct OverlayOrder{
+        iAudioSource *source;
+        uint16_t gainQ15; //GAIN_UNITY_Q15 means 1.0
+        bool stop; //true: remove source from the mixer; in a mixer slot: fading out, removed when silent
+        uint16_t rampMs{0}; //duration of the gain change or the fade out
+    };
 
 
     class Player
     {
     private:
-        QueueHandle_t orderQueue{nullptr};
+        QueueHandle_t musicQueue{nullptr};
+        QueueHandle_t announcementQueue{nullptr};
         CodecManager::aCodecManager* codecManager{nullptr};
         mp3dec_t *decoder;
         int32_t frameStart{0};
         int16_t *outBuffer{nullptr};
-        AudioOrder currentOrder;
+        AudioOrder currentOrder{SILENCE_ORDER};
+        AudioOrder interruptedOrder{SILENCE_ORDER}; //music, that has been pre-empted by an announcement
+        int32_t interruptedFrameStart{0};
+        Mp3IndexCache<MP3::INDEX_CACHE_SIZE> *indexCache{nullptr};
+        const Mp3Index *currentIndex{nullptr};
+        uint32_t framesToDiscard{0}; //pre-roll after seek or resume
+        bool streaming{false}; //at least one block of the current order has been written; underruns before are just idle time
+        bool powerDownPending{false}; //stopped while overlays (e.g. the fading out music) play; the codec is powered down after the last one
+        uint32_t underrunsSeen{0};
+        uint32_t underrunsInStream{0};
+        StreamReader *streamReader{nullptr}; //created on the first MP3_STREAM order
+        Synthesizer *synth{nullptr}; //created on the first SYNTHESIZER order
+
+        QueueHandle_t overlayQueue{nullptr};
+        OverlayOrder overlays[MIXER_STREAMS-1]{}; //owned by the Loop task
+        std::atomic<const iAudioSource*> playingOverlays[MIXER_STREAMS-1]{}; //copy of overlays[k].source for IsOverlayPlaying in other tasks
+        std::atomic<bool> emitting{false}; //published by the Loop task for IsEmittingSamples in other tasks
+        std::atomic<uint32_t> positionMs{0}; //published by the Loop task for GetPositionMs/GetDurationMs; 0 if no MP3 is playing
+        std::atomic<uint32_t> durationMs{0};
+        int16_t *overlayBuffer{nullptr}; //(MIXER_STREAMS-1) chunks of MIXER_CHUNK_FRAMES stereo frames
+        Mixer::GainRamp overlayRamps[MIXER_STREAMS-1];
+        uint16_t mainGainQ15{GAIN_UNITY_Q15}; //set by SetMainGain, applied by the Loop task
+        uint16_t mainGainRampMs{DEFAULT_RAMP_MS};
+        uint16_t appliedMainGainQ15{GAIN_UNITY_Q15};
+        Mixer::GainRamp mainRamp; //main gain times ducking, crossfade-in
+        AnnouncementMode announcementMode{AnnouncementMode::PREEMPT};
+        uint16_t duckGainQ15{DEFAULT_DUCK_GAIN_Q15};
+        iAudioSource *duckSource{nullptr}; //announcement, that is playing as overlay on top of the ducked music
+        Mp3Source *duckMp3{nullptr}; //created on the first ducked MP3 announcement
+        PcmSource duckPcm{nullptr, 0, 2, 44100};
+        uint16_t crossfadeMs{0};
+        Mp3Source *fadeMp3{nullptr}; //outgoing MP3 during a crossfade, created on the first crossfade
+        PcmSource fadePcm{nullptr, 0, 2, 44100};
+        ResamplingSource *overlayResamplers[MIXER_STREAMS-1]{}; //created on demand for overlays with another sample rate
+        iAudioSource *overlayReaders[MIXER_STREAMS-1]{}; //either the overlay source itself or its resampler
+        uint32_t outputRateHz{44100}; //all streams are converted to this rate, so the I2S clock never has to be changed
+        Resampler *mainResampler{nullptr};
+        bool mainResampling{false}; //the main resampler holds frames of the current order
+        int16_t *resampleBuffer{nullptr};
+        static constexpr size_t RESAMPLE_BUFFER_FRAMES = 1024;
         
 
-        static int FindSyncWordOnAnyPosition(const uint8_t *file, size_t fileLen, int offset){
-            for (int i = offset; i < fileLen - 1; i++)
-            {
-                if ((file[i + 0] & MP3::SYNCWORDH) == MP3::SYNCWORDH && (file[i + 1] & MP3::SYNCWORDL) == MP3::SYNCWORDL)
-                    return i;
+        // Continues decoding at frame. The decoder is reset, so some frames before are decoded and dropped to get the bit reservoir filled again
+        void StartAtFrame(uint32_t frame){
+            uint32_t preroll = std::min(frame, MP3::SEEK_PREROLL_FRAMES);
+            frameStart = currentIndex->OffsetOfFrame(frame-preroll);
+            framesToDiscard = preroll;
+            mp3dec_init(decoder);
+        }
+
+        QueueHandle_t QueueFor(Priority priority){
+            return priority==Priority::ANNOUNCEMENT?announcementQueue:musicQueue;
+        }
+
+        esp_err_t Enqueue(const AudioOrder &ao){
+            if(!musicQueue || !announcementQueue) return ESP_FAIL;
+            QueueHandle_t q = QueueFor(ao.priority);
+            if(ao.cancelPrevious){
+                xQueueReset(q);
             }
-            return -1;
+            if(xQueueSendToBack(q, &ao, 0)!=pdTRUE){
+                ESP_LOGW(TAG, "Order queue full, order dropped");
+                return ESP_FAIL;
+            }
+            return ESP_OK;
         }
 
+        // Gapless transition: if the next order of the same priority is an MP3 with the same format, decoding continues with it
+        // into the current output buffer. The decoder is not reinitialized, so the synthesis filterbank runs through without a gap.
+        bool ContinueWithSuccessor(int hz, int channels){
+            AudioOrder next;
+            if(currentOrder.type!=AudioType::MP3) return false;
+            if(currentOrder.priority==Priority::MUSIC && uxQueueMessagesWaiting(announcementQueue)>0) return false;
+            QueueHandle_t q = QueueFor(currentOrder.priority);
+            if(!xQueuePeek(q, &next, 0) || next.type!=AudioType::MP3) return false;
+            if(next.startMs!=0) return false;
+            const Mp3Index *index = indexCache->Get(next.file, next.fileLen, currentIndex);
+            if(!index->IsValid()) return false;
+            if(hz!=0 && ((int)index->GetSampleRate()!=hz || index->GetChannels()!=channels)) return false;
+            xQueueReceive(q, &next, 0);
+            currentOrder=next;
+            currentIndex=index;
+            frameStart=index->GetFirstFrame();
+            framesToDiscard=0;
+            if(currentOrder.volume!=0){
+                codecManager->SetVolume(currentOrder.volume);
+            }
+            ESP_LOGI(TAG, "Gapless transition to File=%p; FileLen=%zu;", currentOrder.file, currentOrder.fileLen);
+            return true;
+        }
 
+        bool AnyOverlayActive(){
+            for(auto &o:overlays){
+                if(o.source) return true;
+            }
+            return false;
+        }
 
+        uint32_t MsToFrames(uint32_t ms){
+            return ms*outputRateHz/1000;
+        }
 
-        ErrorCode LoopPCM(){
-            codecManager->WriteAudioData(CodecManager::eChannels::TWO, CodecManager::eSampleBits::SIXTEEN, 44100, currentOrder.fileLen/4, (void*)currentOrder.file);//TODO AudioFormat!
-            currentOrder=SILENCE_ORDER;
+        // puts oo into a free mixer slot; returns false, if all slots are in use
+        bool StartOverlay(const OverlayOrder &oo, uint16_t startGainQ15){
+            OverlayOrder *free{nullptr};
+            for(auto &o:overlays){
+                if(!o.source){
+                    free=&o;
+                    break;
+                }
+            }
+            if(!free){
+                ESP_LOGW(TAG, "All %d overlay slots in use, overlay dropped", MIXER_STREAMS-1);
+                return false;
+            }
+            size_t k = free-overlays;
+            if(oo.source->GetSampleRate()!=outputRateHz){
+                if(!overlayResamplers[k]) overlayResamplers[k] = new ResamplingSource();
+                overlayResamplers[k]->SetSource(oo.source, outputRateHz);
+                overlayReaders[k] = overlayResamplers[k];
+            }else{
+                overlayReaders[k] = oo.source;
+            }
+            SetOverlay(k, oo);
+            overlayRamps[k].Set(startGainQ15);
+            overlayRamps[k].RampTo(oo.gainQ15, MsToFrames(oo.rampMs));
+            codecManager->SetPowerState(true);
+            return true;
+        }
+
+        // fades the overlay in slot k out; it is removed, when its ramp has reached 0
+        void FadeOutOverlay(size_t k, uint16_t rampMs){
+            overlays[k].stop=true;
+            overlayRamps[k].RampTo(0, MsToFrames(rampMs));
+        }
+
+        void RemoveOverlay(size_t k){
+            if(overlays[k].source==duckSource){
+                EndDucking();
+            }
+            SetOverlay(k, OverlayOrder{});
+        }
+
+        void SetOverlay(size_t k, const OverlayOrder &oo){
+            overlays[k]=oo;
+            playingOverlays[k].store(oo.source, std::memory_order_release);
+        }
+
+        void ScheduleOverlays(){
+            OverlayOrder oo;
+            while(xQueueReceive(overlayQueue, &oo, 0)){
+                OverlayOrder *same{nullptr};
+                for(auto &o:overlays){
+                    if(o.source==oo.source) same=&o;
+                }
+                if(same){
+                    size_t k = same-overlays;
+                    if(oo.stop){
+                        FadeOutOverlay(k, oo.rampMs);
+                    }else{
+                        same->stop=false;
+                        overlayRamps[k].RampTo(oo.gainQ15, MsToFrames(oo.rampMs));
+                    }
+                    continue;
+                }
+                if(!oo.stop){
+                    StartOverlay(oo, oo.gainQ15);
+                }
+            }
+        }
+
+        // gain of the main stream: the gain set by SetMainGain, attenuated while an announcement is ducking it
+        uint16_t MainTarget(){
+            return duckSource?(appliedMainGainQ15*duckGainQ15)>>15:appliedMainGainQ15;
+        }
+
+        void UpdateMainRamp(){
+            if(mainGainQ15==appliedMainGainQ15) return;
+            appliedMainGainQ15=mainGainQ15;
+            mainRamp.RampTo(MainTarget(), MsToFrames(mainGainRampMs));
+        }
+
+        // Ducking: the announcement is played as overlay on top of the music, the music is attenuated while it plays.
+        // Only for MP3 and PCM in memory; returns false, if the announcement has to pre-empt the music instead
+        bool StartDucking(const AudioOrder &order){
+            if(announcementMode!=AnnouncementMode::DUCK || currentOrder.type==AudioType::SILENCE || currentOrder.priority!=Priority::MUSIC) return false;
+            iAudioSource *source{nullptr};
+            if(order.type==AudioType::MP3){
+                if(!duckMp3) duckMp3 = new Mp3Source(order.file, order.fileLen);
+                else duckMp3->SetFile(order.file, order.fileLen);
+                if(duckMp3->GetSampleRate()==0) return false;
+                source=duckMp3;
+            }else if(order.type==AudioType::PCM){
+                duckPcm = PcmSource((const int16_t *)order.file, order.fileLen/(2*sizeof(int16_t)), 2, order.sampleRate?order.sampleRate:44100);
+                source=&duckPcm;
+            }else{
+                return false;
+            }
+            StopDucking(); //a previous announcement, that is replaced by this one (cancelPrevious)
+            for(size_t k=0;k<MIXER_STREAMS-1;k++){
+                if(overlays[k].source==source) SetOverlay(k, OverlayOrder{}); //the faded out previous announcement used the same source object
+            }
+            if(!StartOverlay(OverlayOrder{source, GAIN_UNITY_Q15, false, 0}, GAIN_UNITY_Q15)) return false;
+            duckSource=source;
+            mainRamp.RampTo(MainTarget(), MsToFrames(DUCK_ATTACK_MS));
+            ESP_LOGI(TAG, "Ducking music for announcement File=%p", order.file);
+            return true;
+        }
+
+        // the ducking announcement has ended: the music returns to its gain
+        void EndDucking(){
+            if(!duckSource) return;
+            duckSource=nullptr;
+            mainRamp.RampTo(MainTarget(), MsToFrames(DUCK_RELEASE_MS));
+        }
+
+        // aborts the ducking announcement with a short fade
+        void StopDucking(){
+            for(size_t k=0;k<MIXER_STREAMS-1;k++){
+                if(duckSource && overlays[k].source==duckSource) FadeOutOverlay(k, DEFAULT_RAMP_MS);
+            }
+            EndDucking();
+        }
+
+        // Crossfade: the current MP3/PCM order continues as overlay and fades out, while the next order fades in.
+        // The MP3 decoder state is handed over, so the outgoing stream is neither restarted nor copied
+        void StartCrossfade(){
+            iAudioSource *source{nullptr};
+            if(currentOrder.type==AudioType::MP3){
+                if(!fadeMp3) fadeMp3 = new Mp3Source(nullptr, 0);
+                for(auto &o:overlays){
+                    if(o.source==fadeMp3) return; //a crossfade is still running
+                }
+                fadeMp3->Continue(currentOrder.file, currentOrder.fileLen, frameStart, *decoder);
+                source=fadeMp3;
+            }else if(currentOrder.type==AudioType::PCM){
+                for(auto &o:overlays){
+                    if(o.source==&fadePcm) return;
+                }
+                fadePcm = PcmSource((const int16_t *)(currentOrder.file+frameStart), (currentOrder.fileLen-frameStart)/(2*sizeof(int16_t)), 2, currentOrder.sampleRate?currentOrder.sampleRate:44100);
+                source=&fadePcm;
+            }else{
+                return;
+            }
+            if(source->GetSampleRate()==0) return;
+            if(!StartOverlay(OverlayOrder{source, 0, true, crossfadeMs}, mainRamp.Current())) return;
+            mainRamp.Set(0);
+            mainRamp.RampTo(MainTarget(), MsToFrames(crossfadeMs));
+        }
+
+        // Mixes all active overlays into buf (stereo frames at outputRateHz) and writes it to the codec
+        ErrorCode WriteOutput(int16_t *buf, size_t frames){
+            for(size_t base=0; base<frames && (AnyOverlayActive() || !mainRamp.IsUnity()); base+=MIXER_CHUNK_FRAMES){
+                size_t n = std::min(MIXER_CHUNK_FRAMES, frames-base);
+                const int16_t *in[MIXER_STREAMS];
+                Mixer::GainRamp *ramps[MIXER_STREAMS];
+                bool exhausted[MIXER_STREAMS-1]{};
+                in[0]=buf+2*base;
+                ramps[0]=&mainRamp;
+                size_t streams=1;
+                for(size_t k=0;k<MIXER_STREAMS-1;k++){
+                    OverlayOrder &o = overlays[k];
+                    if(!o.source) continue;
+                    int16_t *dst = overlayBuffer+k*2*MIXER_CHUNK_FRAMES;
+                    in[streams]=dst;
+                    ramps[streams]=&overlayRamps[k];
+                    streams++;
+                    size_t got = overlayReaders[k]->Read(dst, n);
+                    if(got<n){
+                        memset(dst+2*got, 0, (n-got)*2*sizeof(int16_t));
+                        exhausted[k]=true;
+                    }
+                }
+                Mixer::MixRamped(buf+2*base, in, ramps, streams, n);
+                for(size_t k=0;k<MIXER_STREAMS-1;k++){
+                    if(overlays[k].source && (exhausted[k] || (overlays[k].stop && overlayRamps[k].IsSilent()))){
+                        RemoveOverlay(k);
+                    }
+                }
+            }
+            return codecManager->WriteAudioData(CodecManager::eChannels::TWO, CodecManager::eSampleBits::SIXTEEN, outputRateHz, frames, buf);
+        }
+
+        // Converts the main stream to stereo with outputRateHz, mixes the overlays and writes it to the codec
+        ErrorCode Output(int16_t *buf, int channels, int hz, size_t frames){
+            if(hz==(int)outputRateHz && !AnyOverlayActive() && mainRamp.IsUnity()){
+                return codecManager->WriteAudioData((CodecManager::eChannels)channels, CodecManager::eSampleBits::SIXTEEN, hz, frames, buf);
+            }
+            if(channels==1){
+                for (int i = frames - 1; i >= 0; i--)
+                {
+                    buf[2 * i] = buf[2 * i + 1] = buf[i];
+                }
+            }
+            if(hz==(int)outputRateHz){
+                return WriteOutput(buf, frames);
+            }
+            if(mainResampler->GetInRate()!=(uint32_t)hz){
+                mainResampler->Configure(hz, outputRateHz);
+            }
+            mainResampling=true;
+            size_t consumed=0;
+            while(consumed<frames){
+                size_t used{0};
+                size_t n = mainResampler->Process(buf+2*consumed, frames-consumed, &used, resampleBuffer, RESAMPLE_BUFFER_FRAMES);
+                consumed+=used;
+                if(n==0) break;
+                RETURN_ON_ERRORCODE(WriteOutput(resampleBuffer, n));
+            }
             return ErrorCode::OK;
         }
+
+        // End of an order: the resampler still holds its last frames (the filter delay), push them out
+        ErrorCode FlushResampler(){
+            if(!mainResampling) return ErrorCode::OK;
+            mainResampling=false;
+            size_t n = mainResampler->Flush(resampleBuffer, RESAMPLE_BUFFER_FRAMES);
+            return n>0?WriteOutput(resampleBuffer, n):ErrorCode::OK;
+        }
+
+        // Start of an order: no history of the previous one (e.g. a pre-empted one) in the filter
+        void ResetResampler(){
+            mainResampler->Reset();
+            mainResampling=false;
+        }
+
+        // The DMA ran dry between two blocks of the same order: decoding took longer than playing the previous block
+        void CheckUnderruns(){
+            uint32_t underruns = codecManager->GetUnderrunCount();
+            if(streaming && underruns!=underrunsSeen){
+                underrunsInStream+=underruns-underrunsSeen;
+                ESP_LOGW(TAG, "Audio output underrun (%lu in total) --> broken audio --> check task config!", underrunsInStream);
+            }
+            underrunsSeen=underruns;
+            streaming=true;
+        }
+
+        // Overlays without main stream: mix them on top of silence
+        ErrorCode LoopSilence(){
+            if(!AnyOverlayActive()) return ErrorCode::OK;
+            memset(outBuffer, 0, MP3::SAMPLES_PER_FRAME*2*sizeof(int16_t));
+            auto err = Output(outBuffer, 2, outputRateHz, MP3::SAMPLES_PER_FRAME);
+            if(powerDownPending && !AnyOverlayActive()) InitSilence(); //the last overlay after a stop has ended
+            return err;
+        }
+
+        ErrorCode LoopPCM(){
+            //PCM is 16bit stereo. It is copied block by block into the output buffer, so that overlays can be mixed in
+            constexpr size_t BYTES_PER_FRAME = 2*sizeof(int16_t);
+            size_t frames = std::min(MP3::FRAMES_IN_BUFFER*MP3::SAMPLES_PER_FRAME, (currentOrder.fileLen-frameStart)/BYTES_PER_FRAME);
+            if(frames==0){
+                currentOrder=SILENCE_ORDER;
+                return FlushResampler();
+            }
+            memcpy(outBuffer, currentOrder.file+frameStart, frames*BYTES_PER_FRAME);
+            frameStart+=frames*BYTES_PER_FRAME;
+            auto err = Output(outBuffer, 2, currentOrder.sampleRate?currentOrder.sampleRate:44100, frames);
+            CheckUnderruns();
+            return err;
+        }
         
-        ErrorCode LoopMP3(){
-            if (frameStart >= currentOrder.fileLen)
-            {
-                ESP_LOGI(TAG, "Reached End of MP3 File.");
+        // renders the note sequence with outputRateHz; the order ends, when the last note has faded out
+        ErrorCode LoopSynth(){
+            size_t frames = synth->Read(outBuffer, MP3::SAMPLES_PER_FRAME);
+            if(frames==0){
+                SynthStatistics s = synth->GetStatistics();
+                if(s.frames>0 && s.voiceFrames>0){
+                    ESP_LOGI(TAG, "Synthesizer: %llu cycles per frame, %llu per voice-sample (%lu frames)", s.cycles/s.frames, s.cycles/s.voiceFrames, s.frames);
+                }
+                synth->ResetStatistics();
                 currentOrder=SILENCE_ORDER;
                 return ErrorCode::OK;
             }
+            auto err = Output(outBuffer, 2, outputRateHz, frames);
+            CheckUnderruns();
+            return err;
+        }
+
+        // undecoded data of the current MP3 order; for streams, the window is refilled from the ring buffer before
+        int Mp3Data(const uint8_t **data){
+            if(currentOrder.type==AudioType::MP3_STREAM){
+                return streamReader->Window(data);
+            }
+            *data = currentOrder.file+frameStart;
+            return currentOrder.fileLen-frameStart;
+        }
+
+        void Mp3Consume(int bytes){
+            if(currentOrder.type==AudioType::MP3_STREAM){
+                streamReader->Consume(bytes);
+                return;
+            }
+            frameStart+=bytes;
+        }
+
+        // no more data will come for the current order; always true for files in memory
+        bool Mp3Exhausted(){
+            return currentOrder.type!=AudioType::MP3_STREAM || streamReader->IsExhausted();
+        }
+
+        void EndStream(){
+            if(currentOrder.type==AudioType::MP3_STREAM) streamReader->Stop();
+        }
+
+        ErrorCode LoopMP3(){
             int samples{0};
-            int16_t* buf=this->outBuffer;
+            int hz{0};
+            int channels{0};
             mp3dec_frame_info_t info = {};
             //Bei Samplerate >24000..48000: 1152 Samples/Frame, sonst 576
             //-->Ein Frame dauert maximal 24ms
             //-->Decodiere immer 4 Frames, damit wir knapp 100ms überbrücken können
-            for(int i=0;i<MP3::FRAMES_IN_BUFFER;i++){
-                int bytesLeft = currentOrder.fileLen - frameStart;
-                samples += mp3dec_decode_frame(decoder, currentOrder.file + frameStart, bytesLeft, buf, &info);
-                this->frameStart += info.frame_bytes;
-                if(samples==0) break;
-                buf=this->outBuffer+(samples*info.channels); //kein "+=", weil ja die samples bereits summiert werden!
-            }
-            if (samples == 0){return ErrorCode::OK;}
-            ESP_LOGD(TAG, "ch=%d, hz=%d, samples=%d", info.channels, info.hz, samples);
-            auto before = esp_timer_get_time();
-            auto err = codecManager->WriteAudioData((CodecManager::eChannels)info.channels, CodecManager::eSampleBits::SIXTEEN, info.hz,samples, outBuffer);
-            auto duration = esp_timer_get_time()-before;
-            if(duration<1000){
-                ESP_LOGW(TAG, "codecManager->WriteAudioData block shorter than 1000us. This means, buffer was already empty -->broken audio --> check task config!");
+            //skipped data (tags, garbage at the end of a file) does not count, so the buffer is full at a gapless transition, too
+            for(size_t i=0;i<MP3::FRAMES_IN_BUFFER;){
+                const uint8_t *data;
+                int bytesLeft = Mp3Data(&data);
+                if (bytesLeft <= 0)
+                {
+                    if(!Mp3Exhausted() || !ContinueWithSuccessor(hz, channels)) break; //stream: wait for more data
+                    bytesLeft = Mp3Data(&data);
+                }
+                int frameSamples = mp3dec_decode_frame(decoder, data, bytesLeft, this->outBuffer+(samples*channels), &info);
+                if(info.frame_bytes==0){
+                    if(!Mp3Exhausted()) break; //stream: the frame is not complete yet
+                    //no further frame in this file
+                    Mp3Consume(bytesLeft);
+                    continue;
+                }
+                Mp3Consume(info.frame_bytes);
+                if(framesToDiscard>0){
+                    framesToDiscard--; //pre-roll frame, counted even if the decoder could not produce samples yet
+                    i++;
+                    continue;
+                }
+                if(frameSamples==0) continue; //skipped data, e.g. ID3 tag
+                i++;
+                samples += frameSamples;
+                hz=info.hz;
+                channels=info.channels;
             }
+            if (samples == 0){
+                if(!Mp3Exhausted()){
+                    ESP_LOGD(TAG, "Stream starving");
+                    return ErrorCode::OK;
+                }
+                ESP_LOGI(TAG, "Reached End of MP3 File.");
+                EndStream();
+                currentOrder=SILENCE_ORDER;
+                return FlushResampler();
+            }
+            ESP_LOGD(TAG, "ch=%d, hz=%d, samples=%d", channels, hz, samples);
+            auto err = Output(outBuffer, channels, hz, samples);
+            CheckUnderruns();
             return err;
         }
 
         ErrorCode InitMP3(){
-            frameStart = FindSyncWordOnAnyPosition(currentOrder.file, currentOrder.fileLen, 0);
-            if (frameStart < 0)
+            currentIndex = indexCache->Get(currentOrder.file, currentOrder.fileLen, currentIndex);
+            if (!currentIndex->IsValid())
             {
                 ESP_LOGE(TAG, "No synch word found in file!");
                 return ErrorCode::DATA_FORMAT_ERROR;
             }
-            mp3dec_init(decoder);
+            StartAtFrame(currentIndex->FrameOfTimeMs(currentOrder.startMs));
             codecManager->SetPowerState(true);
             if(currentOrder.volume!=0){
                 codecManager->SetVolume(currentOrder.volume);
@@ -138,6 +679,24 @@ namespace AudioPlayer
             return ErrorCode::OK;
         }
 
+        ErrorCode InitMP3Stream(){
+            if(!currentOrder.source) return ErrorCode::INVALID_ARGUMENT_VALUES;
+            if(!streamReader){
+                streamReader = new StreamReader();
+                RETURN_ON_ERRORCODE(streamReader->Init());
+            }
+            RETURN_ON_ERRORCODE(streamReader->Start(currentOrder.source));
+            currentIndex=nullptr;
+            framesToDiscard=0;
+            mp3dec_init(decoder);
+            codecManager->SetPowerState(true);
+            if(currentOrder.volume!=0){
+                codecManager->SetVolume(currentOrder.volume);
+            }
+            ESP_LOGI(TAG, "Successfully initialized a new MP3 stream play task. Source=%p", currentOrder.source);
+            return ErrorCode::OK;
+        }
+
         esp_err_t InitPCM(){
             frameStart=0;
             codecManager->SetPowerState(true);
@@ -148,88 +707,297 @@ namespace AudioPlayer
             return ESP_OK;
         }
 
+        ErrorCode InitSynth(){
+            if(!currentOrder.notes) return ErrorCode::INVALID_ARGUMENT_VALUES;
+            if(!synth){
+                synth = new Synthesizer(outputRateHz);
+            }
+            synth->AllNotesOff(); //voices of a previous order fade out with their release time
+            synth->PlayNotes(currentOrder.notes, currentOrder.instrument?*currentOrder.instrument:Instruments::EPIANO);
+            codecManager->SetPowerState(true);
+            if(currentOrder.volume!=0){
+                codecManager->SetVolume(currentOrder.volume);
+            }
+            ESP_LOGI(TAG, "Successfully initialized a new synthesizer play task. Notes=%p", currentOrder.notes);
+            return ErrorCode::OK;
+        }
+
+        // Powers the codec down (with a soft mute on TAS580x); not while overlays play, then after the last one has ended
         esp_err_t InitSilence(){
-            if(codecManager) codecManager->SetPowerState(false);
+            powerDownPending=AnyOverlayActive();
+            if(codecManager && !powerDownPending) codecManager->SetPowerState(false);
             return ESP_OK;
         }
 
+        void Start(const AudioOrder &order){
+            //music replaces music (or is stopped): fade over instead of cutting; pre-empted music is resumed later and therefore cut
+            if(crossfadeMs>0 && currentOrder.priority==Priority::MUSIC && (order.priority==Priority::MUSIC || order.type==AudioType::SILENCE)){
+                StartCrossfade();
+            }
+            EndStream();
+            currentOrder=order;
+            streaming=false;
+            powerDownPending=false;
+            ResetResampler();
+            switch (currentOrder.type){
+                case AudioType::MP3:
+                    if(InitMP3()!=ErrorCode::OK){
+                        currentOrder=SILENCE_ORDER;
+                        InitSilence();
+                    }
+                    break;
+                case AudioType::MP3_STREAM:
+                    if(InitMP3Stream()!=ErrorCode::OK){
+                        currentOrder=SILENCE_ORDER;
+                        InitSilence();
+                    }
+                    break;
+                case AudioType::PCM:
+                    if(InitPCM()!=ESP_OK){
+                        currentOrder=SILENCE_ORDER;
+                        InitSilence();
+                    }
+                    break;
+                case AudioType::SYNTHESIZER:
+                    if(InitSynth()!=ErrorCode::OK){
+                        currentOrder=SILENCE_ORDER;
+                        InitSilence();
+                    }
+                    break;
+                default:
+                    currentOrder=SILENCE_ORDER;
+                    InitSilence();
+                    break;
+            }
+        }
+
+        void Resume(){
+            currentOrder=interruptedOrder;
+            streaming=false;
+            powerDownPending=false;
+            ResetResampler();
+            interruptedOrder=SILENCE_ORDER;
+            currentIndex = indexCache->Get(currentOrder.file, currentOrder.fileLen, currentIndex);
+            if(currentIndex->GetFrameCount()>0){
+                StartAtFrame(currentIndex->FrameAt(interruptedFrameStart));
+            }else{
+                //free format, no index: continue directly at the interrupted position
+                frameStart=interruptedFrameStart;
+                framesToDiscard=0;
+                mp3dec_init(decoder);
+            }
+            codecManager->SetPowerState(true);
+            if(currentOrder.volume!=0){
+                codecManager->SetVolume(currentOrder.volume);
+            }
+            ESP_LOGI(TAG, "Resume MP3 File=%p at %ld", currentOrder.file, frameStart);
+        }
+
+        // copies the state, that other tasks query, into the atomics; called by the Loop task after every Loop
+        void Publish(){
+            emitting.store(currentOrder.type!=AudioType::SILENCE || interruptedOrder.type!=AudioType::SILENCE || duckSource, std::memory_order_release);
+            const Mp3Index *index = currentIndex;
+            bool mp3 = currentOrder.type==AudioType::MP3 && index;
+            positionMs.store(mp3?index->TimeOfFrameMs(index->FrameAt(frameStart)):0, std::memory_order_relaxed);
+            durationMs.store(mp3?index->GetDurationMs():0, std::memory_order_relaxed);
+        }
+
+        void Schedule(){
+            AudioOrder next;
+            bool playingAnnouncement = (currentOrder.type!=AudioType::SILENCE && currentOrder.priority==Priority::ANNOUNCEMENT) || duckSource;
+            //announcements pre-empt (or duck) music; among each other, they only interrupt with cancelPrevious
+            if((!playingAnnouncement || (xQueuePeek(announcementQueue, &next, 0) && next.cancelPrevious)) && xQueueReceive(announcementQueue, &next, 0)){
+                if(StartDucking(next)) return;
+                StopDucking();
+                if(next.type==AudioType::SILENCE){
+                    //STOP_ORDER ends everything
+                    interruptedOrder=SILENCE_ORDER;
+                }
+                else if(currentOrder.type==AudioType::MP3 && currentOrder.priority==Priority::MUSIC){
+                    interruptedOrder=currentOrder;
+                    interruptedFrameStart=frameStart;
+                }
+                Start(next);
+                return;
+            }
+            if(playingAnnouncement) return;
+            bool idle = currentOrder.type==AudioType::SILENCE && interruptedOrder.type==AudioType::SILENCE;
+            if(xQueuePeek(musicQueue, &next, 0) && (next.cancelPrevious || idle)){
+                xQueueReceive(musicQueue, &next, 0);
+                interruptedOrder=SILENCE_ORDER;
+                Start(next);
+                return;
+            }
+            if(currentOrder.type==AudioType::SILENCE && interruptedOrder.type!=AudioType::SILENCE){
+                Resume();
+            }
+        }
+
 
     public:
+        // an order is playing, pre-empted or ducked; as of the end of the last Loop, so it may be called from any task
         bool IsEmittingSamples()
         {
-            return currentOrder.type!=AudioType::SILENCE;
+            return emitting.load(std::memory_order_acquire);
         }
 
-        esp_err_t PlayMP3(const uint8_t *file, size_t fileLen, uint8_t volume, bool cancelPrevious)
+        // startMs: position within the file, where playback starts. The frame index of the file is built on the first play, so later starts and seeks are instant
+        esp_err_t PlayMP3(const uint8_t *file, size_t fileLen, uint8_t volume, bool cancelPrevious, Priority priority=Priority::MUSIC, uint32_t startMs=0)
         {
-            if(!orderQueue) return ESP_FAIL;
+            if(!musicQueue) return ESP_FAIL;
             if(file==nullptr || fileLen==0){
-                xQueueOverwrite(orderQueue, &SILENCE_ORDER);
+                Stop();
                 return ESP_OK;
             }
-            AudioOrder ao{AudioType::MP3, file, fileLen, 0, volume, cancelPrevious};
-            xQueueOverwrite(orderQueue, &ao);
-            return ESP_OK;
+            return Enqueue(AudioOrder{AudioType::MP3, file, fileLen, 0, volume, cancelPrevious, priority, startMs});
         }
 
-        esp_err_t PlayPCM(const uint8_t *file, size_t fileLen, uint32_t sampleRate, uint8_t volume,  bool cancelPrevious)
+        // playback position of the current MP3 order as of the end of the last Loop; 0 if no MP3 is playing
+        uint32_t GetPositionMs()
         {
+            return positionMs.load(std::memory_order_relaxed);
+        }
 
-            if(!orderQueue) return ESP_FAIL;
-            AudioOrder ao{AudioType::PCM, file, fileLen, sampleRate, volume, cancelPrevious};
-            xQueueOverwrite(orderQueue, &ao);
-            return ESP_OK;
+        // duration of the current MP3 order, like GetPositionMs; 0 if no MP3 is playing
+        uint32_t GetDurationMs()
+        {
+            return durationMs.load(std::memory_order_relaxed);
+        }
+
+        // Streams an MP3 from source, e.g. FileSource("/spiffs/track.mp3") or HttpSource(url). The source must stay valid until playback has ended;
+        // after a stop, until the reader task has closed it, i.e. up to the read timeout of the source. Streams can not be resumed: an announcement stops a streamed music order
+        esp_err_t PlayMP3Stream(iByteSource *source, uint8_t volume, bool cancelPrevious, Priority priority=Priority::MUSIC)
+        {
+            if(source==nullptr) return ESP_FAIL;
+            AudioOrder ao{AudioType::MP3_STREAM, nullptr, 0, 0, volume, cancelPrevious, priority};
+            ao.source=source;
+            return Enqueue(ao);
+        }
+
+        // Plays a note sequence terminated by {0,0} with the built-in synthesizer, e.g. Ringtones::RINGTONE_SOUNDS[i]. notes and instrument must stay valid until playback has ended
+        esp_err_t PlayNotes(const Note *notes, uint8_t volume, bool cancelPrevious, Priority priority=Priority::ANNOUNCEMENT, const Instrument &instrument=Instruments::EPIANO)
+        {
+            if(!musicQueue || notes==nullptr) return ESP_FAIL;
+            AudioOrder ao{AudioType::SYNTHESIZER, nullptr, 0, 0, volume, cancelPrevious, priority};
+            ao.notes=notes;
+            ao.instrument=&instrument;
+            return Enqueue(ao);
+        }
+
+        esp_err_t PlayRingtone(Ringtones::RINGTONE_SONG song, uint8_t volume, bool cancelPrevious, Priority priority=Priority::ANNOUNCEMENT, const Instrument &instrument=Instruments::EPIANO)
+        {
+            size_t i = (size_t)song;
+            if(i==0 || i>=Ringtones::SONG_COUNT) return ESP_FAIL;
+            return PlayNotes(Ringtones::RINGTONE_SOUNDS[i], volume, cancelPrevious, priority, instrument);
+        }
+
+        esp_err_t PlayPCM(const uint8_t *file, size_t fileLen, uint32_t sampleRate, uint8_t volume,  bool cancelPrevious, Priority priority=Priority::MUSIC)
+        {
+            return Enqueue(AudioOrder{AudioType::PCM, file, fileLen, sampleRate, volume, cancelPrevious, priority});
+        }
+
+        // Mixes source on top of the main stream until the source is exhausted or StopOverlay is called. Calling it again for an active source only changes its gain,
+        // ramped over rampMs. The source must stay valid while it is playing
+        ErrorCode PlayOverlay(iAudioSource *source, uint16_t gainQ15=GAIN_UNITY_Q15, uint16_t rampMs=DEFAULT_RAMP_MS)
+        {
+            if(!overlayQueue) return ErrorCode::NOT_YET_INITIALIZED;
+            if(!source) return ErrorCode::INVALID_ARGUMENT_VALUES;
+            OverlayOrder oo{source, gainQ15, false, rampMs};
+            return xQueueSendToBack(overlayQueue, &oo, 0)==pdTRUE?ErrorCode::OK:ErrorCode::QUEUE_OVERLOAD;
+        }
+
+        // fades the overlay out over rampMs and removes it from the mixer
+        ErrorCode StopOverlay(iAudioSource *source, uint16_t rampMs=DEFAULT_RAMP_MS)
+        {
+            if(!overlayQueue) return ErrorCode::NOT_YET_INITIALIZED;
+            OverlayOrder oo{source, 0, true, rampMs};
+            return xQueueSendToBack(overlayQueue, &oo, 0)==pdTRUE?ErrorCode::OK:ErrorCode::QUEUE_OVERLOAD;
+        }
+
+        // underruns while an order was playing; idle time between orders is not counted
+        uint32_t GetUnderrunCount()
+        {
+            return underrunsInStream;
+        }
+
+        // may be called from any task; an overlay counts as playing from the Loop that has started it until it is removed from the mixer
+        bool IsOverlayPlaying(const iAudioSource *source)
+        {
+            for(auto &o:playingOverlays){
+                if(o.load(std::memory_order_acquire)==source) return true;
+            }
+            return false;
+        }
+
+        // gain of the main stream (MP3/PCM orders) in the mixer; the change is ramped over rampMs
+        void SetMainGain(uint16_t gainQ15, uint16_t rampMs=DEFAULT_RAMP_MS)
+        {
+            mainGainRampMs=rampMs;
+            mainGainQ15=gainQ15;
+        }
+
+        // DUCK: MP3 and PCM announcements do not pause the music, but are mixed on top of it, while the music is attenuated to duckGainQ15.
+        // The volume of a ducking announcement is ignored, as it shares the codec volume with the music
+        void SetAnnouncementMode(AnnouncementMode mode, uint16_t duckGainQ15=DEFAULT_DUCK_GAIN_Q15)
+        {
+            this->duckGainQ15=duckGainQ15;
+            announcementMode=mode;
+        }
+
+        // Music orders, that replace a playing MP3/PCM music order, and Stop() fade over within crossfadeMs; 0 switches hard.
+        // Uses one overlay slot during the fade
+        void SetCrossfade(uint16_t crossfadeMs)
+        {
+            this->crossfadeMs=crossfadeMs;
         }
 
         ErrorCode Stop()
         {
-            if(!orderQueue) return ErrorCode::NOT_YET_INITIALIZED;
-            xQueueOverwrite(orderQueue, &SILENCE_ORDER);
+            if(!musicQueue) return ErrorCode::NOT_YET_INITIALIZED;
+            xQueueReset(musicQueue);
+            Enqueue(STOP_ORDER);
             return ErrorCode::OK;
         }
 
  
         ErrorCode Loop(){
-            if(!orderQueue) return ErrorCode::NOT_YET_INITIALIZED;
-            AudioOrder temp;
-            if(currentOrder.type==AudioType::SILENCE || (xQueuePeek(orderQueue, &temp, 0) && temp.cancelPrevious)){
-                if(xQueueReceive(orderQueue, &currentOrder, 0)){
-                    switch (currentOrder.type){
-                        case AudioType::MP3:
-                            if(InitMP3()!=ErrorCode::OK){
-                                currentOrder=SILENCE_ORDER;
-                                InitSilence();
-                            }
-                            break;
-                        case AudioType::PCM:
-                            if(InitPCM()!=ESP_OK){
-                                currentOrder=SILENCE_ORDER;
-                                InitSilence();
-                            }
-                            break;
-                        default:
-                            InitSilence();
-                            break;
-                    }
-                }
-            }
-
+            if(!musicQueue) return ErrorCode::NOT_YET_INITIALIZED;
+            Schedule();
+            ScheduleOverlays();
+            UpdateMainRamp();
+            ErrorCode err;
             switch (currentOrder.type)
             {
             case AudioType::MP3:
-                return LoopMP3();
+            case AudioType::MP3_STREAM:
+                err = LoopMP3();
+                break;
             case AudioType::PCM:
-                return LoopPCM();
+                err = LoopPCM();
+                break;
+            case AudioType::SYNTHESIZER:
+                err = LoopSynth();
+                break;
             default:
-                return ErrorCode::OK;
+                err = LoopSilence();
+                break;
             }
+            Publish();
+            return err;
         }
 
-        Player(CodecManager::aCodecManager* codecManager)
+        // outputRateHz should be the sample rate, the codec has been initialized with
+        Player(CodecManager::aCodecManager* codecManager, uint32_t outputRateHz=44100):outputRateHz(outputRateHz)
         {
             this->outBuffer = new int16_t[MP3::CHANNELS_PER_SAMPLE * MP3::FRAMES_IN_BUFFER * MP3::SAMPLES_PER_FRAME];
             this->decoder = new mp3dec_t();
-            this->orderQueue = xQueueCreate(1,sizeof(AudioOrder));
+            this->indexCache = new Mp3IndexCache<MP3::INDEX_CACHE_SIZE>();
+            this->musicQueue = xQueueCreate(ORDER_QUEUE_LENGTH, sizeof(AudioOrder));
+            this->announcementQueue = xQueueCreate(ORDER_QUEUE_LENGTH, sizeof(AudioOrder));
+            this->overlayQueue = xQueueCreate(ORDER_QUEUE_LENGTH, sizeof(OverlayOrder));
+            this->overlayBuffer = new int16_t[(MIXER_STREAMS-1) * 2 * MIXER_CHUNK_FRAMES];
+            this->mainResampler = new Resampler();
+            this->resampleBuffer = new int16_t[2 * RESAMPLE_BUFFER_FRAMES];
             this->codecManager=codecManager;
             mp3dec_init(decoder);
         }
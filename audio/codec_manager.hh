@@ -1,5 +1,12 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <errorcodes.hh>
 #include <common.hh>
 #define TAG "CODEC"
@@ -18,11 +25,81 @@ namespace CodecManager
         SIXTEEN = 2,
     };
 
+    struct OutputStatistics
+    {
+        uint32_t blocks;    // number of WriteAudioData calls
+        uint32_t waits;     // how often WriteAudioData had to wait for free DMA buffers, because the previous block was not sent yet
+        uint32_t underruns; // DMA buffers, that have been sent without new data (raw count, also while idle)
+    };
+
+    // DMA buffers of the I2S channels. Each direction buffers up to count*frames frames, one buffer is the unit of a capture callback
+    struct DmaBuffering
+    {
+        uint32_t count;
+        uint32_t frames; // max. 1023 for 16 bit stereo (4092 bytes per DMA buffer)
+
+        bool operator==(const DmaBuffering &other) const { return count == other.count && frames == other.frames; }
+    };
+
+    constexpr DmaBuffering DMA_BUFFERING_DEFAULT{8, 576};     // one block of the player (4 MP3 frames, 104ms at 44.1kHz, 18KB): decoding overlaps playing
+    constexpr DmaBuffering DMA_BUFFERING_LOW_LATENCY{3, 128}; // intercom: 8ms per buffer at 16kHz, 24ms per direction
+
+    // Receives one DMA buffer of captured interleaved stereo frames in the capture task. frames points into the capture buffer of the
+    // codec manager and is only valid during the call; process it there or copy what is needed later
+    typedef void (*CaptureCallback)(const int16_t *frames, size_t frameCnt, void *userCtx);
+
+    struct CaptureStatistics
+    {
+        uint32_t buffers;   // number of callbacks
+        uint32_t overruns;  // DMA buffers, that have been overwritten, because the capture task did not read in time
+    };
+
+    // Gain as mantissa and shift: v = (audio * mant) >> shift. The mantissa always has 16 significant bits, so attenuations of -60dB
+    // are as exact as unity, and the sample loop stays a multiplication, a shift and a clip
+    struct ScaledGain
+    {
+        int32_t mant{1 << 15};
+        int32_t shift{15};
+
+        static ScaledGain FromFloat(float g)
+        {
+            if (g <= 0.0f)
+            {
+                return ScaledGain{0, 0};
+            }
+            int e;
+            float m = frexpf(g, &e); // g = m * 2^e, m in [0.5, 1)
+            int32_t shift = 16 - e;
+            if (shift > 31)
+            {
+                return ScaledGain{0, 0}; // below -90dB
+            }
+            return ScaledGain{std::min((int32_t)lrintf(m * 65536.0f), (int32_t)UINT16_MAX), shift};
+        }
+
+        bool IsUnity() const { return mant == (1 << 15) && shift == 15; }
+    };
+
     class aCodecManager
     {
 
     protected:
+        static constexpr float VOLUME_STEP_DB = 0.25f;    // SetDigitalVolume: 1...255 is -63.5dB...0dB, 0 is mute
+        static constexpr size_t RAMP_CHUNK_FRAMES = 32;    // during a ramp, the gain is updated every 32 frames (0.7ms at 44.1kHz)
+        static constexpr float RAMP_FACTOR = 1.0592537f;   // 0.5dB per chunk, so -63dB...0dB takes about 90ms
+        static constexpr float RAMP_FLOOR = 0.0003f;       // about -70dB; ramps from or to mute start or end here
+
         uint8_t gainF2P6{1 << 6};
+        float digitalVolume{1.0f};
+        float gainTarget{1.0f};  // gainF2P6 times digitalVolume
+        float gainCurrent{1.0f}; // approaches gainTarget by RAMP_FACTOR per chunk
+        ScaledGain gainScaled;   // gainCurrent
+
+        void UpdateGainTarget()
+        {
+            gainTarget = gainF2P6 / (float)(1 << 6) * digitalVolume;
+        }
+
         void SetGain(float gain_0to4)
         {
             if (gain_0to4 < 0.0)
@@ -34,96 +111,334 @@ namespace CodecManager
                 gain_0to4 = 3.99;
             }
             gainF2P6 = (gain_0to4 * (1 << 6));
+            UpdateGainTarget();
+        }
+
+        // Volume in the sample path with a logarithmic curve of 0.25dB per step; changes are ramped, so they do not click.
+        // For codecs without (fine grained) hardware volume
+        void SetDigitalVolume(uint8_t volume, bool ramp = true)
+        {
+            digitalVolume = volume == 0 ? 0.0f : powf(10.0f, (volume - 255) * VOLUME_STEP_DB / 20.0f);
+            UpdateGainTarget();
+            if (!ramp)
+            {
+                gainCurrent = gainTarget;
+                gainScaled = ScaledGain::FromFloat(gainCurrent);
+            }
         }
 
-        int16_t GainAndClip(int16_t audio)
+        // moves gainCurrent one ramp step towards gainTarget
+        void StepGainRamp()
         {
-            int32_t v = (audio * gainF2P6) >> 6;
+            if (gainCurrent < gainTarget)
+            {
+                gainCurrent = std::min(std::max(gainCurrent, RAMP_FLOOR) * RAMP_FACTOR, gainTarget);
+            }
+            else
+            {
+                gainCurrent = gainCurrent / RAMP_FACTOR;
+                if (gainCurrent <= gainTarget || gainCurrent < RAMP_FLOOR)
+                {
+                    gainCurrent = gainTarget;
+                }
+            }
+            gainScaled = ScaledGain::FromFloat(gainCurrent);
+        }
+
+        // branch free: clip compiles to min/max
+        static inline int16_t GainAndClip(int16_t audio, ScaledGain g)
+        {
+            int32_t v = (audio * g.mant) >> g.shift;
             return clip(v, (int32_t)INT16_MIN, (int32_t)INT16_MAX);
         }
 
-        void makeStereoFromMono(int16_t *read_buf, size_t samplesAvailable)
+        static void GainAndClip(int16_t *buf, size_t n, ScaledGain g)
         {
-            for (size_t i = 0; i < samplesAvailable; i++)
+            for (size_t i = 0; i < n; i++)
             {
-                read_buf[2 * samplesAvailable - 1 - 2 * i] = read_buf[2 * samplesAvailable - 2 - 2 * i] = read_buf[samplesAvailable - 1 - i];
+                buf[i] = GainAndClip(buf[i], g);
+            }
+        }
+
+        // Applies the gain and expands mono to stereo in one pass, in-place in buf. For mono, buf must have space for 2*frames values.
+        // The loops have no branches and no dependencies between iterations, so the compiler can vectorize them.
+        // Mono runs backwards, because each source sample is read before its two destination values are written.
+        // While the gain ramps, the first frames are processed chunk by chunk with increasing/decreasing gain; then mono needs a second (copy) pass
+        void GainAndClipToStereo(int16_t *buf, size_t frames, eChannels ch)
+        {
+            const size_t values = ch == eChannels::TWO ? 2 : 1;
+            size_t ramped{0};
+            while (gainCurrent != gainTarget && ramped < frames)
+            {
+                StepGainRamp();
+                size_t n = std::min(RAMP_CHUNK_FRAMES, frames - ramped);
+                GainAndClip(buf + values * ramped, values * n, gainScaled);
+                ramped += n;
+            }
+            const ScaledGain g = gainScaled;
+            if (ch == eChannels::TWO)
+            {
+                if (!g.IsUnity())
+                {
+                    GainAndClip(buf + 2 * ramped, 2 * (frames - ramped), g);
+                }
+                return;
+            }
+            for (size_t i = frames; i-- > ramped;)
+            {
+                int16_t v = GainAndClip(buf[i], g);
+                buf[2 * i] = v;
+                buf[2 * i + 1] = v;
+            }
+            for (size_t i = ramped; i-- > 0;)
+            {
+                buf[2 * i] = buf[i];
+                buf[2 * i + 1] = buf[i];
             }
         }
 
         virtual ErrorCode SetSampleRate(uint32_t sampleRateHz) = 0;
 
     public:
-        // sampleCnt sind die Anzahl der 16bit-Werte. Diese sind bei Stereo doppelt so groß, wie bei Mono. Also bei Mono 44100Hz gibt es pro sek 44100 samples und bei Stereo eben 88200
+        // sampleCnt ist die Anzahl der Samples pro Kanal (=Frames). Bei Stereo enthält buf also 2*sampleCnt 16bit-Werte. Bei Mono muss buf Platz für 2*sampleCnt Werte haben, weil in-place nach Stereo gewandelt wird
         virtual ErrorCode WriteAudioData(eChannels ch, eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) = 0;
 
         virtual ErrorCode SetPowerState(bool power) = 0;
         virtual ErrorCode SetVolume(uint8_t volume) = 0;
+        // number of DMA underruns since start; 0 for codecs without statistics
+        virtual uint32_t GetUnderrunCount() { return 0; }
         //virtual ErrorCode Init() = 0; Nein, weil jeder Codec andere Parameter braucht. Der CodecManager muss also in der abgeleiteten Klasse initialisiert werden und dann als "fertiges" Obejkt dem Player übergeben werden.
     };
 
+    // Double buffered output: the DMA buffers hold a whole block of the caller (see DMA_BUFFERING_DEFAULT), so WriteAudioData copies the block
+    // into the buffers, that have been played already, and returns, while the DMA still plays the rest of the previous block. The caller
+    // decodes the next block meanwhile. The driver is only called without timeout; for the next free DMA buffer, WriteAudioData waits on
+    // the semaphore given by on_sent, so the calling task never parks inside i2s_channel_write. If no buffer is sent within
+    // WRITE_TIMEOUT_MS, the write fails.
+    // With smaller DMA buffers (DMA_BUFFERING_LOW_LATENCY), decoding only overlaps with the playing time of the buffers
     class aI2sCodecManager : public aCodecManager
     {
 
     public:
+        static constexpr uint32_t WRITE_TIMEOUT_MS = 500;
+        static constexpr TickType_t WRITE_TIMEOUT_TICKS = pdMS_TO_TICKS(WRITE_TIMEOUT_MS);
+        static constexpr uint32_t CAPTURE_READ_TIMEOUT_MS = 100; // the capture task checks for StopCapture at least this often
+        static constexpr UBaseType_t CAPTURE_TASK_PRIORITY = 12;
+
         ErrorCode WriteAudioData(eChannels ch, eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) override
         {
             if (bits != eSampleBits::SIXTEEN)
             {
                 return ErrorCode::FUNCTION_NOT_AVAILABLE;
             }
-            if (ch == eChannels::ONE)
+            GainAndClipToStereo((int16_t *)buf, sampleCnt, ch);
+            if (sampleRateHz != this->currentSampleRateHz)
             {
-                makeStereoFromMono((int16_t *)buf, sampleCnt);
-                sampleCnt *= 2;
+                RETURN_ON_ERRORCODE(SetSampleRate(sampleRateHz)); // plays the queued frames with the old sample rate first
             }
-            if (sampleRateHz != this->currentSampleRateHz)
+            statistics.blocks++;
+
+            const uint8_t *bytes = (const uint8_t *)buf;
+            size_t remaining = 2 * sizeof(int16_t) * sampleCnt;
+            bool waited{false};
+            while (true)
+            {
+                size_t written{0};
+                esp_err_t err = i2s_channel_write(tx_handle, bytes, remaining, &written, 0);
+                if (err != ESP_OK && err != ESP_ERR_TIMEOUT)
+                {
+                    return ErrorCode::GENERIC_ERROR;
+                }
+                bytes += written;
+                remaining -= written;
+                if (remaining == 0)
+                {
+                    return ErrorCode::OK;
+                }
+                if (!waited)
+                {
+                    statistics.waits++;
+                    waited = true;
+                }
+                // a stale give (a buffer sent before the write above) only costs one more pass
+                if (xSemaphoreTake(dmaBufferSent, WRITE_TIMEOUT_TICKS) != pdTRUE)
+                {
+                    ESP_LOGE(TAG, "No DMA buffer has been sent for %lums", WRITE_TIMEOUT_MS);
+                    return ErrorCode::TIMEOUT;
+                }
+            }
+        }
+
+        uint32_t GetUnderrunCount() override { return underruns.load(std::memory_order_relaxed); }
+
+        OutputStatistics GetOutputStatistics()
+        {
+            OutputStatistics s = statistics;
+            s.underruns = underruns.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        CaptureStatistics GetCaptureStatistics()
+        {
+            CaptureStatistics s = captureStatistics;
+            s.overruns = overruns.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        DmaBuffering GetDmaBuffering() { return dmaBuffering; }
+
+        // Changes the DMA buffering at runtime (e.g. DMA_BUFFERING_LOW_LATENCY for intercom). If the channels exist already, they are
+        // deleted and created again after the pending output has been played; not possible during a capture
+        ErrorCode SetDmaBuffering(DmaBuffering buffering)
+        {
+            if (buffering.count < 2 || buffering.frames < 8 || buffering.frames > 1023)
+            {
+                return ErrorCode::INVALID_ARGUMENT_VALUES;
+            }
+            if (buffering == dmaBuffering)
+            {
+                return ErrorCode::OK;
+            }
+            if (capturing)
+            {
+                return ErrorCode::INVALID_STATE;
+            }
+            if (!tx_handle)
+            {
+                dmaBuffering = buffering;
+                return ErrorCode::OK;
+            }
+            RETURN_ON_ERRORCODE(DrainOutput());
+            DeleteChannels();
+            dmaBuffering = buffering;
+            return CreateChannels();
+        }
+
+        // Starts the capture task, which reads one DMA buffer after the other and passes each directly to callback.
+        // Needs a data_in pin in InitI2sEsp32; the output keeps running (full duplex on the same clocks)
+        ErrorCode StartCapture(CaptureCallback callback, void *userCtx)
+        {
+            if (!rx_handle)
+            {
+                return ErrorCode::FUNCTION_NOT_AVAILABLE;
+            }
+            if (capturing)
+            {
+                return ErrorCode::INVALID_STATE;
+            }
+            if (captureCapacityFrames != dmaBuffering.frames)
+            {
+                delete[] captureBuf;
+                captureCapacityFrames = dmaBuffering.frames;
+                captureBuf = new int16_t[2 * captureCapacityFrames];
+            }
+            captureCallback = callback;
+            captureCtx = userCtx;
+            captureStatistics = {};
+            overruns.store(0, std::memory_order_relaxed);
+            ESP_ERROR_CHECK(i2s_channel_enable(rx_handle));
+            capturing = true;
+            if (xTaskCreate(CaptureTask, "I2sCapture", 4096, this, CAPTURE_TASK_PRIORITY, nullptr) != pdPASS)
             {
-                SetSampleRate(sampleRateHz);
-                this->currentSampleRateHz = sampleRateHz;
+                capturing = false;
+                i2s_channel_disable(rx_handle);
+                return ErrorCode::GENERIC_ERROR;
             }
+            return ErrorCode::OK;
+        }
 
-            RETURN_ERRORCODE_ON_ERROR(i2s_channel_write(tx_handle, buf, sizeof(int16_t) * sampleCnt, nullptr, -1), ErrorCode::GENERIC_ERROR);
+        // returns after the last callback has finished
+        ErrorCode StopCapture()
+        {
+            if (!capturing)
+            {
+                return ErrorCode::OK;
+            }
+            capturing = false;
+            xSemaphoreTake(captureStopped, portMAX_DELAY);
+            ESP_ERROR_CHECK(i2s_channel_disable(rx_handle));
             return ErrorCode::OK;
         }
 
+        bool IsCapturing() { return capturing; }
+
     private:
         i2s_chan_handle_t tx_handle{nullptr};
+        i2s_chan_handle_t rx_handle{nullptr}; // only in full duplex mode, i.e. with a data_in pin
+        gpio_num_t pinMclk{GPIO_NUM_NC}, pinBck{GPIO_NUM_NC}, pinWs{GPIO_NUM_NC}, pinDataOut{GPIO_NUM_NC}, pinDataIn{GPIO_NUM_NC};
+        DmaBuffering dmaBuffering{DMA_BUFFERING_DEFAULT};
+        std::atomic<bool> capturing{false}; // cleared by StopCapture, polled by the capture task
+        SemaphoreHandle_t captureStopped{nullptr}; // given by the capture task, when it ends
+        CaptureCallback captureCallback{nullptr};
+        void *captureCtx{nullptr};
+        int16_t *captureBuf{nullptr}; // one DMA buffer of stereo frames, the only copy of the captured data outside the driver
+        size_t captureCapacityFrames{0};
+        CaptureStatistics captureStatistics{};
+        SemaphoreHandle_t dmaBufferSent{nullptr}; // given by the on_sent ISR, whenever a DMA buffer becomes free
+        OutputStatistics statistics{};            // blocks and waits; the ISR counters are kept separately
+        std::atomic<uint32_t> underruns{0};       // incremented in the ISR
+        std::atomic<uint32_t> overruns{0};        // incremented in the ISR
 
-    protected:
-        aI2sCodecManager(uint32_t initialSampleRateHz = 44100, eChannels initialChannels = eChannels::TWO, eSampleBits initialSampleBits = eSampleBits::SIXTEEN) : currentSampleRateHz(initialSampleRateHz),
-                                                                                                                                                                   currentChannels(initialChannels),
-                                                                                                                                                                   currentSampleBits(initialSampleBits)
+        static bool IRAM_ATTR OnSent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
         {
+            aI2sCodecManager *myself = static_cast<aI2sCodecManager *>(user_ctx);
+            BaseType_t higherPriorityTaskWoken{pdFALSE};
+            xSemaphoreGiveFromISR(myself->dmaBufferSent, &higherPriorityTaskWoken);
+            return higherPriorityTaskWoken == pdTRUE;
         }
 
-        uint32_t currentSampleRateHz{44100};
-        eChannels currentChannels{eChannels::TWO};
-        eSampleBits currentSampleBits{eSampleBits::SIXTEEN};
+        // the driver queue of sent buffers overflows, if all DMA buffers have been sent and none has been refilled
+        static bool IRAM_ATTR OnSendQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+        {
+            static_cast<aI2sCodecManager *>(user_ctx)->underruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
 
-        ErrorCode SetSampleRate(uint32_t sampleRateHz) override
+        // the driver queue of received buffers overflows, if the capture task does not keep up
+        static bool IRAM_ATTR OnRecvQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
         {
-            if (sampleRateHz == currentSampleRateHz)
+            static_cast<aI2sCodecManager *>(user_ctx)->overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        static void CaptureTask(void *p)
+        {
+            aI2sCodecManager *myself = static_cast<aI2sCodecManager *>(p);
+            const size_t bytes = 2 * sizeof(int16_t) * myself->captureCapacityFrames;
+            while (myself->capturing)
             {
-                return ErrorCode::OK;
+                size_t read{0};
+                esp_err_t err = i2s_channel_read(myself->rx_handle, myself->captureBuf, bytes, &read, CAPTURE_READ_TIMEOUT_MS);
+                if (err != ESP_OK || read == 0 || !myself->capturing)
+                {
+                    if (err != ESP_OK && err != ESP_ERR_TIMEOUT)
+                    {
+                        vTaskDelay(1); // e.g. disabled for a sample rate change
+                    }
+                    continue;
+                }
+                myself->captureStatistics.buffers++;
+                myself->captureCallback(myself->captureBuf, read / (2 * sizeof(int16_t)), myself->captureCtx);
             }
-            currentSampleRateHz = sampleRateHz;
-            ESP_LOGI(TAG, "Change sample rate to %ld Hz", currentSampleRateHz);
-            i2s_std_clk_config_t clk_cfg = {}; // this produces warning! I2S_STD_CLK_DEFAULT_CONFIG((uint32_t)sampleRateHz);
-            clk_cfg.sample_rate_hz = currentSampleRateHz;
-            clk_cfg.clk_src = I2S_CLK_SRC_DEFAULT;
-            clk_cfg.mclk_multiple = I2S_MCLK_MULTIPLE_256;
-            ESP_ERROR_CHECK(i2s_channel_disable(tx_handle));
-            ESP_ERROR_CHECK(i2s_channel_reconfig_std_clock(tx_handle, &clk_cfg));
-            ESP_ERROR_CHECK(i2s_channel_enable(tx_handle));
-            return ErrorCode::OK;
+            xSemaphoreGive(myself->captureStopped);
+            vTaskDelete(nullptr);
         }
 
-        ErrorCode InitI2sEsp32(gpio_num_t mclk, gpio_num_t bck, gpio_num_t ws, gpio_num_t data_out, gpio_num_t data_in = GPIO_NUM_NC)
+        ErrorCode CreateChannels()
         {
-            ESP_LOGI(TAG, "Initializing AudioPlayer for external I2S DAC");
             i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
             chan_cfg.auto_clear = true; // Auto clear the legacy data in the DMA buffer
-            ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &tx_handle, nullptr));
+            chan_cfg.dma_desc_num = dmaBuffering.count;
+            chan_cfg.dma_frame_num = dmaBuffering.frames;
+            // with data_in, tx and rx are created on the same controller and share BCK and WS (full duplex)
+            ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &tx_handle, pinDataIn != GPIO_NUM_NC ? &rx_handle : nullptr));
+            i2s_event_callbacks_t cbs = {
+                .on_recv = nullptr,
+                .on_recv_q_ovf = nullptr,
+                .on_sent = OnSent,
+                .on_send_q_ovf = OnSendQueueOverflow,
+            };
+            ESP_ERROR_CHECK(i2s_channel_register_event_callback(tx_handle, &cbs, this));
             i2s_std_config_t std_cfg = {
                 .clk_cfg = {
                     .sample_rate_hz = currentSampleRateHz,
@@ -136,11 +451,11 @@ namespace CodecManager
                 },
                 .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
                 .gpio_cfg = {
-                    .mclk = mclk,
-                    .bclk = bck,
-                    .ws = ws,
-                    .dout = data_out,
-                    .din = data_in,
+                    .mclk = pinMclk,
+                    .bclk = pinBck,
+                    .ws = pinWs,
+                    .dout = pinDataOut,
+                    .din = pinDataIn,
                     .invert_flags = {
                         .mclk_inv = false,
                         .bclk_inv = false,
@@ -149,9 +464,107 @@ namespace CodecManager
                 },
             };
             ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle, &std_cfg));
+            if (rx_handle)
+            {
+                i2s_event_callbacks_t rxCbs = {
+                    .on_recv = nullptr,
+                    .on_recv_q_ovf = OnRecvQueueOverflow,
+                    .on_sent = nullptr,
+                    .on_send_q_ovf = nullptr,
+                };
+                ESP_ERROR_CHECK(i2s_channel_register_event_callback(rx_handle, &rxCbs, this));
+                ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle, &std_cfg));
+            }
             ESP_ERROR_CHECK(i2s_channel_enable(tx_handle));
             return ErrorCode::OK;
         }
+
+        void DeleteChannels()
+        {
+            i2s_channel_disable(tx_handle);
+            i2s_del_channel(tx_handle);
+            tx_handle = nullptr;
+            if (rx_handle)
+            {
+                i2s_del_channel(rx_handle);
+                rx_handle = nullptr;
+            }
+            xSemaphoreTake(dmaBufferSent, 0);
+        }
+
+        // Waits until the frames, that have been written already, are played. Disabling or deleting the channel drops the DMA buffers,
+        // so this is needed before; every DMA buffer has been sent once after dmaBuffering.count on_sent events
+        ErrorCode DrainOutput()
+        {
+            xSemaphoreTake(dmaBufferSent, 0);
+            for (uint32_t i = 0; i < dmaBuffering.count; i++)
+            {
+                if (xSemaphoreTake(dmaBufferSent, WRITE_TIMEOUT_TICKS) != pdTRUE)
+                {
+                    ESP_LOGE(TAG, "No DMA buffer has been sent for %lu ticks", WRITE_TIMEOUT_TICKS);
+                    return ErrorCode::TIMEOUT;
+                }
+            }
+            return ErrorCode::OK;
+        }
+
+    protected:
+        aI2sCodecManager(uint32_t initialSampleRateHz = 44100, eChannels initialChannels = eChannels::TWO, eSampleBits initialSampleBits = eSampleBits::SIXTEEN) : currentSampleRateHz(initialSampleRateHz),
+                                                                                                                                                                   currentChannels(initialChannels),
+                                                                                                                                                                   currentSampleBits(initialSampleBits)
+        {
+        }
+
+        uint32_t currentSampleRateHz{44100};
+        eChannels currentChannels{eChannels::TWO};
+        eSampleBits currentSampleBits{eSampleBits::SIXTEEN};
+
+        ErrorCode SetSampleRate(uint32_t sampleRateHz) override
+        {
+            if (sampleRateHz == currentSampleRateHz)
+            {
+                return ErrorCode::OK;
+            }
+            // the queued frames belong to the old sample rate; disabling the channel would drop them
+            RETURN_ON_ERRORCODE(DrainOutput());
+            currentSampleRateHz = sampleRateHz;
+            ESP_LOGI(TAG, "Change sample rate to %ld Hz", currentSampleRateHz);
+            i2s_std_clk_config_t clk_cfg = {}; // this produces warning! I2S_STD_CLK_DEFAULT_CONFIG((uint32_t)sampleRateHz);
+            clk_cfg.sample_rate_hz = currentSampleRateHz;
+            clk_cfg.clk_src = I2S_CLK_SRC_DEFAULT;
+            clk_cfg.mclk_multiple = I2S_MCLK_MULTIPLE_256;
+            // in full duplex, both channels use the same clock; a channel can only be reconfigured while it is disabled
+            if (capturing)
+            {
+                ESP_ERROR_CHECK(i2s_channel_disable(rx_handle));
+            }
+            ESP_ERROR_CHECK(i2s_channel_disable(tx_handle));
+            ESP_ERROR_CHECK(i2s_channel_reconfig_std_clock(tx_handle, &clk_cfg));
+            if (rx_handle)
+            {
+                ESP_ERROR_CHECK(i2s_channel_reconfig_std_clock(rx_handle, &clk_cfg));
+            }
+            ESP_ERROR_CHECK(i2s_channel_enable(tx_handle));
+            if (capturing)
+            {
+                ESP_ERROR_CHECK(i2s_channel_enable(rx_handle));
+            }
+            return ErrorCode::OK;
+        }
+
+        // data_in enables full duplex: captured frames are delivered via StartCapture
+        ErrorCode InitI2sEsp32(gpio_num_t mclk, gpio_num_t bck, gpio_num_t ws, gpio_num_t data_out, gpio_num_t data_in = GPIO_NUM_NC)
+        {
+            ESP_LOGI(TAG, "Initializing AudioPlayer for external I2S DAC (%lu DMA buffers of %lu frames%s)", dmaBuffering.count, dmaBuffering.frames, data_in != GPIO_NUM_NC ? ", full duplex" : "");
+            pinMclk = mclk;
+            pinBck = bck;
+            pinWs = ws;
+            pinDataOut = data_out;
+            pinDataIn = data_in;
+            dmaBufferSent = xSemaphoreCreateBinary();
+            captureStopped = xSemaphoreCreateBinary();
+            return CreateChannels();
+        }
     };
 }
 #undef TAG
\ No newline at end of file
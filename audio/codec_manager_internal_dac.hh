@@ -1,15 +1,73 @@
-    #pragma once
+#pragma once
 #include <stdint.h>
 #include <errorcodes.hh>
 #include "codec_manager.hh"
 
 #include "driver/dac_continuous.h"
+#define TAG "DAC"
+
 namespace CodecManager{
-	class InternalDacWithPotentiometer : public iCodecManager
+
+    enum class eDither
+    {
+        NONE,        // plain truncation to 8 bit
+        TPDF,        // triangular dither of +-1 LSB, decorrelates the quantization error from the signal
+        TPDF_SHAPED, // TPDF plus first order error feedback, moves the quantization noise towards high frequencies
+    };
+
+	class InternalDacWithPotentiometer : public aCodecManager
     {
+    public:
+        static constexpr size_t CONVERSION_BUFFER_SAMPLES = 1024;
+
     private:
         uint32_t currentSampleRateHz{24000};
         dac_continuous_handle_t dac_handle{nullptr};
+        uint8_t *conversionBuffer{nullptr}; // CONVERSION_BUFFER_SAMPLES unsigned 8 bit samples, allocated once in Init
+        uint16_t volumeQ8{1 << 8};          // 256 means 1.0
+        eDither dither{eDither::TPDF_SHAPED};
+        uint32_t rngState{0x12345678};
+        int32_t shapingError{0}; // quantization error of the last sample in 16bit units, for the noise shaping
+
+        // int16 (already mixed to mono) -> unsigned 8 bit with volume; no branches, the compiler can vectorize it
+        static void Convert(const int16_t *in, size_t stride, uint8_t *out, size_t n, int32_t volumeQ8)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                int32_t v = (in[stride * i] * volumeQ8) >> 8;
+                out[i] = (uint8_t)((clip(v, (int32_t)INT16_MIN, (int32_t)INT16_MAX) + 0x8000) >> 8);
+            }
+        }
+
+        // same as Convert, but with TPDF dither and optional noise shaping. The error feedback creates a dependency between the samples, so this one stays scalar
+        void ConvertDithered(const int16_t *in, size_t stride, uint8_t *out, size_t n, int32_t volumeQ8, bool shaped)
+        {
+            uint32_t rng = rngState;
+            int32_t e = shaped ? shapingError : 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                int32_t v = ((in[stride * i] * volumeQ8) >> 8) - e;
+                rng = rng * 1664525 + 1013904223; // LCG; its upper two bytes give two independent uniform values
+                int32_t d = (int32_t)(rng >> 24) + (int32_t)((rng >> 16) & 0xFF) - 255;
+                int32_t q = clip((v + d + 0x8000 + 0x80) >> 8, (int32_t)0, (int32_t)255);
+                out[i] = (uint8_t)q;
+                e = shaped ? ((q << 8) - 0x8000) - v : 0;
+            }
+            rngState = rng;
+            shapingError = clip(e, (int32_t)-0x800, (int32_t)0x800); // keep the feedback bounded after clipping
+        }
+
+        void ConvertChunk(const int16_t *in, size_t stride, size_t n)
+        {
+            if (dither == eDither::NONE)
+            {
+                Convert(in, stride, conversionBuffer, n, volumeQ8);
+            }
+            else
+            {
+                ConvertDithered(in, stride, conversionBuffer, n, volumeQ8, dither == eDither::TPDF_SHAPED);
+            }
+        }
 
     public:
         ErrorCode SetPowerState(bool power) override
@@ -17,11 +75,19 @@ namespace CodecManager{
             return ErrorCode::OK;
         }
 
+        // The analog level is set by the potentiometer; volume is an additional digital attenuation, applied during the 8 bit conversion
         ErrorCode SetVolume(uint8_t volume) override
         {
+            volumeQ8 = volume + (volume >> 7); // 255 -> 256 = 1.0
             return ErrorCode::OK;
         }
 
+        void SetDither(eDither dither)
+        {
+            this->dither = dither;
+            shapingError = 0;
+        }
+
         ErrorCode SetSampleRate(uint32_t sampleRateHz) override
         {
             if (sampleRateHz == currentSampleRateHz)
@@ -31,10 +97,15 @@ namespace CodecManager{
             currentSampleRateHz = sampleRateHz;
             return Init();
         }
-        ErrorCode Init() override
+
+        ErrorCode Init()
         {
 
             ESP_LOGI(TAG, "Initializing I2S_NUM_0 for internal DAC with sample rate %lu", this->currentSampleRateHz);
+            if (!conversionBuffer)
+            {
+                conversionBuffer = new uint8_t[CONVERSION_BUFFER_SAMPLES];
+            }
             dac_continuous_config_t cont_cfg = {};
             cont_cfg.chan_mask = DAC_CHANNEL_MASK_CH0;
             cont_cfg.desc_num = 4;
@@ -49,76 +120,54 @@ namespace CodecManager{
             return ErrorCode::OK;
         }
 
+        // samples is the number of frames; 16 bit data is converted chunk by chunk via the preallocated conversionBuffer
         ErrorCode WriteAudioData(eChannels ch, eSampleBits bits, uint32_t sampleRateHz, size_t samples, void *buf) override
         {
-            // Needs Mono, 8bit
-            size_t dummy;
-            uint8_t newBuf[samples];
-            
-            if(ch==eChannels::ONE && bits==eSampleBits::EIGHT){
-                uint8_t *origBuf = (uint8_t *)buf;
-                ESP_ERROR_CHECK(dac_continuous_write(dac_handle, origBuf, samples, &dummy, -1));
+            if (!conversionBuffer)
+            {
+                return ErrorCode::NOT_YET_INITIALIZED;
             }
-            else if(ch==eChannels::ONE && bits==eSampleBits::SIXTEEN){
-                int16_t *origBuf = (int16_t *)buf;
-                int16_t max{INT16_MIN};
-                uint8_t maxU8{0};
-                int16_t min{INT16_MAX};
-                uint8_t minU8{0};
-                for (int i = 0; i < samples; i++)
+            if (sampleRateHz != currentSampleRateHz)
+            {
+                RETURN_ON_ERRORCODE(SetSampleRate(sampleRateHz));
+            }
+            size_t dummy;
+            if (bits == eSampleBits::EIGHT)
+            {
+                if (ch != eChannels::ONE)
                 {
-
-                    int val = (origBuf[i] + 0x8000) >> 8; // werte von 0 bis +255
-
-                    if (origBuf[i] < min)
-                    {
-                        min = origBuf[i];
-                        minU8 = val;
-                    }
-                    if (origBuf[i] > max)
-                    {
-                        max = origBuf[i];
-                        maxU8 = val;
-                    }
-                    newBuf[i] = val;
+                    return ErrorCode::FUNCTION_NOT_AVAILABLE;
                 }
-
-                //char *outBase64 = base64_encode(origBuf, 2*samples, nullptr);
-                //char *outBase64 = base64_encode(newBuf, samples, nullptr);
-                //printf("%s", outBase64);
-                //free(outBase64);
-
-                ESP_LOGD(TAG, "max=%d, min=%d, maxU8=%d, minU8=%d", max, min, maxU8, minU8);
-                ESP_ERROR_CHECK(dac_continuous_write(dac_handle, newBuf, samples, &dummy, -1));
+                RETURN_ERRORCODE_ON_ERROR(dac_continuous_write(dac_handle, (uint8_t *)buf, samples, &dummy, -1), ErrorCode::GENERIC_ERROR);
+                return ErrorCode::OK;
             }
-            else if(ch==eChannels::TWO && bits==eSampleBits::SIXTEEN){
-                int16_t *origBuf = (int16_t *)buf;
-                int16_t max{INT16_MIN};
-                uint8_t maxU8{0};
-                int16_t min{INT16_MAX};
-                uint8_t minU8{0};
-                for (int i = 0; i < samples; i++)
+            int16_t *origBuf = (int16_t *)buf;
+            for (size_t base = 0; base < samples; base += CONVERSION_BUFFER_SAMPLES)
+            {
+                size_t n = std::min(CONVERSION_BUFFER_SAMPLES, samples - base);
+                if (ch == eChannels::ONE)
                 {
-                    // Mische rechten und linken Kanal
-                    int val = (origBuf[2 * i] + 0x8000 + origBuf[2 * i + 1] + 0x8000) >> 9; // werte von 0 bis +255, 8 bits nach rechts und dann noch wegen dem mix durch 2 teilen
-
-                    if (origBuf[i] < min)
-                    {
-                        min = origBuf[i];
-                        minU8 = val;
-                    }
-                    if (origBuf[i] > max)
+                    ConvertChunk(origBuf + base, 1, n);
+                }
+                else
+                {
+                    // Mische rechten und linken Kanal in-place in den linken Kanal
+                    int16_t *frame = origBuf + 2 * base;
+                    for (size_t i = 0; i < n; i++)
                     {
-                        max = origBuf[i];
-                        maxU8 = val;
+                        frame[2 * i] = (frame[2 * i] + frame[2 * i + 1]) >> 1;
                     }
-                    newBuf[i] = val;
+                    ConvertChunk(frame, 2, n);
                 }
-                ESP_LOGI(TAG, "max=%d, min=%d, maxU8=%d, minU8=%d", max, min, maxU8, minU8);
-                ESP_ERROR_CHECK(dac_continuous_write(dac_handle, newBuf, samples, &dummy, -1));
+                RETURN_ERRORCODE_ON_ERROR(dac_continuous_write(dac_handle, conversionBuffer, n, &dummy, -1), ErrorCode::GENERIC_ERROR);
             }
-           
             return ErrorCode::OK;
         }
+
+        ~InternalDacWithPotentiometer()
+        {
+            delete[] conversionBuffer;
+        }
     };
-}
\ No newline at end of file
+}
+#undef TAG
@@ -0,0 +1,70 @@
+#pragma once
+#include <esp_http_client.h>
+#include <esp_log.h>
+#include "stream_source.hh"
+
+#define TAG "HTTPSTREAM"
+
+namespace AudioPlayer
+{
+    // Byte stream of an HTTP(S) GET, e.g. a MP3 file on a web server or an internet radio stream
+    class HttpSource : public iByteSource
+    {
+    private:
+        const char *url;
+        int timeoutMs;
+        esp_http_client_handle_t client{nullptr};
+
+    public:
+        HttpSource(const char *url, int timeoutMs = 5000) : url(url), timeoutMs(timeoutMs) {}
+
+        ErrorCode Open() override
+        {
+            esp_http_client_config_t config = {};
+            config.url = url;
+            config.timeout_ms = timeoutMs;
+            config.buffer_size = StreamReader::CHUNK_BYTES;
+            client = esp_http_client_init(&config);
+            if (!client)
+            {
+                return ErrorCode::GENERIC_ERROR;
+            }
+            esp_err_t err = esp_http_client_open(client, 0);
+            if (err != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Could not connect to %s (%s)", url, esp_err_to_name(err));
+                Close();
+                return ErrorCode::DEVICE_NOT_RESPONDING;
+            }
+            esp_http_client_fetch_headers(client);
+            int status = esp_http_client_get_status_code(client);
+            if (status != 200)
+            {
+                ESP_LOGE(TAG, "HTTP status %d for %s", status, url);
+                Close();
+                return ErrorCode::GENERIC_ERROR;
+            }
+            return ErrorCode::OK;
+        }
+
+        int Read(uint8_t *buf, size_t len) override
+        {
+            if (!client)
+                return -1;
+            return esp_http_client_read(client, (char *)buf, len);
+        }
+
+        void Close() override
+        {
+            if (!client)
+                return;
+            esp_http_client_close(client);
+            esp_http_client_cleanup(client);
+            client = nullptr;
+        }
+
+        ~HttpSource() { Close(); }
+    };
+}
+
+#undef TAG
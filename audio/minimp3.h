@@ -1434,8 +1434,10 @@ static int16_t mp3d_scale_pcm(float sample)
     s32 -= (s32 < 0);
     int16_t s = (int16_t)minimp3_clip_int16_arm(s32);
 #else
-    if (sample >=  32766.5) return (int16_t) 32767;
-    if (sample <= -32767.5) return (int16_t)-32768;
+    /* float constants: a double compare is a libgcc call per sample on single precision FPUs (Xtensa) and
+       on cores without FPU (RISC-V ESP32); both values are exact in float, so the result does not change */
+    if (sample >=  32766.5f) return (int16_t) 32767;
+    if (sample <= -32767.5f) return (int16_t)-32768;
     int16_t s = (int16_t)(sample + .5f);
     s -= (s < 0);   /* away from zero, to be compliant */
 #endif
@@ -1849,9 +1851,9 @@ void mp3dec_f32_to_s16(const float *in, int16_t *out, int num_samples)
     for(; i < num_samples; i++)
     {
         float sample = in[i] * 32768.0f;
-        if (sample >=  32766.5)
+        if (sample >=  32766.5f)
             out[i] = (int16_t) 32767;
-        else if (sample <= -32767.5)
+        else if (sample <= -32767.5f)
             out[i] = (int16_t)-32768;
         else
         {
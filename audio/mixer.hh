@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <common.hh>
+
+namespace AudioPlayer
+{
+    constexpr size_t MIXER_STREAMS = 4;          // main stream of the player plus three overlays
+    constexpr size_t MIXER_CHUNK_FRAMES = 256;   // overlays are pulled and mixed in chunks of this size, keeps the scratch buffers small
+    constexpr uint16_t GAIN_UNITY_Q15 = 1 << 15; // gains are unsigned Q1.15, so the maximum gain is almost 2.0
+
+    // Source of interleaved stereo int16 frames, e.g. a decoded MP3 file, a PCM clip or a synthesizer
+    class iAudioSource
+    {
+    public:
+        virtual uint32_t GetSampleRate() = 0;
+        // Writes up to "frames" stereo frames into buf and returns the number of frames written. 0 means: source is exhausted
+        virtual size_t Read(int16_t *buf, size_t frames) = 0;
+        virtual ~iAudioSource() {}
+    };
+
+    // Plays a PCM clip from memory (e.g. embedded with FLASH_FILE)
+    class PcmSource : public iAudioSource
+    {
+    private:
+        const int16_t *samples;
+        size_t frames;
+        uint8_t channels;
+        uint32_t sampleRate;
+        size_t pos{0};
+
+    public:
+        PcmSource(const int16_t *samples, size_t frames, uint8_t channels, uint32_t sampleRate) : samples(samples), frames(frames), channels(channels), sampleRate(sampleRate) {}
+
+        void Rewind() { pos = 0; }
+
+        uint32_t GetSampleRate() override { return sampleRate; }
+
+        size_t Read(int16_t *buf, size_t maxFrames) override
+        {
+            size_t n = std::min(maxFrames, frames - pos);
+            if (channels == 2)
+            {
+                memcpy(buf, samples + 2 * pos, n * 2 * sizeof(int16_t));
+            }
+            else
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    buf[2 * i] = buf[2 * i + 1] = samples[pos + i];
+                }
+            }
+            pos += n;
+            return n;
+        }
+    };
+
+    namespace Mixer
+    {
+        inline int16_t Saturate16(int32_t v)
+        {
+            return (int16_t)clip(v, (int32_t)INT16_MIN, (int32_t)INT16_MAX);
+        }
+
+        // out[i] = sat16(sum_k((in[k][i] * gainQ15[k]) >> 15)) for "samples" int16 values.
+        // All inputs share the same channel layout. in[0] may be identical to out (in-place mixing into the main buffer).
+        // The accumulation runs stream by stream over small chunks, so the inner loops are free of branches and data dependencies
+        inline void Mix(int16_t *out, const int16_t *const *in, const uint16_t *gainQ15, size_t streams, size_t samples)
+        {
+            constexpr size_t CHUNK = 64;
+            int32_t acc[CHUNK];
+            for (size_t base = 0; base < samples; base += CHUNK)
+            {
+                const size_t n = std::min(CHUNK, samples - base);
+                for (size_t i = 0; i < n; i++)
+                {
+                    acc[i] = 0;
+                }
+                for (size_t k = 0; k < streams; k++)
+                {
+                    const int16_t *src = in[k] + base;
+                    const int32_t g = gainQ15[k];
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        acc[i] += (src[i] * g) >> 15;
+                    }
+                }
+                for (size_t i = 0; i < n; i++)
+                {
+                    out[base + i] = Saturate16(acc[i]);
+                }
+            }
+        }
+
+        // Linear gain ramp with sample accuracy. The gain is held with FRAC_BITS additional fraction bits, so that long ramps with steps
+        // smaller than one Q15 unit still move. Changing the gain of a stream via a ramp of a few ms avoids the zipper noise of step changes
+        class GainRamp
+        {
+        private:
+            static constexpr int FRAC_BITS = 15;
+            int32_t current{GAIN_UNITY_Q15 << FRAC_BITS};
+            int32_t step{0};
+            uint32_t framesLeft{0};
+            uint16_t target{GAIN_UNITY_Q15};
+
+        public:
+            void Set(uint16_t gainQ15)
+            {
+                current = (int32_t)gainQ15 << FRAC_BITS;
+                target = gainQ15;
+                step = 0;
+                framesLeft = 0;
+            }
+
+            // starts a ramp from the current gain to gainQ15, that ends after "frames" frames
+            void RampTo(uint16_t gainQ15, uint32_t frames)
+            {
+                if (frames == 0)
+                {
+                    Set(gainQ15);
+                    return;
+                }
+                target = gainQ15;
+                framesLeft = frames;
+                step = (((int32_t)gainQ15 << FRAC_BITS) - current) / (int32_t)frames;
+            }
+
+            uint16_t Current() const { return current >> FRAC_BITS; }
+            uint16_t Target() const { return target; }
+            bool IsRamping() const { return framesLeft > 0; }
+            bool IsUnity() const { return framesLeft == 0 && target == GAIN_UNITY_Q15; }
+            bool IsSilent() const { return framesLeft == 0 && target == 0; }
+
+            // acc[i] += (src[i] * gain) >> 15 for "frames" stereo frames; advances the ramp by "frames"
+            void Accumulate(int32_t *acc, const int16_t *src, size_t frames)
+            {
+                size_t ramped = std::min<size_t>(frames, framesLeft);
+                int32_t g = current;
+                for (size_t i = 0; i < ramped; i++)
+                {
+                    const int32_t q = g >> FRAC_BITS;
+                    acc[2 * i] += (src[2 * i] * q) >> 15;
+                    acc[2 * i + 1] += (src[2 * i + 1] * q) >> 15;
+                    g += step;
+                }
+                framesLeft -= ramped;
+                if (framesLeft > 0)
+                {
+                    current = g;
+                    return;
+                }
+                current = (int32_t)target << FRAC_BITS; // no rounding drift at the end of the ramp
+                const int32_t q = target;
+                for (size_t i = 2 * ramped; i < 2 * frames; i++)
+                {
+                    acc[i] += (src[i] * q) >> 15;
+                }
+            }
+        };
+
+        // Like Mix, but for interleaved stereo frames with a GainRamp per stream, which is advanced by "frames"
+        inline void MixRamped(int16_t *out, const int16_t *const *in, GainRamp *const *ramps, size_t streams, size_t frames)
+        {
+            constexpr size_t CHUNK_FRAMES = 32;
+            int32_t acc[2 * CHUNK_FRAMES];
+            for (size_t base = 0; base < frames; base += CHUNK_FRAMES)
+            {
+                const size_t n = std::min(CHUNK_FRAMES, frames - base);
+                for (size_t i = 0; i < 2 * n; i++)
+                {
+                    acc[i] = 0;
+                }
+                for (size_t k = 0; k < streams; k++)
+                {
+                    ramps[k]->Accumulate(acc, in[k] + 2 * base, n);
+                }
+                for (size_t i = 0; i < 2 * n; i++)
+                {
+                    out[2 * base + i] = Saturate16(acc[i]);
+                }
+            }
+        }
+    }
+}
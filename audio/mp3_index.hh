@@ -0,0 +1,178 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <esp_log.h>
+// needs the static header helpers (hdr_valid, hdr_frame_bytes, ...) of minimp3.h, so include it after minimp3.h with MINIMP3_IMPLEMENTATION
+
+#define TAG "MP3IDX"
+
+namespace AudioPlayer
+{
+    // Byte offset of every frame of an MP3 file in memory.
+    // All frames of a (non free format) MP3 stream have the same number of samples, so the timestamp of frame k is k*samplesPerFrame/hz
+    // and seeking to a time position is a single division plus an array access.
+    class Mp3Index
+    {
+    private:
+        const uint8_t *file{nullptr};
+        size_t fileLen{0};
+        uint32_t *offsets{nullptr};
+        uint32_t frameCount{0};
+        uint32_t hz{0};
+        uint16_t samplesPerFrame{0};
+        uint8_t channels{0};
+        int32_t firstFrame{-1};
+
+        // size of an ID3v2 tag at the start of the file, 0 if there is none
+        static size_t Id3v2Size(const uint8_t *file, size_t fileLen){
+            if(fileLen<10 || file[0]!='I' || file[1]!='D' || file[2]!='3') return 0;
+            size_t size = ((file[6]&0x7F)<<21) | ((file[7]&0x7F)<<14) | ((file[8]&0x7F)<<7) | (file[9]&0x7F);
+            size += 10;
+            if(file[5]&0x10) size+=10; //footer
+            return std::min(size, fileLen);
+        }
+
+        // length of the frame at h including padding; 0 for free format frames, whose length is not in the header
+        static int FrameBytes(const uint8_t *h){
+            int bytes = hdr_frame_bytes(h, 0);
+            return bytes?bytes+hdr_padding(h):0;
+        }
+
+        // walks the file from frame to frame; if offsets is not null, the frame offsets are stored there
+        uint32_t Walk(uint32_t *offsets) const{
+            const uint8_t *first = file+firstFrame;
+            uint32_t n{0};
+            int pos = firstFrame;
+            while(pos>=0 && pos+HDR_SIZE<=(int)fileLen){
+                const uint8_t *h = file+pos;
+                if(!hdr_compare(first, h)){
+                    pos = FindFrame(file, fileLen, pos+1); //garbage between frames
+                    continue;
+                }
+                int bytes = FrameBytes(h);
+                if(bytes==0 || pos+bytes>(int)fileLen) break; //truncated last frame is not played anyway
+                if(offsets) offsets[n]=pos;
+                n++;
+                pos+=bytes;
+            }
+            return n;
+        }
+
+    public:
+        // Searches for the next valid frame header at or after offset. Candidates are found with memchr, a header is only accepted
+        // if the following frame starts with a matching header as well (or the frame ends exactly at the end of the file).
+        static int FindFrame(const uint8_t *file, size_t fileLen, int offset){
+            while(offset>=0 && offset+HDR_SIZE<=(int)fileLen){
+                const uint8_t *h = (const uint8_t *)memchr(file+offset, 0xFF, fileLen-HDR_SIZE+1-offset);
+                if(!h) return -1;
+                offset = h-file;
+                if(hdr_valid(h)){
+                    int bytes = FrameBytes(h);
+                    if(bytes==0) return offset; //free format: let the decoder sort it out
+                    int next = offset+bytes;
+                    if(next==(int)fileLen || (next+HDR_SIZE<=(int)fileLen && hdr_compare(h, file+next))) return offset;
+                }
+                offset++;
+            }
+            return -1;
+        }
+
+        // (Re)builds the index for file. Returns false, if no frame has been found. For free format files only the first frame is known,
+        // so OffsetOfFrame/FrameAt fall back to the first frame
+        bool Build(const uint8_t *file, size_t fileLen){
+            Clear();
+            this->file=file;
+            this->fileLen=fileLen;
+            firstFrame = FindFrame(file, fileLen, Id3v2Size(file, fileLen));
+            if(firstFrame<0) return false;
+            const uint8_t *h = file+firstFrame;
+            hz = hdr_sample_rate_hz(h);
+            channels = HDR_IS_MONO(h)?1:2;
+            samplesPerFrame = hdr_frame_samples(h);
+            uint32_t n = Walk(nullptr);
+            if(n>0){
+                offsets = new uint32_t[n];
+                frameCount = Walk(offsets);
+            }
+            ESP_LOGI(TAG, "Indexed File=%p: %lu frames, %lums, %luHz, %d channels", file, frameCount, TimeOfFrameMs(frameCount), hz, channels);
+            return true;
+        }
+
+        void Clear(){
+            delete[] offsets;
+            offsets=nullptr;
+            file=nullptr;
+            fileLen=0;
+            frameCount=0;
+            hz=0;
+            samplesPerFrame=0;
+            channels=0;
+            firstFrame=-1;
+        }
+
+        bool IsFor(const uint8_t *file, size_t fileLen) const { return this->file==file && this->fileLen==fileLen; }
+        bool IsValid() const { return firstFrame>=0; }
+        int32_t GetFirstFrame() const { return firstFrame; }
+        uint32_t GetFrameCount() const { return frameCount; }
+        uint32_t GetSampleRate() const { return hz; }
+        uint8_t GetChannels() const { return channels; }
+        uint32_t GetDurationMs() const { return TimeOfFrameMs(frameCount); }
+
+        uint32_t TimeOfFrameMs(uint32_t frame) const{
+            return hz?(uint64_t)frame*samplesPerFrame*1000/hz:0;
+        }
+
+        uint32_t FrameOfTimeMs(uint32_t ms) const{
+            if(frameCount==0) return 0;
+            return std::min<uint64_t>((uint64_t)ms*hz/(1000*samplesPerFrame), frameCount-1);
+        }
+
+        // byte offset of frame k; the first frame, if the index is empty (free format)
+        int32_t OffsetOfFrame(uint32_t frame) const{
+            if(frameCount==0) return firstFrame;
+            return offsets[std::min(frame, frameCount-1)];
+        }
+
+        // index of the frame, that starts at or before the byte offset
+        uint32_t FrameAt(int32_t offset) const{
+            if(frameCount==0) return 0;
+            auto it = std::upper_bound(offsets, offsets+frameCount, (uint32_t)std::max(offset, (int32_t)0));
+            return it==offsets ? 0 : (it-offsets)-1;
+        }
+
+        ~Mp3Index(){ Clear(); }
+    };
+
+    // Keeps the indices of the recently played files, so that they are built only once per file.
+    // An index takes 4 bytes per frame, about 90KB for a 10 minute file at 44.1kHz, so the cache may hold up to N times that on the heap.
+    // Get never rebuilds inUse (the index of the playing order), because the player and GetPositionMs/GetDurationMs still read it
+    template<size_t N>
+    class Mp3IndexCache
+    {
+        static_assert(N>=2, "one entry is in use while the next file is indexed");
+    private:
+        Mp3Index entries[N];
+        uint32_t lastUse[N]{};
+        uint32_t useCounter{0};
+
+    public:
+        const Mp3Index *Get(const uint8_t *file, size_t fileLen, const Mp3Index *inUse){
+            size_t victim{N};
+            for(size_t i=0;i<N;i++){
+                if(entries[i].IsFor(file, fileLen)){
+                    lastUse[i]=++useCounter;
+                    return &entries[i];
+                }
+                if(&entries[i]==inUse) continue;
+                if(victim==N || lastUse[i]<lastUse[victim]) victim=i;
+            }
+            entries[victim].Build(file, fileLen);
+            lastUse[victim]=++useCounter;
+            return &entries[victim];
+        }
+    };
+}
+
+#undef TAG
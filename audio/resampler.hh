@@ -0,0 +1,229 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <common.hh>
+#include "mixer.hh"
+
+namespace AudioPlayer
+{
+    // Polyphase FIR sample rate converter for interleaved stereo int16 frames.
+    // The windowed sinc prototype filter is sampled at PHASES sub-sample positions, each phase has TAPS Q15 coefficients.
+    // The coefficients for the exact fractional input position are interpolated linearly between the two neighbouring phases,
+    // so each output frame costs TAPS coefficient interpolations plus TAPS multiply-accumulates per channel.
+    // For downsampling the cutoff is lowered to the output Nyquist frequency, so no aliasing is produced.
+    // The filter delays by TAPS/2 input frames: the output of the last TAPS/2 frames of a stream only comes with Flush, and a new
+    // stream has to start with Reset (or Configure), otherwise it is convolved with the end of the previous one.
+    class Resampler
+    {
+    public:
+        static constexpr size_t TAPS = 24;
+        static constexpr size_t PHASES = 128;
+        static constexpr size_t WORK_FRAMES = 256;
+
+    private:
+        static constexpr int FRAC_BITS = 32;
+        static constexpr int PHASE_BITS = 7; // log2(PHASES)
+        int16_t coeffs[PHASES + 1][TAPS]; // last row is phase 0 shifted by one input frame, used for interpolation
+        int16_t work[2 * (TAPS - 1 + WORK_FRAMES)]; // TAPS-1 frames history plus new input
+        size_t workFrames{0};
+        uint64_t pos{0};  // position of the next output frame in work, 32 fractional bits
+        uint64_t step{0}; // inRate/outRate, 32 fractional bits
+        uint32_t inRate{0};
+        uint32_t outRate{0};
+        bool flushed{false}; // Read: the source is exhausted and the silence of Flush has been appended
+
+        static double besselI0(double x)
+        {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 20; k++)
+            {
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        void buildCoefficients()
+        {
+            constexpr double BETA = 7.0; // Kaiser window, approx. 70dB stopband
+            const double cutoff = 0.92 * std::min(1.0, (double)outRate / inRate);
+            const double halfWidth = TAPS / 2.0;
+            for (size_t p = 0; p <= PHASES; p++)
+            {
+                const double center = TAPS / 2 - 1 + (double)p / PHASES;
+                double h[TAPS];
+                double sum = 0;
+                for (size_t k = 0; k < TAPS; k++)
+                {
+                    const double t = k - center;
+                    const double x = M_PI * cutoff * t;
+                    const double sinc = (t == 0.0) ? 1.0 : sin(x) / x;
+                    const double r = t / halfWidth;
+                    const double w = (r * r < 1.0) ? besselI0(BETA * sqrt(1.0 - r * r)) / besselI0(BETA) : 0.0;
+                    h[k] = sinc * w;
+                    sum += h[k];
+                }
+                // normalize every phase to unity DC gain, otherwise the phases modulate the signal
+                for (size_t k = 0; k < TAPS; k++)
+                {
+                    coeffs[p][k] = (int16_t)lrint(h[k] / sum * (1 << 15));
+                }
+            }
+        }
+
+        // Discards the frames of the work buffer that are no longer needed
+        void compact()
+        {
+            const size_t consumed = std::min((size_t)(pos >> FRAC_BITS), workFrames);
+            if (consumed > 0)
+            {
+                memmove(work, work + 2 * consumed, (workFrames - consumed) * 2 * sizeof(int16_t));
+                workFrames -= consumed;
+                pos -= (uint64_t)consumed << FRAC_BITS;
+            }
+        }
+
+        // Appends up to inFrames frames to the work buffer after discarding the frames that are no longer needed
+        size_t append(const int16_t *in, size_t inFrames)
+        {
+            compact();
+            const size_t n = std::min(inFrames, TAPS - 1 + WORK_FRAMES - workFrames);
+            if (n > 0)
+            {
+                memcpy(work + 2 * workFrames, in, n * 2 * sizeof(int16_t));
+            }
+            workFrames += n;
+            return n;
+        }
+
+        size_t produce(int16_t *out, size_t maxOut)
+        {
+            size_t produced = 0;
+            while (produced < maxOut && (pos >> FRAC_BITS) + TAPS <= workFrames)
+            {
+                const int16_t *x = work + 2 * (pos >> FRAC_BITS);
+                const uint32_t frac = (uint32_t)pos;
+                const int16_t *c0 = coeffs[frac >> (FRAC_BITS - PHASE_BITS)];
+                const int16_t *c1 = c0 + TAPS;
+                const int32_t alpha = (frac >> (FRAC_BITS - PHASE_BITS - 15)) & 0x7FFF; // Q15 position between c0 and c1
+                int32_t l = 1 << 14;
+                int32_t r = 1 << 14;
+                for (size_t k = 0; k < TAPS; k++)
+                {
+                    const int32_t c = c0[k] + (((c1[k] - c0[k]) * alpha) >> 15);
+                    l += x[2 * k] * c;
+                    r += x[2 * k + 1] * c;
+                }
+                out[2 * produced] = Mixer::Saturate16(l >> 15);
+                out[2 * produced + 1] = Mixer::Saturate16(r >> 15);
+                produced++;
+                pos += step;
+            }
+            return produced;
+        }
+
+    public:
+        // Resets the filter history. The coefficients are only recalculated, when the ratio changes
+        void Configure(uint32_t inRate, uint32_t outRate)
+        {
+            if (inRate != this->inRate || outRate != this->outRate)
+            {
+                this->inRate = inRate;
+                this->outRate = outRate;
+                step = ((uint64_t)inRate << FRAC_BITS) / outRate;
+                buildCoefficients();
+            }
+            Reset();
+        }
+
+        void Reset()
+        {
+            // start with silence as history, so the first output frame is aligned with the first input frame
+            workFrames = TAPS / 2 - 1;
+            memset(work, 0, sizeof(work));
+            pos = 0;
+            flushed = false;
+        }
+
+        // Push mode: ends the stream. The last input frames, which are still in the filter, are pushed out with TAPS/2 frames of
+        // silence; returns the number of output frames (at most about TAPS/2 * outRate/inRate + 1). Resets afterwards
+        size_t Flush(int16_t *out, size_t maxOut)
+        {
+            static const int16_t silence[2 * (TAPS / 2)]{};
+            size_t used{0};
+            size_t produced = Process(silence, TAPS / 2, &used, out, maxOut);
+            Reset();
+            return produced;
+        }
+
+        uint32_t GetInRate() { return inRate; }
+        uint32_t GetOutRate() { return outRate; }
+
+        // Push mode: converts inFrames input frames into at most maxOut output frames.
+        // Returns the number of output frames, *inConsumed is the number of input frames that have been used
+        size_t Process(const int16_t *in, size_t inFrames, size_t *inConsumed, int16_t *out, size_t maxOut)
+        {
+            size_t consumed = 0;
+            size_t produced = 0;
+            while (true)
+            {
+                produced += produce(out + 2 * produced, maxOut - produced);
+                if (produced == maxOut || consumed == inFrames)
+                    break;
+                consumed += append(in + 2 * consumed, inFrames - consumed);
+            }
+            *inConsumed = consumed;
+            return produced;
+        }
+
+        // Pull mode: reads as many frames from source as needed to deliver "frames" output frames.
+        // Returns less than "frames" only if the source is exhausted; then the filter has been flushed like with Flush
+        size_t Read(iAudioSource *source, int16_t *out, size_t frames)
+        {
+            size_t produced = 0;
+            while (true)
+            {
+                produced += produce(out + 2 * produced, frames - produced);
+                if (produced == frames)
+                    break;
+                compact();
+                size_t n = flushed ? 0 : source->Read(work + 2 * workFrames, TAPS - 1 + WORK_FRAMES - workFrames);
+                if (n == 0)
+                {
+                    if (flushed)
+                        break;
+                    memset(work + 2 * workFrames, 0, TAPS / 2 * 2 * sizeof(int16_t)); // compact left at most TAPS frames
+                    n = TAPS / 2;
+                    flushed = true;
+                }
+                workFrames += n;
+            }
+            return produced;
+        }
+    };
+
+    // Wraps a source and converts its samples to another rate
+    class ResamplingSource : public iAudioSource
+    {
+    private:
+        iAudioSource *source{nullptr};
+        Resampler resampler;
+
+    public:
+        void SetSource(iAudioSource *source, uint32_t outRate)
+        {
+            this->source = source;
+            resampler.Configure(source->GetSampleRate(), outRate);
+        }
+
+        uint32_t GetSampleRate() override { return resampler.GetOutRate(); }
+
+        size_t Read(int16_t *buf, size_t frames) override
+        {
+            return source ? resampler.Read(source, buf, frames) : 0;
+        }
+    };
+}
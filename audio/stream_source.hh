@@ -0,0 +1,242 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+#include <esp_log.h>
+#include <errorcodes.hh>
+
+#define TAG "STREAM"
+
+namespace AudioPlayer
+{
+    // Sequential byte source for streamed playback. Open/Read/Close are called from the reader task of StreamReader
+    class iByteSource
+    {
+    public:
+        virtual ErrorCode Open() = 0;
+        // returns the number of bytes read, 0 at the end of the stream, <0 on error
+        virtual int Read(uint8_t *buf, size_t len) = 0;
+        virtual void Close() = 0;
+        virtual ~iByteSource() = default;
+    };
+
+    // File in any mounted VFS, e.g. "/spiffs/track.mp3" after SpiffsManager::Init(); on the host any local file
+    class FileSource : public iByteSource
+    {
+    private:
+        const char *path;
+        FILE *f{nullptr};
+
+    public:
+        FileSource(const char *path) : path(path) {}
+
+        ErrorCode Open() override
+        {
+            f = fopen(path, "rb");
+            if (!f)
+            {
+                ESP_LOGE(TAG, "Could not open %s", path);
+                return ErrorCode::GENERIC_ERROR;
+            }
+            return ErrorCode::OK;
+        }
+
+        int Read(uint8_t *buf, size_t len) override
+        {
+            if (!f)
+                return -1;
+            size_t n = fread(buf, 1, len, f);
+            return n > 0 ? (int)n : (ferror(f) ? -1 : 0);
+        }
+
+        void Close() override
+        {
+            if (f)
+                fclose(f);
+            f = nullptr;
+        }
+
+        ~FileSource() { Close(); }
+    };
+
+    // Reads an iByteSource in its own task into a bounded ring buffer (read-ahead) and provides the data as a contiguous window,
+    // because mp3dec_decode_frame needs a complete frame in one piece. The task blocks, when the ring buffer is full, so the read-ahead
+    // never exceeds RING_BYTES. At 128kbit/s, the default ring covers about one second, enough to bridge SPIFFS erase stalls and network jitter.
+    // Start/Stop/Window/IsExhausted are called from one task (the player). Stop does not wait for the reader task, which may be blocked
+    // in Read (HTTP) up to the read timeout of the source; the teardown is completed by the following calls, once the task has closed
+    // the source. A source started meanwhile is handed to the task only then, so it never sees data or the stop request of its predecessor
+    class StreamReader
+    {
+    public:
+        static constexpr size_t RING_BYTES = 16 * 1024;
+        static constexpr size_t WINDOW_BYTES = 4 * 1024; // a few frames; the largest MP3 frame has 1441 bytes
+        static constexpr size_t MIN_WINDOW_BYTES = 2 * 1441; // less is only decoded at the end of the stream
+        static constexpr size_t CHUNK_BYTES = 1024;
+        static constexpr TickType_t STARVE_WAIT_TICKS = pdMS_TO_TICKS(20);
+
+    private:
+        StreamBufferHandle_t ring{nullptr};
+        QueueHandle_t sourceQueue{nullptr};
+        SemaphoreHandle_t sourceDone{nullptr}; // given by the task after each source has been closed
+        volatile bool stopRequested{false};
+        volatile bool sourceFinished{true};    // set by the task right before it gives sourceDone
+        bool active{false};
+        bool stopping{false};                  // Stop has been called, the task has not closed the source yet
+        iByteSource *nextSource{nullptr};      // started while stopping; handed to the task after the teardown
+        uint8_t window[WINDOW_BYTES];
+        size_t windowPos{0};
+        size_t windowFill{0};
+        uint8_t chunk[CHUNK_BYTES];
+
+        static void task(void *p)
+        {
+            StreamReader *myself = static_cast<StreamReader *>(p);
+            iByteSource *source;
+            while (true)
+            {
+                xQueueReceive(myself->sourceQueue, &source, portMAX_DELAY);
+                if (source->Open() == ErrorCode::OK)
+                {
+                    while (!myself->stopRequested)
+                    {
+                        int n = source->Read(myself->chunk, CHUNK_BYTES);
+                        if (n <= 0)
+                        {
+                            if (n < 0)
+                                ESP_LOGW(TAG, "Read error, stream ends");
+                            break;
+                        }
+                        size_t sent{0};
+                        while (sent < (size_t)n && !myself->stopRequested)
+                        {
+                            sent += xStreamBufferSend(myself->ring, myself->chunk + sent, n - sent, pdMS_TO_TICKS(50));
+                        }
+                    }
+                    source->Close();
+                }
+                myself->sourceFinished = true; // before the give: after it, Settle may already hand over the next source
+                xSemaphoreGive(myself->sourceDone);
+            }
+        }
+
+        // Completes a Stop, waiting at most wait for the task to close the source: the task is idle then, so the ring can be reset
+        // without a blocked sender. Then hands a source, that has been started meanwhile, to the task. Returns false while stopping
+        bool Settle(TickType_t wait)
+        {
+            if (stopping)
+            {
+                if (xSemaphoreTake(sourceDone, wait) != pdTRUE)
+                    return false;
+                xStreamBufferReset(ring);
+                stopRequested = false;
+                stopping = false;
+            }
+            if (nextSource)
+            {
+                sourceFinished = false;
+                xQueueSend(sourceQueue, &nextSource, 0);
+                nextSource = nullptr;
+            }
+            return true;
+        }
+
+    public:
+        ErrorCode Init()
+        {
+            if (ring)
+                return ErrorCode::OK;
+            ring = xStreamBufferCreate(RING_BYTES, 1);
+            sourceQueue = xQueueCreate(1, sizeof(iByteSource *));
+            sourceDone = xSemaphoreCreateBinary();
+            if (!ring || !sourceQueue || !sourceDone)
+                return ErrorCode::GENERIC_ERROR;
+            return xTaskCreate(task, "StreamReader", 4096, this, 10, nullptr) == pdPASS ? ErrorCode::OK : ErrorCode::GENERIC_ERROR;
+        }
+
+        // starts reading source; a previous source has to be stopped before. If its task is still closing it, source starts after that
+        ErrorCode Start(iByteSource *source)
+        {
+            if (!ring)
+                return ErrorCode::NOT_YET_INITIALIZED;
+            if (active)
+                return ErrorCode::INVALID_STATE;
+            windowPos = windowFill = 0;
+            active = true;
+            nextSource = source;
+            Settle(0);
+            return ErrorCode::OK;
+        }
+
+        // Aborts the current source without waiting for the task; the source stays in use by the task until it has been closed,
+        // i.e. up to the read timeout of the source (e.g. HttpSource)
+        void Stop()
+        {
+            if (!active)
+                return;
+            active = false;
+            windowPos = windowFill = 0;
+            if (nextSource)
+            {
+                nextSource = nullptr; // has never been handed to the task; its predecessor is still stopping
+                return;
+            }
+            if (sourceFinished)
+            {
+                // the task is done with the source (and gives sourceDone right now): drop what has not been played
+                xSemaphoreTake(sourceDone, portMAX_DELAY);
+                xStreamBufferReset(ring);
+                return;
+            }
+            stopping = true;
+            stopRequested = true;
+        }
+
+        // no more data will come: the source has been read completely and everything has been taken out of the window
+        bool IsExhausted()
+        {
+            return Settle(0) && sourceFinished && xStreamBufferIsEmpty(ring) && windowPos == windowFill;
+        }
+
+        // Compacts and refills the window from the ring buffer. Returns the number of contiguous bytes at *data. Returns 0, if less than
+        // MIN_WINDOW_BYTES are available and the source is still running (or not yet running, because its predecessor is still being
+        // closed), so that no frame gets cut off. Waits at most STARVE_WAIT_TICKS.
+        size_t Window(const uint8_t **data)
+        {
+            *data = window;
+            if (!Settle(STARVE_WAIT_TICKS))
+                return 0; // the previous source is still being closed
+            if (windowPos > 0)
+            {
+                memmove(window, window + windowPos, windowFill - windowPos);
+                windowFill -= windowPos;
+                windowPos = 0;
+            }
+            while (windowFill < WINDOW_BYTES)
+            {
+                TickType_t wait = windowFill < MIN_WINDOW_BYTES && !sourceFinished ? STARVE_WAIT_TICKS : 0;
+                size_t n = xStreamBufferReceive(ring, window + windowFill, WINDOW_BYTES - windowFill, wait);
+                if (n == 0)
+                    break;
+                windowFill += n;
+            }
+            *data = window;
+            if (windowFill < MIN_WINDOW_BYTES && !(sourceFinished && xStreamBufferIsEmpty(ring)))
+                return 0;
+            return windowFill;
+        }
+
+        void Consume(size_t bytes)
+        {
+            windowPos = std::min(windowPos + bytes, windowFill);
+        }
+    };
+}
+
+#undef TAG
@@ -0,0 +1,420 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <common.hh>
+#include <esp_cpu.h>
+#include "mixer.hh"
+
+namespace AudioPlayer
+{
+    // same layout as BUZZER::Note, so that the RTTTL songs of the ringtones component can be played by both
+    struct Note
+    {
+        uint16_t freq; // 0 means rest
+        uint16_t durationMs; // {0,0} ends the song
+    };
+
+    // songs.hh.inc has no include guard, so this copy exists even in a translation unit, that already included it into BUZZER
+    namespace Ringtones
+    {
+#define END_OF_SONG {0, 0}
+#include <songs.hh.inc>
+#undef END_OF_SONG
+        constexpr size_t SONG_COUNT = sizeof(RINGTONE_SOUNDS) / sizeof(RINGTONE_SOUNDS[0]);
+    }
+
+    // Sound of a synthesizer voice: two operator FM (a sine modulating the phase of a sine carrier) with an ADSR envelope.
+    // fmRatioQ8==0 or fmIndex==0 gives a pure sine
+    struct Instrument
+    {
+        uint16_t attackMs;
+        uint16_t decayMs;
+        uint16_t sustainQ15; // level after decay, GAIN_UNITY_Q15 means full level
+        uint16_t releaseMs;
+        uint16_t fmRatioQ8;  // modulator frequency / carrier frequency, 256 means 1.0
+        float fmIndex;       // modulation index in radians, 0...pi
+    };
+
+    namespace Instruments
+    {
+        constexpr Instrument SINE{5, 100, 26000, 60, 0, 0.0f};
+        constexpr Instrument EPIANO{3, 600, 8000, 150, 256, 1.5f};
+        constexpr Instrument BELL{2, 900, 0, 400, 896, 2.5f}; // ratio 3.5: inharmonic partials
+        constexpr Instrument BRASS{40, 150, 20000, 80, 256, 3.0f};
+    }
+
+    // CPU time of Synthesizer::Read in cycles of the core it runs on
+    struct SynthStatistics
+    {
+        uint32_t frames;      // rendered frames
+        uint32_t voiceFrames; // rendered frames summed over the active voices
+        uint64_t cycles;
+    };
+
+    // Polyphonic FM synthesizer, renders interleaved stereo int16 frames (the same signal on both channels).
+    // Voices are rendered in sub blocks of SUB_BLOCK_FRAMES: the envelope state machine runs once per sub block and yields a linear ramp,
+    // so the per sample loop only consists of two phase accumulators, two table lookups and three multiplications.
+    // Up to MAX_TRACKS note sequences (e.g. RTTTL songs) are played sample accurately by the built-in sequencer.
+    // CPU budget: not measured on target yet. On the host, a voice-sample takes 2-3ns (host_test/synth_test.cc); the estimate of 25-30
+    // Xtensa cycles per voice-sample gives about 5% of a 240MHz core for 8 voices at 44.1kHz (5442 cycles per frame). GetStatistics
+    // measures it with the cycle counter; the player logs the result at the end of every synthesizer order
+    class Synthesizer : public iAudioSource
+    {
+    public:
+        static constexpr size_t VOICES = 8;
+        static constexpr size_t MAX_TRACKS = 4;
+        static constexpr size_t SUB_BLOCK_FRAMES = 16;
+        static constexpr uint16_t DEFAULT_VELOCITY_Q15 = GAIN_UNITY_Q15 / 4; // 4 voices at full level reach full scale
+        static constexpr uint16_t NOTE_GAP_MS = 20; // articulation: the note is released this time before the next one starts
+
+    private:
+        static constexpr int TABLE_BITS = 10;
+        static constexpr int ENV_BITS = 24; // envelope level 1<<ENV_BITS means full level
+
+        enum class Stage : uint8_t
+        {
+            IDLE,
+            ATTACK,
+            DECAY,
+            SUSTAIN,
+            RELEASE,
+        };
+
+        struct Voice
+        {
+            Stage stage{Stage::IDLE};
+            uint32_t carrierPhase{0};
+            uint32_t carrierInc{0};
+            uint32_t modPhase{0};
+            uint32_t modInc{0};
+            int32_t fmDepth{0};   // phase offset per Q15 unit of the modulator
+            int32_t env{0};       // current level, ENV_BITS
+            int32_t envInc{0};    // per sample in the current stage
+            int32_t sustain{0};
+            int32_t releaseInc{0};
+            uint32_t stageFrames{0}; // remaining frames of ATTACK/DECAY/RELEASE
+            uint16_t velocityQ15{0};
+            uint32_t age{0};
+            const Instrument *instrument{nullptr};
+        };
+
+        struct Track
+        {
+            const Note *next{nullptr};
+            const Instrument *instrument{nullptr};
+            uint16_t velocityQ15{0};
+            int voice{-1};            // voice of the note, that is playing
+            uint32_t voiceAge{0};     // age of that voice at NoteOn; differs, if the voice has been stolen meanwhile
+            uint32_t framesToNoteOff{0};
+            uint32_t framesToNextNote{0};
+        };
+
+        int16_t sineTable[(1 << TABLE_BITS) + 1];
+        Voice voices[VOICES];
+        Track tracks[MAX_TRACKS];
+        uint32_t sampleRate;
+        uint32_t ageCounter{0};
+        SynthStatistics statistics{};
+        int32_t mix[SUB_BLOCK_FRAMES];
+
+        uint32_t MsToFrames(uint32_t ms) const { return (uint64_t)ms * sampleRate / 1000; }
+
+        uint32_t FreqToInc(float hz) const { return (uint32_t)(hz / sampleRate * 4294967296.0f); }
+
+        // computes envelope increment and stage length for the next stage
+        void EnterStage(Voice &v, Stage stage)
+        {
+            v.stage = stage;
+            const Instrument &in = *v.instrument;
+            switch (stage)
+            {
+            case Stage::ATTACK:
+                v.stageFrames = std::max<uint32_t>(1, MsToFrames(in.attackMs));
+                v.envInc = ((1 << ENV_BITS) - v.env) / (int32_t)v.stageFrames;
+                break;
+            case Stage::DECAY:
+                v.env = 1 << ENV_BITS;
+                v.stageFrames = std::max<uint32_t>(1, MsToFrames(in.decayMs));
+                v.envInc = (v.sustain - v.env) / (int32_t)v.stageFrames;
+                break;
+            case Stage::SUSTAIN:
+                v.env = v.sustain;
+                v.envInc = 0;
+                v.stageFrames = UINT32_MAX;
+                break;
+            case Stage::RELEASE:
+                v.stageFrames = std::max<uint32_t>(1, MsToFrames(in.releaseMs));
+                v.envInc = -(v.env / (int32_t)v.stageFrames) - 1;
+                break;
+            case Stage::IDLE:
+                v.env = 0;
+                v.envInc = 0;
+                v.stageFrames = UINT32_MAX;
+                break;
+            }
+        }
+
+        // advances the envelope of v by n frames (n <= stageFrames)
+        void AdvanceStage(Voice &v, uint32_t n)
+        {
+            if (v.stageFrames == UINT32_MAX)
+                return;
+            v.stageFrames -= n;
+            if (v.stageFrames > 0)
+                return;
+            switch (v.stage)
+            {
+            case Stage::ATTACK:
+                EnterStage(v, Stage::DECAY);
+                break;
+            case Stage::DECAY:
+                EnterStage(v, Stage::SUSTAIN);
+                if (v.sustain == 0)
+                    EnterStage(v, Stage::IDLE);
+                break;
+            case Stage::RELEASE:
+                EnterStage(v, Stage::IDLE);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // renders n frames of v into mix; n never crosses a stage boundary
+        void RenderVoice(Voice &v, int32_t *acc, size_t n)
+        {
+            const int32_t vel = v.velocityQ15;
+            const int32_t depth = v.fmDepth;
+            uint32_t cp = v.carrierPhase, mp = v.modPhase;
+            const uint32_t ci = v.carrierInc, mi = v.modInc;
+            int32_t env = v.env;
+            const int32_t envInc = v.envInc;
+            for (size_t i = 0; i < n; i++)
+            {
+                int32_t mod = sineTable[mp >> (32 - TABLE_BITS)];
+                int32_t car = sineTable[(cp + (uint32_t)(mod * depth)) >> (32 - TABLE_BITS)];
+                acc[i] += (((car * (env >> (ENV_BITS - 15))) >> 15) * vel) >> 15;
+                cp += ci;
+                mp += mi;
+                env += envInc;
+            }
+            v.carrierPhase = cp;
+            v.modPhase = mp;
+            v.env = std::max(env, (int32_t)0);
+        }
+
+        int AllocateVoice()
+        {
+            int best{0};
+            for (size_t i = 0; i < VOICES; i++)
+            {
+                Voice &v = voices[i];
+                if (v.stage == Stage::IDLE)
+                    return i;
+                Voice &b = voices[best];
+                // prefer stealing released voices, then the quietest, then the oldest one
+                bool vReleased = v.stage == Stage::RELEASE, bReleased = b.stage == Stage::RELEASE;
+                if (vReleased != bReleased ? vReleased : (v.env != b.env ? v.env < b.env : v.age < b.age))
+                    best = i;
+            }
+            return best;
+        }
+
+        void ReleaseTrackVoice(Track &t)
+        {
+            if (t.voice >= 0 && voices[t.voice].age == t.voiceAge)
+                NoteOff(t.voice);
+            t.voice = -1;
+        }
+
+        // starts the next note of track t
+        void NextNote(Track &t)
+        {
+            ReleaseTrackVoice(t);
+            const Note *n = t.next;
+            if (!n || (n->freq == 0 && n->durationMs == 0))
+            {
+                t.next = nullptr;
+                return;
+            }
+            t.next++;
+            t.framesToNextNote = std::max<uint32_t>(1, MsToFrames(n->durationMs));
+            t.framesToNoteOff = UINT32_MAX;
+            if (n->freq == 0)
+                return;
+            t.voice = NoteOn(n->freq, *t.instrument, t.velocityQ15);
+            t.voiceAge = voices[t.voice].age;
+            uint32_t gap = std::min<uint32_t>(MsToFrames(NOTE_GAP_MS), t.framesToNextNote / 4);
+            t.framesToNoteOff = t.framesToNextNote - gap;
+        }
+
+        // frames until the next sequencer event, at most max
+        uint32_t FramesToNextEvent(uint32_t max)
+        {
+            for (auto &t : tracks)
+            {
+                if (!t.next && t.voice < 0)
+                    continue;
+                max = std::min(max, std::min(t.framesToNoteOff, t.framesToNextNote));
+            }
+            for (auto &v : voices)
+            {
+                if (v.stage != Stage::IDLE)
+                    max = std::min(max, v.stageFrames);
+            }
+            return max;
+        }
+
+        void AdvanceTracks(uint32_t n)
+        {
+            for (auto &t : tracks)
+            {
+                if (!t.next && t.voice < 0)
+                    continue;
+                if (t.framesToNoteOff != UINT32_MAX)
+                {
+                    t.framesToNoteOff -= n;
+                    if (t.framesToNoteOff == 0)
+                    {
+                        ReleaseTrackVoice(t);
+                        t.framesToNoteOff = UINT32_MAX;
+                    }
+                }
+                t.framesToNextNote -= n;
+                if (t.framesToNextNote == 0)
+                    NextNote(t);
+            }
+        }
+
+    public:
+        Synthesizer(uint32_t sampleRate = 44100) : sampleRate(sampleRate)
+        {
+            for (int i = 0; i <= (1 << TABLE_BITS); i++)
+            {
+                sineTable[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * i / (1 << TABLE_BITS)));
+            }
+        }
+
+        uint32_t GetSampleRate() override { return sampleRate; }
+
+        // Starts a voice and returns its number. A voice is stolen, if all are busy
+        int NoteOn(float freqHz, const Instrument &instrument = Instruments::EPIANO, uint16_t velocityQ15 = DEFAULT_VELOCITY_Q15)
+        {
+            int idx = AllocateVoice();
+            Voice &v = voices[idx];
+            v.instrument = &instrument;
+            v.velocityQ15 = velocityQ15;
+            v.carrierInc = FreqToInc(freqHz);
+            v.modInc = FreqToInc(freqHz * instrument.fmRatioQ8 / 256.0f);
+            v.fmDepth = (int32_t)(std::min(instrument.fmIndex, (float)M_PI) / (float)M_PI * 65535.0f); // pi rad = half a cycle = 2^31 at full modulator
+            v.sustain = (int32_t)(((int64_t)instrument.sustainQ15 << ENV_BITS) >> 15);
+            v.age = ++ageCounter;
+            if (v.stage == Stage::IDLE)
+            {
+                v.carrierPhase = v.modPhase = 0;
+                v.env = 0;
+            }
+            EnterStage(v, Stage::ATTACK);
+            return idx;
+        }
+
+        void NoteOff(int voice)
+        {
+            if (voice < 0 || voice >= (int)VOICES)
+                return;
+            Voice &v = voices[voice];
+            if (v.stage == Stage::IDLE || v.stage == Stage::RELEASE)
+                return;
+            EnterStage(v, Stage::RELEASE);
+        }
+
+        // Plays a note sequence, terminated by {0,0}, e.g. Ringtones::POSITIVE. Returns false, if all tracks are busy
+        bool PlayNotes(const Note *notes, const Instrument &instrument = Instruments::EPIANO, uint16_t velocityQ15 = DEFAULT_VELOCITY_Q15)
+        {
+            for (auto &t : tracks)
+            {
+                if (t.next || t.voice >= 0)
+                    continue;
+                t.next = notes;
+                t.instrument = &instrument;
+                t.velocityQ15 = velocityQ15;
+                NextNote(t);
+                return true;
+            }
+            return false;
+        }
+
+        bool PlayRingtone(Ringtones::RINGTONE_SONG song, const Instrument &instrument = Instruments::EPIANO)
+        {
+            size_t i = (size_t)song;
+            if (i == 0 || i >= Ringtones::SONG_COUNT)
+                return false;
+            return PlayNotes(Ringtones::RINGTONE_SOUNDS[i], instrument);
+        }
+
+        // stops all tracks and releases all voices
+        void AllNotesOff()
+        {
+            for (auto &t : tracks)
+            {
+                t = Track{};
+            }
+            for (size_t i = 0; i < VOICES; i++)
+            {
+                NoteOff(i);
+            }
+        }
+
+        bool IsActive()
+        {
+            for (auto &t : tracks)
+            {
+                if (t.next || t.voice >= 0)
+                    return true;
+            }
+            for (auto &v : voices)
+            {
+                if (v.stage != Stage::IDLE)
+                    return true;
+            }
+            return false;
+        }
+
+        // renders up to frames stereo frames; returns less, when all tracks have ended and all voices are silent
+        size_t Read(int16_t *buf, size_t frames) override
+        {
+            const esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+            size_t done{0};
+            while (done < frames && IsActive())
+            {
+                uint32_t n = FramesToNextEvent(std::min<size_t>(SUB_BLOCK_FRAMES, frames - done));
+                memset(mix, 0, n * sizeof(int32_t));
+                for (auto &v : voices)
+                {
+                    if (v.stage == Stage::IDLE)
+                        continue;
+                    RenderVoice(v, mix, n);
+                    AdvanceStage(v, n);
+                    statistics.voiceFrames += n;
+                }
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    int16_t s = Mixer::Saturate16(mix[i]);
+                    buf[2 * (done + i)] = s;
+                    buf[2 * (done + i) + 1] = s;
+                }
+                AdvanceTracks(n);
+                done += n;
+            }
+            statistics.frames += done;
+            statistics.cycles += (esp_cpu_cycle_count_t)(esp_cpu_get_cycle_count() - start);
+            return done;
+        }
+
+        SynthStatistics GetStatistics() { return statistics; }
+        void ResetStatistics() { statistics = {}; }
+    };
+}
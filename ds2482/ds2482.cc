@@ -93,9 +93,19 @@ namespace DS2482
 
 		//ist wie ein MemoryRead von der "CMD_DRST"-Speicherzelle
 		if (this->i2c_device->ReadRegister(CMD_DRST, &status, 1) != ErrorCode::OK)
+		{
+			currChannel = CHANNEL_UNKNOWN;
+			return false;
+		}
+		// check for failure due to incorrect read back of status; the channel is only known after a successful reset
+		if ((status & 0xF7) != 0x10)
+		{
+			currChannel = CHANNEL_UNKNOWN;
 			return false;
-		// check for failure due to incorrect read back of status
-		return ((status & 0xF7) == 0x10);
+		}
+		// a device reset selects channel 0 on the DS2482-800
+		currChannel = 0;
+		return true;
 	}
 
 	//--------------------------------------------------------------------------
@@ -128,60 +138,43 @@ namespace DS2482
 	}
 
 	//--------------------------------------------------------------------------
-	// Select the 1-Wire channel on a DS2482-800.
+	// Select the 1-Wire channel on a DS2482-800. The selected channel is cached,
+	// so selecting the already active channel costs no I2C transaction.
 	//
 	// Returns: TRUE if channel selected
-	//          FALSE device not detected or failure to perform select
+	//          FALSE device not detected, invalid channel or failure to perform select
 	//
-	bool M::channelSelect(uint8_t channel)
+	bool M::SelectChannel(uint8_t channel)
 	{
-		uint8_t ch, ch_read, check;
-		if (this->i2c_device == nullptr)
+		// channel selection codes and their read back values, see datasheet "Channel Select"
+		static constexpr uint8_t CH_CODE[CHANNEL_COUNT] = {0xF0, 0xE1, 0xD2, 0xC3, 0xB4, 0xA5, 0x96, 0x87};
+		static constexpr uint8_t CH_READ[CHANNEL_COUNT] = {0xB8, 0xB1, 0xAA, 0xA3, 0x9C, 0x95, 0x8E, 0x87};
+		uint8_t check;
+		if (this->i2c_device == nullptr || channel >= CHANNEL_COUNT)
 			return false;
+		if (channel == currChannel)
+			return true;
 
-		switch (channel)
-		{
-		default:
-		case 0:
-			ch = 0xF0;
-			ch_read = 0xB8;
-			break;
-		case 1:
-			ch = 0xE1;
-			ch_read = 0xB1;
-			break;
-		case 2:
-			ch = 0xD2;
-			ch_read = 0xAA;
-			break;
-		case 3:
-			ch = 0xC3;
-			ch_read = 0xA3;
-			break;
-		case 4:
-			ch = 0xB4;
-			ch_read = 0x9C;
-			break;
-		case 5:
-			ch = 0xA5;
-			ch_read = 0x95;
-			break;
-		case 6:
-			ch = 0x96;
-			ch_read = 0x8E;
-			break;
-		case 7:
-			ch = 0x87;
-			ch_read = 0x87;
-			break;
-		};
-
-		uint16_t pseudoAddress = (CMD_CHSL << 8) | ch;
+		// Channel Select (Case A)
+		//   S AD,0 [A] CHSL [A] CC [A] Sr AD,1 [A] [RR] A\ P
+		//  [] indicates from slave
+		//  CC channel value
+		//  RR channel read back
+		uint16_t pseudoAddress = (CMD_CHSL << 8) | CH_CODE[channel];
 		if (this->i2c_device->ReadRegisterAddress16(pseudoAddress, &check, 1) != ErrorCode::OK)
+		{
+			currChannel = CHANNEL_UNKNOWN;
 			return false;
+		}
 
 		// check for failure due to incorrect read back of channel
-		return (check == ch_read);
+		if (check != CH_READ[channel])
+		{
+			currChannel = CHANNEL_UNKNOWN;
+			return false;
+		}
+		currChannel = channel;
+		return true;
 	}
 
 	//---------------------------------------------------------------------------
@@ -0,0 +1,151 @@
+#include "ds2482_scheduler.hh"
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <esp_log.h>
+#define TAG "DS2482"
+
+namespace DS2482
+{
+	size_t ChannelScheduler::discoverSensors(uint8_t channel)
+	{
+		Channel *ch = &channels[channel];
+		ch->sensorCount = 0;
+		if (!master->SelectChannel(channel))
+			return 0;
+		bool found = master->OWFirst(false);
+		while (found && ch->sensorCount < MAX_SENSORS_PER_CHANNEL)
+		{
+			if (master->ROM_NO[0] == (uint8_t)FamilyCode::DS18B20)
+			{
+				Sensor *s = &ch->sensors[ch->sensorCount++];
+				memcpy(s->rom, master->ROM_NO, sizeof(s->rom));
+				s->valid = false;
+			}
+			found = master->OWNext();
+		}
+		return ch->sensorCount;
+	}
+
+	bool ChannelScheduler::startConversion(uint8_t channel, tms_t nowMs)
+	{
+		Channel *ch = &channels[channel];
+		ch->converting = master->SelectChannel(channel) && master->BeginTransactionForAll(Command::CONVERT_T);
+		if (ch->converting)
+		{
+			ch->failures = 0;
+			ch->readyAtMs = nowMs + DS18B20_CONVERSION_TIME_MS;
+			return true;
+		}
+		// the last readings would be reported as current forever; back off instead of retrying on every Loop
+		invalidate(channel);
+		ch->readyAtMs = nowMs + (DS18B20_CONVERSION_TIME_MS << std::min(ch->failures, MAX_RETRY_BACKOFF_SHIFT));
+		if (ch->failures < MAX_RETRY_BACKOFF_SHIFT)
+			ch->failures++;
+		ESP_LOGW(TAG, "Conversion start failed on channel %u, retry in %lums", channel, (unsigned long)(ch->readyAtMs - nowMs));
+		return false;
+	}
+
+	void ChannelScheduler::invalidate(uint8_t channel)
+	{
+		Channel *ch = &channels[channel];
+		for (uint8_t i = 0; i < ch->sensorCount; i++)
+			ch->sensors[i].valid = false;
+	}
+
+	void ChannelScheduler::readSensors(uint8_t channel)
+	{
+		Channel *ch = &channels[channel];
+		if (!master->SelectChannel(channel))
+		{
+			invalidate(channel);
+			return;
+		}
+		for (uint8_t i = 0; i < ch->sensorCount; i++)
+		{
+			Sensor *s = &ch->sensors[i];
+			//rom[0] is the family code, rom[7] the crc; OWReadDS18B20Temp expects the 6 serial bytes in between
+			s->valid = master->OWReadDS18B20Temp(&s->rom[1], &s->tempX16);
+		}
+	}
+
+	ErrorCode ChannelScheduler::Setup(uint8_t channelMask, tms_t nowMs)
+	{
+		if (master == nullptr)
+			return ErrorCode::INVALID_ARGUMENT_VALUES;
+		this->channelMask = 0;
+		size_t total = 0;
+		for (uint8_t c = 0; c < CHANNEL_COUNT; c++)
+		{
+			if (!GetBitIdx(channelMask, c))
+				continue;
+			size_t cnt = discoverSensors(c);
+			ESP_LOGI(TAG, "Found %u DS18B20 on channel %u", (unsigned)cnt, c);
+			if (cnt == 0)
+				continue;
+			SetBitIdx(this->channelMask, c);
+			total += cnt;
+		}
+		if (total == 0)
+			return ErrorCode::NONE_AVAILABLE;
+		// start all conversions back to back; they run in parallel on the separate channels
+		for (uint8_t c = 0; c < CHANNEL_COUNT; c++)
+		{
+			if (GetBitIdx(this->channelMask, c))
+				startConversion(c, nowMs);
+		}
+		nextChannel = 0;
+		return ErrorCode::OK;
+	}
+
+	uint8_t ChannelScheduler::Loop(tms_t nowMs)
+	{
+		// the due channel with the earliest readyAtMs, i.e. the one that has waited longest; ties round robin from
+		// nextChannel, so that channels finishing at the same time take turns
+		uint8_t best = CHANNEL_UNKNOWN;
+		for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+		{
+			uint8_t c = (nextChannel + i) % CHANNEL_COUNT;
+			if (!GetBitIdx(channelMask, c))
+				continue;
+			if (nowMs < channels[c].readyAtMs)
+				continue; // conversion running or backing off after a failed start
+			if (best == CHANNEL_UNKNOWN || channels[c].readyAtMs < channels[best].readyAtMs)
+				best = c;
+		}
+		if (best == CHANNEL_UNKNOWN)
+			return CHANNEL_UNKNOWN;
+		if (channels[best].converting)
+			readSensors(best);
+		startConversion(best, nowMs);
+		nextChannel = (best + 1) % CHANNEL_COUNT;
+		return best;
+	}
+
+	size_t ChannelScheduler::GetSensorCount(uint8_t channel)
+	{
+		if (channel >= CHANNEL_COUNT)
+			return 0;
+		return channels[channel].sensorCount;
+	}
+
+	bool ChannelScheduler::GetTemperatureX16(uint8_t channel, size_t index, int16_t *tempX16)
+	{
+		if (channel >= CHANNEL_COUNT || index >= channels[channel].sensorCount)
+			return false;
+		const Sensor *s = &channels[channel].sensors[index];
+		if (!s->valid)
+			return false;
+		*tempX16 = s->tempX16;
+		return true;
+	}
+
+	float ChannelScheduler::GetTemperature(uint8_t channel, size_t index)
+	{
+		int16_t t;
+		if (!GetTemperatureX16(channel, index, &t))
+			return std::numeric_limits<float>::quiet_NaN();
+		return t / 16.0f;
+	}
+}
+#undef TAG
@@ -6,6 +6,8 @@
 namespace DS2482
 {
   constexpr uint8_t DEVICE_ADDRESS_BASE = 0x30;
+  constexpr uint8_t CHANNEL_COUNT = 8; //DS2482-800; the DS2482-100 only has channel 0
+  constexpr uint8_t CHANNEL_UNKNOWN = UINT8_MAX;
   enum class Mode{
     STANDARD = 0x00,
     OVERDRIVE = 0x01,
@@ -70,6 +72,7 @@ namespace DS2482
     i2c::iI2CDevice* i2c_device;
     Device device;
     uint8_t currCfg;
+    uint8_t currChannel;
     bool LastDeviceFlag;
     int32_t LastDiscrepancy;
     int32_t LastFamilyDiscrepancy;
@@ -77,7 +80,6 @@ namespace DS2482
     bool short_detected;
     bool reset();
     bool writeConfig();
-    bool channelSelect(uint8_t channel);
     uint8_t pollStatus();
     uint8_t searchTriplet(uint8_t search_direction);
     static void calcCrc8(uint8_t data, uint8_t *crc);
@@ -87,6 +89,8 @@ namespace DS2482
   public:
     uint8_t ROM_NO[8];
     ErrorCode Setup();
+    bool SelectChannel(uint8_t channel);
+    uint8_t GetSelectedChannel(){return currChannel;}
     bool OWReset();
     bool OWTouchBit(bool sendbit);
     void OWWriteBit(bool sendbit);
@@ -118,7 +122,7 @@ namespace DS2482
     bool OWWriteBytePower(uint8_t sendbyte);
     bool OWReadBitPower(bool applyPowerResponse);
 
-    M(i2c::iI2CBus* i2c_bus, Device device): i2c_bus(i2c_bus), i2c_device(nullptr), device(device), currCfg(0), LastDeviceFlag(false), LastDiscrepancy(0), LastFamilyDiscrepancy(0), alarmOnly(false), short_detected(0)
+    M(i2c::iI2CBus* i2c_bus, Device device): i2c_bus(i2c_bus), i2c_device(nullptr), device(device), currCfg(0), currChannel(CHANNEL_UNKNOWN), LastDeviceFlag(false), LastDiscrepancy(0), LastFamilyDiscrepancy(0), alarmOnly(false), short_detected(0)
     {
     }
 
@@ -0,0 +1,59 @@
+#pragma once
+#include <common.hh>
+#include "ds2482.hh"
+
+namespace DS2482
+{
+  constexpr size_t MAX_SENSORS_PER_CHANNEL = 8;
+  constexpr tms_t DS18B20_CONVERSION_TIME_MS = 750; // 12bit resolution
+  constexpr uint8_t MAX_RETRY_BACKOFF_SHIFT = 4;      // a failing channel is retried after at most 16 conversion times
+
+  /*
+   * Interleaves DS18B20 temperature measurements over all channels of a DS2482-800.
+   * Each channel is an independent 1-Wire bus, so a conversion started on one channel keeps running
+   * while the master reads or starts conversions on the other channels. Loop() services at most one
+   * channel per call (of the due ones, the one whose conversion finished first), reads back its sensors and immediately
+   * restarts the conversion on that channel. Thus a full cycle over all channels takes roughly
+   * DS18B20_CONVERSION_TIME_MS plus the pure I2C/1-Wire traffic, not the sum of all conversion times.
+   * Sensors have to be externally powered (no strong pullup during conversion).
+   * If a conversion cannot be started, the readings of that channel are invalidated and the channel is
+   * retried after one conversion time, doubling with every further failure.
+   */
+  class ChannelScheduler
+  {
+  private:
+    struct Sensor
+    {
+      uint8_t rom[8];
+      int16_t tempX16;
+      bool valid;
+    };
+    struct Channel
+    {
+      Sensor sensors[MAX_SENSORS_PER_CHANNEL];
+      uint8_t sensorCount;
+      bool converting;
+      uint8_t failures;
+      tms_t readyAtMs; // conversion finished, or the next retry after a failed start
+    };
+    M *master;
+    Channel channels[CHANNEL_COUNT];
+    uint8_t channelMask;
+    uint8_t nextChannel;
+    size_t discoverSensors(uint8_t channel);
+    bool startConversion(uint8_t channel, tms_t nowMs);
+    void invalidate(uint8_t channel);
+    void readSensors(uint8_t channel);
+
+  public:
+    ChannelScheduler(M *master) : master(master), channels{}, channelMask(0), nextChannel(0) {}
+    // searches all channels in channelMask for DS18B20 sensors and starts the first conversion on every channel
+    ErrorCode Setup(uint8_t channelMask, tms_t nowMs);
+    // call periodically; returns the channel that has been serviced or CHANNEL_UNKNOWN, if none was due
+    uint8_t Loop(tms_t nowMs);
+    size_t GetSensorCount(uint8_t channel);
+    // temperature multiplied by 16
+    bool GetTemperatureX16(uint8_t channel, size_t index, int16_t *tempX16);
+    float GetTemperature(uint8_t channel, size_t index);
+  };
+}
@@ -20,6 +20,7 @@
 */
 
 #include "arduinoFFT.h"
+#include "arduinoFFT_kernel.h"
 #include <cmath>
 using namespace std;
 
@@ -35,8 +36,10 @@ arduinoFFT::arduinoFFT(double *vReal, double *vImag, uint16_t samples, double sa
 	this->_vReal = vReal;
 	this->_vImag = vImag;
 	this->_samples = samples;
+	this->_bins = samples;
 	this->_samplingFrequency = samplingFrequency;
 	this->_power = Exponent(samples);
+	arduinoFFT_kernel<double>::Prepare(this->_power); // shared by all transforms of this size and of half of it (ComputeReal)
 }
 
 arduinoFFT::~arduinoFFT(void)
@@ -51,59 +54,11 @@ uint8_t arduinoFFT::Revision(void)
 
 void arduinoFFT::Compute(uint8_t dir)
 {// Computes in-place complex-to-complex FFT /
-	// Reverse bits /
-	uint16_t j = 0;
-	for (uint16_t i = 0; i < (this->_samples - 1); i++) {
-		if (i < j) {
-			Swap(&this->_vReal[i], &this->_vReal[j]);
-			if(dir==FFT_REVERSE)
-				Swap(&this->_vImag[i], &this->_vImag[j]);
-		}
-		uint16_t k = (this->_samples >> 1);
-		while (k <= j) {
-			j -= k;
-			k >>= 1;
-		}
-		j += k;
-	}
-	// Compute the FFT  /
-#ifdef __AVR__
-	uint8_t index = 0;
-#endif
-	double c1 = -1.0;
-	double c2 = 0.0;
-	uint16_t l2 = 1;
-	for (uint8_t l = 0; (l < this->_power); l++) {
-		uint16_t l1 = l2;
-		l2 <<= 1;
-		double u1 = 1.0;
-		double u2 = 0.0;
-		for (j = 0; j < l1; j++) {
-			 for (uint16_t i = j; i < this->_samples; i += l2) {
-					uint16_t i1 = i + l1;
-					double t1 = u1 * this->_vReal[i1] - u2 * this->_vImag[i1];
-					double t2 = u1 * this->_vImag[i1] + u2 * this->_vReal[i1];
-					this->_vReal[i1] = this->_vReal[i] - t1;
-					this->_vImag[i1] = this->_vImag[i] - t2;
-					this->_vReal[i] += t1;
-					this->_vImag[i] += t2;
-			 }
-			 double z = ((u1 * c1) - (u2 * c2));
-			 u2 = ((u1 * c2) + (u2 * c1));
-			 u1 = z;
-		}
-#ifdef __AVR__
-		c2 = pgm_read_float_near(&(_c2[index]));
-		c1 = pgm_read_float_near(&(_c1[index]));
-		index++;
-#else
-		c2 = sqrt((1.0 - c1) / 2.0);
-		c1 = sqrt((1.0 + c1) / 2.0);
-#endif
-		if (dir == FFT_FORWARD) {
-			c2 = -c2;
-		}
-	}
+	// Reverse bits; the imaginary part is swapped as well, so complex input works in both directions /
+	this->_bins = this->_samples;
+	arduinoFFT_kernel<double>::BitReverse(this->_vReal, this->_vImag, this->_samples);
+	// Compute the FFT with the radix-4 kernel and the cached twiddle table of this size /
+	arduinoFFT_kernel<double>::Transform(this->_vReal, this->_vImag, this->_power, dir);
 	// Scaling for reverse transform /
 	if (dir != FFT_FORWARD) {
 		for (uint16_t i = 0; i < this->_samples; i++) {
@@ -113,10 +68,22 @@ void arduinoFFT::Compute(uint8_t dir)
 	}
 }
 
+void arduinoFFT::ComputeReal(const int16_t *vData, uint8_t windowType)
+{// Real-to-complex FFT of signed PCM samples: vData is read only, the bins 0..samples/2+1 are written to vReal and vImag /
+	// The samples are weighed with the cached window while they are packed into a complex FFT of half the size /
+	arduinoFFT_kernel<double>::RealForward(vData, this->_vReal, this->_vImag, this->_power, windowType);
+	this->_bins = (this->_samples >> 1) + 2;
+}
+
+void arduinoFFT::ComputeReal(const uint16_t *vData, uint8_t windowType)
+{// Same for unsigned ADC samples; their mean is removed before the window /
+	arduinoFFT_kernel<double>::RealForward(vData, this->_vReal, this->_vImag, this->_power, windowType);
+	this->_bins = (this->_samples >> 1) + 2;
+}
 
 void arduinoFFT::ComplexToMagnitude()
-{ // vM is half the size of vReal and vImag
-	for (uint16_t i = 0; i < this->_samples; i++) {
+{ // vM is half the size of vReal and vImag; after ComputeReal only the computed bins
+	for (uint16_t i = 0; i < this->_bins; i++) {
 		this->_vReal[i] = sqrt(sq(this->_vReal[i]) + sq(this->_vImag[i]));
 	}
 }
@@ -139,58 +106,17 @@ void arduinoFFT::DCRemoval()
 }
 
 void arduinoFFT::Windowing(uint8_t windowType, uint8_t dir)
-{// Weighing factors are computed once before multiple use of FFT
+{// Weighing factors are computed once per window type and size and shared by all FFTs (arduinoFFT_kernel.h)
 // The weighing function is symetric; half the weighs are recorded
-	double samplesMinusOne = (double(this->_samples) - 1.0);
-	for (uint16_t i = 0; i < (this->_samples >> 1); i++) {
-		double indexMinusOne = double(i);
-		double ratio = (indexMinusOne / samplesMinusOne);
-		double weighingFactor = 1.0;
-		// Compute and record weighting factor
-		switch (windowType) {
-		case FFT_WIN_TYP_RECTANGLE: // rectangle (box car)
-			weighingFactor = 1.0;
-			break;
-		case FFT_WIN_TYP_HAMMING: // hamming
-			weighingFactor = 0.54 - (0.46 * cos(twoPi * ratio));
-			break;
-		case FFT_WIN_TYP_HANN: // hann
-			weighingFactor = 0.54 * (1.0 - cos(twoPi * ratio));
-			break;
-		case FFT_WIN_TYP_TRIANGLE: // triangle (Bartlett)
-			#if defined(ESP8266) || defined(ESP32)
-			weighingFactor = 1.0 - ((2.0 * fabs(indexMinusOne - (samplesMinusOne / 2.0))) / samplesMinusOne);
-			#else
-			weighingFactor = 1.0 - ((2.0 * abs(indexMinusOne - (samplesMinusOne / 2.0))) / samplesMinusOne);
-			#endif
-			break;
-		case FFT_WIN_TYP_NUTTALL: // nuttall
-			weighingFactor = 0.355768 - (0.487396 * (cos(twoPi * ratio))) + (0.144232 * (cos(fourPi * ratio))) - (0.012604 * (cos(sixPi * ratio)));
-			break;
-		case FFT_WIN_TYP_BLACKMAN: // blackman
-			weighingFactor = 0.42323 - (0.49755 * (cos(twoPi * ratio))) + (0.07922 * (cos(fourPi * ratio)));
-			break;
-		case FFT_WIN_TYP_BLACKMAN_NUTTALL: // blackman nuttall
-			weighingFactor = 0.3635819 - (0.4891775 * (cos(twoPi * ratio))) + (0.1365995 * (cos(fourPi * ratio))) - (0.0106411 * (cos(sixPi * ratio)));
-			break;
-		case FFT_WIN_TYP_BLACKMAN_HARRIS: // blackman harris
-			weighingFactor = 0.35875 - (0.48829 * (cos(twoPi * ratio))) + (0.14128 * (cos(fourPi * ratio))) - (0.01168 * (cos(sixPi * ratio)));
-			break;
-		case FFT_WIN_TYP_FLT_TOP: // flat top
-			weighingFactor = 0.2810639 - (0.5208972 * cos(twoPi * ratio)) + (0.1980399 * cos(fourPi * ratio));
-			break;
-		case FFT_WIN_TYP_WELCH: // welch
-			weighingFactor = 1.0 - sq((indexMinusOne - samplesMinusOne / 2.0) / (samplesMinusOne / 2.0));
-			break;
-		}
-		if (dir == FFT_FORWARD) {
-			this->_vReal[i] *= weighingFactor;
-			this->_vReal[this->_samples - (i + 1)] *= weighingFactor;
-		}
-		else {
-			this->_vReal[i] /= weighingFactor;
-			this->_vReal[this->_samples - (i + 1)] /= weighingFactor;
-		}
+	const double *weighingFactors = arduinoFFT_kernel<double>::Window(windowType, this->_power);
+	if (!weighingFactors) {
+		return; // rectangle (box car)
+	}
+	if (dir == FFT_FORWARD) {
+		arduinoFFT_kernel<double>::ApplyWindow(this->_vReal, this->_samples, weighingFactors);
+	}
+	else {
+		arduinoFFT_kernel<double>::RemoveWindow(this->_vReal, this->_samples, weighingFactors);
 	}
 }
 
@@ -20,6 +20,7 @@
 */
 
 #pragma once
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -66,6 +67,9 @@ public:
 
 	void ComplexToMagnitude();
 	void Compute(uint8_t dir);
+	/* Forward FFT of real samples; vReal and vImag need samples/2 + 2 entries */
+	void ComputeReal(const int16_t *vData, uint8_t windowType = FFT_WIN_TYP_RECTANGLE);
+	void ComputeReal(const uint16_t *vData, uint8_t windowType = FFT_WIN_TYP_RECTANGLE);
 	void DCRemoval();
 	double MajorPeak();
 	void MajorPeak(double *f, double *v);
@@ -74,6 +78,7 @@ public:
 private:
 	/* Variables */
 	uint16_t _samples;
+	uint16_t _bins;
 	double _samplingFrequency;
 	double *_vReal;
 	double *_vImag;
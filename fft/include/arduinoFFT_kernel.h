@@ -0,0 +1,453 @@
+/*
+
+	FFT libray
+	Copyright (C) 2010 Didier Longueville
+	Copyright (C) 2014 Enrique Condes
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <type_traits>
+#include "arduinoFFT.h"
+
+/*
+	Transform used by arduinoFFT (double) and arduinoFFT_t<T> (float, Q15, Q31).
+
+	Twiddle tables: cos and sin of -2*pi*k/samples for k < 3*samples/4, one table per type and size. A table is built at the
+	first use of its size and then shared by all FFT objects of that size for the whole runtime, so repeated transforms of the
+	same size only read it. Creation is serialized by a mutex and the table is published with release/acquire, so tasks may
+	race on the first use; afterwards a lookup is one atomic load. The constructors of arduinoFFT and arduinoFFT_t build the
+	tables of their size and of half their size (ComputeReal), so only Windowing may still allocate in the calling task.
+
+	Kernel: after the bit reversal, two radix-2 DIT stages are fused into one radix-4 pass over groups of four values.
+	That needs 3 instead of 4 complex multiplications per group and half the loads and stores; the groups with twiddle
+	index 0 (the whole first pass) need none. For an odd exponent, one radix-2 stage without multiplications comes first.
+	Fixed point: every radix-2 stage halves (radix-4 quarters) the values with rounding, so the result is divided by samples.
+
+	Window tables: the samples/2 weights of one half of a symmetric window, one table per sample type, window type and size, built at the
+	first use like the twiddle tables. Windowing then costs one multiplication per sample and no cos. Fixed point weights are
+	stored in Q14 (int16_t) or Q30 (int32_t), because the hann window of arduinoFFT reaches 1.08.
+
+	Real input: the N samples are packed as z[n] = x[2n] + i*x[2n+1] into an N/2 point complex transform Z, which is then
+	split with X[k] = E[k] + W^k*O[k], E = (Z[k] + conj(Z[N/2-k]))/2, O = -i*(Z[k] - conj(Z[N/2-k]))/2 and
+	X[N/2-k] = conj(E[k] - W^k*O[k]). That is half the butterflies of the complex transform, and vReal and vImag only need
+	N/2 + 2 entries: the bins 0..N/2 and bin N/2+1 (the mirror of N/2-1), which MajorPeak reads as neighbour of N/2.
+	Fixed point packs at half scale: two full scale samples form a complex value of up to sqrt(2) full scale, whose real or
+	imaginary part would overflow after a twiddle rotation. The split itself does not scale, so the result is X[k]/samples
+	like the one of the complex transform.
+*/
+template <typename T>
+class arduinoFFT_kernel {
+	static_assert(std::is_same<T, float>::value || std::is_same<T, double>::value || std::is_same<T, int16_t>::value || std::is_same<T, int32_t>::value,
+		"arduinoFFT supports float, double, int16_t (Q15) and int32_t (Q31)");
+
+public:
+	static constexpr bool FIXED_POINT = std::is_integral<T>::value;
+	static constexpr int FRACTION_BITS = std::is_same<T, int16_t>::value ? 15 : 31;
+	// product of two fixed point values before the shift back; the type itself for floating point
+	using Wide = typename std::conditional<std::is_same<T, int16_t>::value, int32_t,
+		typename std::conditional<std::is_same<T, int32_t>::value, int64_t, T>::type>::type;
+
+	struct Twiddles {
+		const T *re;
+		const T *im;
+	};
+
+	static Twiddles Table(uint8_t power)
+	{
+		const T *table = _tableRe[power].load(std::memory_order_acquire);
+		if (!table) {
+			std::lock_guard<std::mutex> lock(_lock);
+			table = Create(power);
+		}
+		return Twiddles{table, _tableIm[power].load(std::memory_order_relaxed)};
+	}
+
+	static const T *Window(uint8_t windowType, uint8_t power)
+	{
+		if (windowType == FFT_WIN_TYP_RECTANGLE || windowType >= WINDOW_TYPES) {
+			return nullptr;
+		}
+		const T *w = _windows[windowType][power].load(std::memory_order_acquire);
+		if (!w) {
+			std::lock_guard<std::mutex> lock(_lock);
+			w = CreateWindow(windowType, power);
+		}
+		return w;
+	}
+
+	// the twiddle tables of a transform of 2^power values and of the half size transform of RealForward
+	static void Prepare(uint8_t power)
+	{
+		Table(power);
+		if (power > 0) {
+			Table(power - 1);
+		}
+	}
+
+	// whether the twiddle table of the size exists, without building it
+	static bool HasTable(uint8_t power)
+	{
+		return _tableRe[power].load(std::memory_order_acquire) != nullptr;
+	}
+
+	// vData[i] *= w[i], the second half mirrored; fixed point rounded and saturated
+	static void ApplyWindow(T *vData, uint16_t samples, const T *w)
+	{
+		for (uint16_t i = 0; i < (samples >> 1); i++) {
+			vData[i] = Weigh(vData[i], w[i]);
+			vData[samples - (i + 1)] = Weigh(vData[samples - (i + 1)], w[i]);
+		}
+	}
+
+	// reverse of ApplyWindow; a division per sample, weights of 0 saturate fixed point values
+	static void RemoveWindow(T *vData, uint16_t samples, const T *w)
+	{
+		for (uint16_t i = 0; i < (samples >> 1); i++) {
+			vData[i] = Unweigh(vData[i], w[i]);
+			vData[samples - (i + 1)] = Unweigh(vData[samples - (i + 1)], w[i]);
+		}
+	}
+
+	// the weighing functions of arduinoFFT
+	static double WeighingFactor(uint8_t windowType, double indexMinusOne, double samplesMinusOne)
+	{
+		double ratio = (indexMinusOne / samplesMinusOne);
+		switch (windowType) {
+		case FFT_WIN_TYP_HAMMING: // hamming
+			return 0.54 - (0.46 * std::cos(twoPi * ratio));
+		case FFT_WIN_TYP_HANN: // hann
+			return 0.54 * (1.0 - std::cos(twoPi * ratio));
+		case FFT_WIN_TYP_TRIANGLE: // triangle (Bartlett)
+			return 1.0 - ((2.0 * std::fabs(indexMinusOne - (samplesMinusOne / 2.0))) / samplesMinusOne);
+		case FFT_WIN_TYP_NUTTALL: // nuttall
+			return 0.355768 - (0.487396 * (std::cos(twoPi * ratio))) + (0.144232 * (std::cos(fourPi * ratio))) - (0.012604 * (std::cos(sixPi * ratio)));
+		case FFT_WIN_TYP_BLACKMAN: // blackman
+			return 0.42323 - (0.49755 * (std::cos(twoPi * ratio))) + (0.07922 * (std::cos(fourPi * ratio)));
+		case FFT_WIN_TYP_BLACKMAN_NUTTALL: // blackman nuttall
+			return 0.3635819 - (0.4891775 * (std::cos(twoPi * ratio))) + (0.1365995 * (std::cos(fourPi * ratio))) - (0.0106411 * (std::cos(sixPi * ratio)));
+		case FFT_WIN_TYP_BLACKMAN_HARRIS: // blackman harris
+			return 0.35875 - (0.48829 * (std::cos(twoPi * ratio))) + (0.14128 * (std::cos(fourPi * ratio))) - (0.01168 * (std::cos(sixPi * ratio)));
+		case FFT_WIN_TYP_FLT_TOP: // flat top
+			return 0.2810639 - (0.5208972 * std::cos(twoPi * ratio)) + (0.1980399 * std::cos(fourPi * ratio));
+		case FFT_WIN_TYP_WELCH: // welch
+		{
+			double q = (indexMinusOne - samplesMinusOne / 2.0) / (samplesMinusOne / 2.0);
+			return 1.0 - q * q;
+		}
+		default: // rectangle (box car)
+			return 1.0;
+		}
+	}
+
+	// forward transform of samples = 2^power real values; int16_t is signed PCM, uint16_t unsigned ADC data whose mean is
+	// removed (like DCRemoval). Fixed point: int16_t is taken as Q15, Q31 gets it in the upper 16 bits
+	template <typename S>
+	static void RealForward(const S *vData, T *vReal, T *vImag, uint8_t power, uint8_t windowType)
+	{
+		const uint16_t half = (uint16_t)(1u << (power - 1));
+		PackReal(vData, vReal, vImag, (uint16_t)(half << 1), Window(windowType, power));
+		BitReverse(vReal, vImag, half);
+		Transform(vReal, vImag, power - 1, FFT_FORWARD);
+		SplitReal(vReal, vImag, power);
+	}
+
+	// real and imaginary part are both swapped, so forward transforms of complex input work as well
+	static void BitReverse(T *vReal, T *vImag, uint16_t samples)
+	{
+		uint16_t j = 0;
+		for (uint16_t i = 0; i < (samples - 1); i++) {
+			if (i < j) {
+				T t = vReal[i];
+				vReal[i] = vReal[j];
+				vReal[j] = t;
+				t = vImag[i];
+				vImag[i] = vImag[j];
+				vImag[j] = t;
+			}
+			uint16_t k = (samples >> 1);
+			while (k <= j) {
+				j -= k;
+				k >>= 1;
+			}
+			j += k;
+		}
+	}
+
+	// in-place transform of bit reversed data; no scaling of the reverse transform (except the one of fixed point)
+	static void Transform(T *vReal, T *vImag, uint8_t power, uint8_t dir)
+	{
+		const uint32_t samples = (uint32_t)1 << power;
+		const Twiddles w = Table(power);
+		uint32_t l1 = 1;
+		if (power & 1) {
+			for (uint32_t i = 0; i < samples; i += 2) {
+				Wide ar = vReal[i], ai = vImag[i], br = vReal[i + 1], bi = vImag[i + 1];
+				vReal[i] = Half(ar + br);
+				vImag[i] = Half(ai + bi);
+				vReal[i + 1] = Half(ar - br);
+				vImag[i + 1] = Half(ai - bi);
+			}
+			l1 = 2;
+		}
+		for (; l1 < samples; l1 <<= 2) {
+			const uint32_t l4 = l1 << 2;
+			const uint32_t step = samples / l4; // stride through the twiddle table
+			Radix4<true>(vReal, vImag, samples, l1, 0, w, 0, dir);
+			for (uint32_t j = 1; j < l1; j++) {
+				Radix4<false>(vReal, vImag, samples, l1, j, w, j * step, dir);
+			}
+		}
+	}
+
+private:
+	static constexpr uint8_t WINDOW_TYPES = FFT_WIN_TYP_WELCH + 1;
+	static constexpr int WINDOW_BITS = FRACTION_BITS - 1;
+
+	static inline std::atomic<const T *> _tableRe[16] = {};
+	static inline std::atomic<const T *> _tableIm[16] = {};
+	static inline std::atomic<const T *> _windows[WINDOW_TYPES][16] = {};
+	static inline std::mutex _lock; // creation of the tables
+
+	// _lock is held; another task may have created the table meanwhile
+	static const T *Create(uint8_t power)
+	{
+		const T *table = _tableRe[power].load(std::memory_order_relaxed);
+		if (table) {
+			return table;
+		}
+		uint32_t samples = (uint32_t)1 << power;
+		uint32_t size = samples < 4 ? 1 : (3 * samples) >> 2;
+		T *re = new T[size];
+		T *im = new T[size];
+		const double full = FIXED_POINT ? std::ldexp(1.0, FRACTION_BITS) - 1.0 : 1.0;
+		for (uint32_t k = 0; k < size; k++) {
+			double phi = -6.283185307179586 * k / samples;
+			if constexpr (FIXED_POINT) {
+				re[k] = (T)std::lrint(std::cos(phi) * full);
+				im[k] = (T)std::lrint(std::sin(phi) * full);
+			}
+			else {
+				re[k] = (T)std::cos(phi);
+				im[k] = (T)std::sin(phi);
+			}
+		}
+		_tableIm[power].store(im, std::memory_order_relaxed);
+		_tableRe[power].store(re, std::memory_order_release); // publishes im as well
+		return re;
+	}
+
+	// _lock is held, like Create
+	static const T *CreateWindow(uint8_t windowType, uint8_t power)
+	{
+		const T *window = _windows[windowType][power].load(std::memory_order_relaxed);
+		if (window) {
+			return window;
+		}
+		uint32_t samples = (uint32_t)1 << power;
+		T *w = new T[samples < 2 ? 1 : (samples >> 1)];
+		double samplesMinusOne = (double(samples) - 1.0);
+		for (uint32_t i = 0; i < (samples >> 1); i++) {
+			double weighingFactor = WeighingFactor(windowType, double(i), samplesMinusOne);
+			if constexpr (FIXED_POINT) {
+				w[i] = (T)std::lrint(weighingFactor * std::ldexp(1.0, WINDOW_BITS));
+			}
+			else {
+				w[i] = (T)weighingFactor;
+			}
+		}
+		_windows[windowType][power].store(w, std::memory_order_release);
+		return w;
+	}
+
+	static constexpr Wide MaxValue()
+	{
+		return std::is_same<T, int16_t>::value ? (Wide)INT16_MAX : (Wide)INT32_MAX;
+	}
+
+	static inline T Saturate(Wide v)
+	{
+		return (T)(v > MaxValue() ? MaxValue() : (v < -MaxValue() ? -MaxValue() : v));
+	}
+
+	static inline T Weigh(T v, T w)
+	{
+		if constexpr (FIXED_POINT) return Saturate(((Wide)v * w + ((Wide)1 << (WINDOW_BITS - 1))) >> WINDOW_BITS);
+		else return v * w;
+	}
+
+	static inline T Unweigh(T v, T w)
+	{
+		if constexpr (FIXED_POINT) {
+			if (w == 0) return v == 0 ? 0 : (v > 0 ? (T)MaxValue() : (T)-MaxValue());
+			int64_t q = ((int64_t)v << WINDOW_BITS) / w;
+			return (T)(q > MaxValue() ? MaxValue() : (q < -MaxValue() ? -MaxValue() : q));
+		}
+		else return v / w;
+	}
+
+	template <typename S>
+	static void PackReal(const S *vData, T *vReal, T *vImag, uint16_t samples, const T *window)
+	{
+		static_assert(std::is_same<S, int16_t>::value || std::is_same<S, uint16_t>::value, "real input is int16_t or uint16_t");
+		typename std::conditional<FIXED_POINT, int32_t, T>::type offset = 0;
+		if constexpr (std::is_same<S, uint16_t>::value) {
+			uint32_t sum = 0; // at most 32768 * 65535
+			for (uint16_t i = 0; i < samples; i++) {
+				sum += vData[i];
+			}
+			if constexpr (FIXED_POINT) offset = (int32_t)((sum + (samples >> 1)) / samples);
+			else offset = (T)sum / samples;
+		}
+		for (uint16_t i = 0; i < samples; i++) {
+			T v;
+			if constexpr (FIXED_POINT) {
+				const Wide d = (Wide)vData[i] - offset;
+				v = Saturate(std::is_same<T, int16_t>::value ? d : d * 65536);
+			}
+			else {
+				v = (T)vData[i] - offset;
+			}
+			if (window) {
+				v = Weigh(v, window[i < (samples >> 1) ? i : samples - (i + 1)]);
+			}
+			v = Half(v); // fixed point only, see above
+			if (i & 1) vImag[i >> 1] = v;
+			else vReal[i >> 1] = v;
+		}
+	}
+
+	static void SplitReal(T *vReal, T *vImag, uint8_t power)
+	{
+		const uint32_t half = (uint32_t)1 << (power - 1);
+		const Twiddles w = Table(power);
+		const Wide z0r = vReal[0], z0i = vImag[0];
+		vReal[0] = Store(z0r + z0i);
+		vImag[0] = 0;
+		vReal[half] = Store(z0r - z0i);
+		vImag[half] = 0;
+		for (uint32_t k = 1; k <= (half >> 1); k++) {
+			const uint32_t m = half - k;
+			const Wide ar = vReal[k], ai = vImag[k], br = vReal[m], bi = -(Wide)vImag[m]; // b = conj(Z[N/2-k])
+			const T er = Average(ar + br), ei = Average(ai + bi);
+			const T orr = Average(ai - bi), oi = Average(br - ar); // -i*(a-b) = (ai-bi, br-ar)
+			Wide tr, ti;
+			Mul(tr, ti, orr, oi, w.re[k], w.im[k]);
+			vReal[k] = Store(er + tr);
+			vImag[k] = Store(ei + ti);
+			vReal[m] = Store(er - tr);
+			vImag[m] = Store(ti - ei);
+		}
+		if (half > 1) {
+			vReal[half + 1] = vReal[half - 1];
+			vImag[half + 1] = -vImag[half - 1];
+		}
+	}
+
+	// |X[k]|/samples can only exceed full scale by rounding errors
+	static inline T Store(Wide v)
+	{
+		if constexpr (FIXED_POINT) return Saturate(v);
+		else return (T)v;
+	}
+
+	// (a + b) / 2 for every type, unlike Half which only scales fixed point
+	static inline T Average(Wide v)
+	{
+		if constexpr (FIXED_POINT) return (T)((v + 1) >> 1);
+		else return (T)(v * (T)0.5);
+	}
+
+	// b = w * a, fixed point rounded back to the scale of a
+	static inline void Mul(Wide &br, Wide &bi, T ar, T ai, Wide wr, Wide wi)
+	{
+		if constexpr (FIXED_POINT) {
+			const Wide half = (Wide)1 << (FRACTION_BITS - 1);
+			br = (wr * ar - wi * ai + half) >> FRACTION_BITS;
+			bi = (wr * ai + wi * ar + half) >> FRACTION_BITS;
+		}
+		else {
+			br = wr * ar - wi * ai;
+			bi = wr * ai + wi * ar;
+		}
+	}
+
+	static inline T Half(Wide v)
+	{
+		if constexpr (FIXED_POINT) return (T)((v + 1) >> 1);
+		else return (T)v;
+	}
+
+	static inline T Quarter(Wide v)
+	{
+		if constexpr (FIXED_POINT) return (T)((v + 2) >> 2);
+		else return (T)v;
+	}
+
+	// All groups of four values x[i], x[i+l1], x[i+2*l1], x[i+3*l1] with i = j mod 4*l1, i.e. the radix-2 stages with
+	// half sizes l1 and 2*l1 at once. With W = exp(-2*pi*i/(4*l1)) and b1 = W^2j*a1, b2 = W^j*a2, b3 = W^3j*a3:
+	// z0 = a0+b1 + (b2+b3), z2 = a0+b1 - (b2+b3), z1 = a0-b1 - i*(b2-b3), z3 = a0-b1 + i*(b2-b3) (forward; +i/-i for reverse)
+	template <bool TRIVIAL>
+	static inline void Radix4(T *vReal, T *vImag, uint32_t samples, uint32_t l1, uint32_t j, const Twiddles &w, uint32_t k, uint8_t dir)
+	{
+		Wide w1r{1}, w1i{0}, w2r{1}, w2i{0}, w3r{1}, w3i{0};
+		if constexpr (!TRIVIAL) {
+			const Wide sign = dir == FFT_FORWARD ? 1 : -1;
+			w1r = w.re[2 * k];
+			w1i = sign * w.im[2 * k];
+			w2r = w.re[k];
+			w2i = sign * w.im[k];
+			w3r = w.re[3 * k];
+			w3i = sign * w.im[3 * k];
+		}
+		const uint32_t l4 = l1 << 2;
+		for (uint32_t i0 = j; i0 < samples; i0 += l4) {
+			const uint32_t i1 = i0 + l1, i2 = i1 + l1, i3 = i2 + l1;
+			Wide b1r, b1i, b2r, b2i, b3r, b3i;
+			if constexpr (TRIVIAL) {
+				b1r = vReal[i1]; b1i = vImag[i1];
+				b2r = vReal[i2]; b2i = vImag[i2];
+				b3r = vReal[i3]; b3i = vImag[i3];
+			}
+			else {
+				Mul(b1r, b1i, vReal[i1], vImag[i1], w1r, w1i);
+				Mul(b2r, b2i, vReal[i2], vImag[i2], w2r, w2i);
+				Mul(b3r, b3i, vReal[i3], vImag[i3], w3r, w3i);
+			}
+			const Wide a0r = vReal[i0], a0i = vImag[i0];
+			const Wide s0r = a0r + b1r, s0i = a0i + b1i;
+			const Wide s1r = a0r - b1r, s1i = a0i - b1i;
+			const Wide pr = b2r + b3r, pi = b2i + b3i;
+			Wide dr = b2r - b3r, di = b2i - b3i;
+			if (dir != FFT_FORWARD) {
+				dr = -dr;
+				di = -di;
+			}
+			vReal[i0] = Quarter(s0r + pr);
+			vImag[i0] = Quarter(s0i + pi);
+			vReal[i2] = Quarter(s0r - pr);
+			vImag[i2] = Quarter(s0i - pi);
+			vReal[i1] = Quarter(s1r + di); // -i*d = (di, -dr)
+			vImag[i1] = Quarter(s1i - dr);
+			vReal[i3] = Quarter(s1r - di);
+			vImag[i3] = Quarter(s1i + dr);
+		}
+	}
+};
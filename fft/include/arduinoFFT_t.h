@@ -0,0 +1,205 @@
+/*
+
+	FFT libray
+	Copyright (C) 2010 Didier Longueville
+	Copyright (C) 2014 Enrique Condes
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <stdint.h>
+#include <cmath>
+#include <type_traits>
+#include "arduinoFFT.h"
+#include "arduinoFFT_kernel.h"
+
+/*
+	Same algorithms as arduinoFFT, but for other sample types than double. On the ESP32 double is emulated in software,
+	float is done by the FPU and integers by the ALU:
+
+	arduinoFFT_t<float>    single precision. Error of Compute against the double version: below 1e-6 of the largest magnitude
+	                       up to 1024 points
+	arduinoFFT_t<int16_t>  Q15 fixed point. Every stage halves its results, so nothing can overflow: Compute(FFT_FORWARD)
+	                       returns X[k]/samples (the double version returns X[k]) and Compute(FFT_REVERSE) returns x[n]/samples
+	                       for an unscaled spectrum, so forward and reverse together divide by samples.
+	                       Error of the scaled result: below 1e-3 of the largest magnitude (about -60dB) up to 1024 points
+	arduinoFFT_t<int32_t>  Q31 fixed point with 64 bit products, scaled like Q15. Error: below 1e-8 of the largest magnitude
+
+	Inputs of Compute must not exceed full scale as complex magnitude, which holds for real samples in vReal with vImag zero.
+	ComputeReal transforms int16_t/uint16_t sample buffers directly with a complex FFT of half the size; full scale input is
+	allowed, the samples are packed at half scale (one bit less resolution than Compute).
+	Compute uses the radix-4 kernel and the shared twiddle tables of arduinoFFT_kernel.h.
+	Window weights come from the shared window tables; magnitudes are computed in float. MajorPeak returns the frequency as float.
+*/
+template <typename T>
+class arduinoFFT_t {
+	using Kernel = arduinoFFT_kernel<T>;
+
+public:
+	static constexpr bool FIXED_POINT = Kernel::FIXED_POINT;
+	static constexpr int FRACTION_BITS = Kernel::FRACTION_BITS;
+
+	arduinoFFT_t(T *vReal, T *vImag, uint16_t samples, float samplingFrequency)
+	{// Constructor
+		this->_vReal = vReal;
+		this->_vImag = vImag;
+		this->_samples = samples;
+		this->_bins = samples;
+		this->_samplingFrequency = samplingFrequency;
+		this->_power = Exponent(samples);
+		Kernel::Prepare(this->_power); // the shared twiddle tables of Compute and ComputeReal, now and not in the first transform
+	}
+
+	~arduinoFFT_t(void)
+	{
+	}
+
+	uint8_t Revision(void)
+	{
+		return(FFT_LIB_REV);
+	}
+
+	uint8_t Exponent(uint16_t value)
+	{
+		// Calculates the base 2 logarithm of a value
+		uint8_t result = 0;
+		while (((value >> result) & 1) != 1) result++;
+		return(result);
+	}
+
+	void Compute(uint8_t dir)
+	{// Computes in-place complex-to-complex FFT
+		this->_bins = this->_samples;
+		Kernel::BitReverse(this->_vReal, this->_vImag, this->_samples);
+		Kernel::Transform(this->_vReal, this->_vImag, this->_power, dir);
+		// Scaling for reverse transform; fixed point has been scaled in every stage
+		if constexpr (!FIXED_POINT) {
+			if (dir != FFT_FORWARD) {
+				for (uint16_t i = 0; i < this->_samples; i++) {
+					this->_vReal[i] /= this->_samples;
+					this->_vImag[i] /= this->_samples;
+				}
+			}
+		}
+	}
+
+	// Forward FFT of real samples (int16_t signed PCM, uint16_t ADC data with its mean removed), optionally windowed.
+	// vData is only read; the bins 0..samples/2+1 are written, so vReal and vImag need samples/2 + 2 entries
+	template <typename S>
+	void ComputeReal(const S *vData, uint8_t windowType = FFT_WIN_TYP_RECTANGLE)
+	{
+		Kernel::RealForward(vData, this->_vReal, this->_vImag, this->_power, windowType);
+		this->_bins = (this->_samples >> 1) + 2;
+	}
+
+	void ComplexToMagnitude()
+	{
+		for (uint16_t i = 0; i < this->_bins; i++) {
+			if constexpr (FIXED_POINT) {
+				// the sum of squares needs one bit more than the product; float sqrt is exact enough for 16 and 31 bit results
+				float re = (float)this->_vReal[i];
+				float im = (float)this->_vImag[i];
+				float m = std::sqrt(re * re + im * im);
+				this->_vReal[i] = m >= MaxValue() ? MaxValue() : (T)m;
+			}
+			else {
+				this->_vReal[i] = std::sqrt(this->_vReal[i] * this->_vReal[i] + this->_vImag[i] * this->_vImag[i]);
+			}
+		}
+	}
+
+	void DCRemoval()
+	{
+		// calculate the mean of vData
+		typename std::conditional<FIXED_POINT, int64_t, T>::type mean = 0;
+		for (uint16_t i = 0; i < this->_samples; i++)
+		{
+			mean += this->_vReal[i];
+		}
+		mean /= this->_samples;
+		// Subtract the mean from vData
+		for (uint16_t i = 0; i < this->_samples; i++)
+		{
+			this->_vReal[i] -= mean;
+		}
+	}
+
+	void Windowing(uint8_t windowType, uint8_t dir)
+	{// Weighing factors of arduinoFFT, computed once per window type and size (arduinoFFT_kernel.h)
+		const T *w = Kernel::Window(windowType, this->_power);
+		if (!w) {
+			return; // rectangle
+		}
+		if (dir == FFT_FORWARD) {
+			Kernel::ApplyWindow(this->_vReal, this->_samples, w);
+		}
+		else {
+			Kernel::RemoveWindow(this->_vReal, this->_samples, w);
+		}
+	}
+
+	float MajorPeak()
+	{
+		float f, v;
+		MajorPeak(&f, &v);
+		return f;
+	}
+
+	void MajorPeak(float *f, float *v)
+	{
+		T maxY = 0;
+		uint16_t IndexOfMaxY = 0;
+		//If sampling_frequency = 2 * max_frequency in signal,
+		//value would be stored at position samples/2
+		for (uint16_t i = 1; i < ((this->_samples >> 1) + 1); i++) {
+			if ((this->_vReal[i - 1] < this->_vReal[i]) && (this->_vReal[i] > this->_vReal[i + 1])) {
+				if (this->_vReal[i] > maxY) {
+					maxY = this->_vReal[i];
+					IndexOfMaxY = i;
+				}
+			}
+		}
+		if (IndexOfMaxY == 0) {
+			*f = 0.0f;
+			*v = 0.0f;
+			return;
+		}
+		float left = (float)this->_vReal[IndexOfMaxY - 1];
+		float center = (float)this->_vReal[IndexOfMaxY];
+		float right = (float)this->_vReal[IndexOfMaxY + 1];
+		float delta = 0.5f * ((left - right) / (left - (2.0f * center) + right));
+		float interpolatedX = ((IndexOfMaxY + delta) * this->_samplingFrequency) / (this->_samples - 1);
+		if (IndexOfMaxY == (this->_samples >> 1)) //To improve calculation on edge values
+			interpolatedX = ((IndexOfMaxY + delta) * this->_samplingFrequency) / (this->_samples);
+		// returned value: interpolated frequency peak apex
+		*f = interpolatedX;
+		*v = std::fabs(left - (2.0f * center) + right);
+	}
+
+private:
+	/* Variables */
+	uint16_t _samples;
+	uint16_t _bins;
+	float _samplingFrequency;
+	T *_vReal;
+	T *_vImag;
+	uint8_t _power;
+
+	static constexpr T MaxValue()
+	{
+		return std::is_same<T, int16_t>::value ? (T)INT16_MAX : (T)INT32_MAX;
+	}
+};
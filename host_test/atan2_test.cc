@@ -0,0 +1,87 @@
+// imu_kalmanXY::fastAtan2f against atan2 in double: the documented maximum error of about 1e-5rad over all four quadrants (on a
+// dense circle and on random points of all magnitudes), the axes and the origin, and the roll and pitch of getRollPitch
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <kalman2lsm6ds3.hh>
+
+using namespace imu_kalmanXY;
+
+static constexpr double MAX_ERROR = 1e-5; // rad, see atanUnitf
+
+static double Error(float y, float x) { return std::fabs((double)fastAtan2f(y, x) - std::atan2((double)y, (double)x)); }
+
+static void TestQuadrants()
+{
+    // a dense circle: every quadrant and both octants of each, the results cover (-pi, pi]
+    double maxError[4]{};
+    const int steps = 1 << 20;
+    for (int i = 0; i < steps; i++)
+    {
+        const double a = -M_PI + 2 * M_PI * (i + 0.5) / steps;
+        const float y = (float)std::sin(a), x = (float)std::cos(a);
+        const int quadrant = (y < 0) * 2 + ((x < 0) != (y < 0));
+        maxError[quadrant] = std::max(maxError[quadrant], Error(y, x));
+    }
+    for (int q = 0; q < 4; q++)
+        CHECK(maxError[q] < MAX_ERROR, "quadrant %d: error %.2e rad", q + 1, maxError[q]);
+    printf("max error per quadrant: %.2e %.2e %.2e %.2e rad\n", maxError[0], maxError[1], maxError[2], maxError[3]);
+
+    // the ratio, not the magnitude counts: random points from 1e-6 to 1e6
+    std::mt19937 rng(27);
+    std::uniform_real_distribution<float> exponent(-6, 6), sign(-1, 1);
+    double worst{0};
+    for (int i = 0; i < 1000000; i++)
+    {
+        const float y = std::copysign(std::pow(10.0f, exponent(rng)), sign(rng)), x = std::copysign(std::pow(10.0f, exponent(rng)), sign(rng));
+        worst = std::max(worst, Error(y, x));
+    }
+    CHECK(worst < MAX_ERROR, "random points: error %.2e rad", worst);
+}
+
+static void TestAxes()
+{
+    const float PI_2 = (float)(M_PI / 2);
+    for (float r : {1e-30f, 1.0f, 9.81f, 1e30f})
+    {
+        CHECK(fastAtan2f(0.0f, r) == 0.0f, "(0, %g): %g", r, fastAtan2f(0.0f, r));
+        CHECK(std::fabs(fastAtan2f(r, 0.0f) - PI_2) < MAX_ERROR, "(%g, 0): %g", r, fastAtan2f(r, 0.0f));
+        CHECK(std::fabs(fastAtan2f(-r, 0.0f) + PI_2) < MAX_ERROR, "(%g, 0): %g", -r, fastAtan2f(-r, 0.0f));
+        CHECK(std::fabs(fastAtan2f(0.0f, -r) - (float)M_PI) < MAX_ERROR, "(0, %g): %g", -r, fastAtan2f(0.0f, -r));
+        // -0 as y on the negative x axis gives pi instead of -pi: the same direction
+        CHECK(std::fabs(std::fabs(fastAtan2f(-0.0f, -r)) - (float)M_PI) < MAX_ERROR, "(-0, %g): %g", -r, fastAtan2f(-0.0f, -r));
+        // the diagonals, where both branches meet
+        CHECK(Error(r, r) < MAX_ERROR && Error(r, -r) < MAX_ERROR && Error(-r, r) < MAX_ERROR && Error(-r, -r) < MAX_ERROR, "diagonals at %g", r);
+    }
+    CHECK(fastAtan2f(0.0f, 0.0f) == 0.0f && fastAtan2f(-0.0f, -0.0f) == 0.0f, "the origin is not 0");
+}
+
+// getRollPitch on the accelerometer vector of known orientations
+static void TestRollPitch()
+{
+    const double tolerance = MAX_ERROR * RAD_TO_DEG_F * 2;
+    double worst{0};
+    for (int r = -179; r <= 179; r += 7)
+    {
+        for (int p = -89; p <= 89; p += 7)
+        {
+            const double roll = r * M_PI / 180, pitch = p * M_PI / 180;
+            const float acc[3]{(float)(-std::sin(pitch)), (float)(std::cos(pitch) * std::sin(roll)), (float)(std::cos(pitch) * std::cos(roll))};
+            float rollDeg, pitchDeg;
+            M::getRollPitch(acc, &rollDeg, &pitchDeg);
+            worst = std::max({worst, std::fabs((double)rollDeg - r), std::fabs((double)pitchDeg - p)});
+        }
+    }
+    CHECK(worst < tolerance, "roll/pitch: error %.2e deg", worst);
+}
+
+int main()
+{
+    TestQuadrants();
+    TestAxes();
+    TestRollPitch();
+    return HostTestResult("atan2_test");
+}
@@ -0,0 +1,325 @@
+// aI2sCodecManager::WriteAudioData against a simulated I2S DMA: every written frame is played exactly once and with the sample
+// rate it was written for (a sample rate change plays the queued frames first), after a block has been written the DMA is full
+// (the caller decodes the next block meanwhile), the driver is never called with a timeout (waiting is done on the on_sent
+// semaphore), a stalled DMA fails the write, and the underrun counter of the ISR. Then the capture with the low latency profile: a
+// capture task delivers DMA buffers of 128 frames with a continuous sample sequence from one buffer, nothing after StopCapture,
+// and the DMA buffering can only be changed while no capture runs
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <driver/i2s_std.h>
+#include <codec_manager.hh>
+
+using namespace CodecManager;
+
+// The DMA: count buffers of frames stereo frames. Time only passes, when the code under test waits (blocking write, semaphore);
+// then one DMA buffer is played and on_sent is called
+namespace Dma
+{
+    struct Played
+    {
+        int16_t value;
+        uint32_t rateHz;
+    };
+    size_t capacityValues{0}, bufferValues{0};
+    std::deque<int16_t> queued;
+    std::vector<Played> played;
+    uint32_t rateHz{0};
+    bool enabled{false};
+    size_t dropped{0};
+    i2s_event_callbacks_t callbacks{};
+    void *callbackCtx{nullptr};
+    size_t blockingWrites{0}; // i2s_channel_write calls with a timeout
+
+    void PlayBuffer()
+    {
+        if (!enabled)
+            return;
+        size_t n = std::min(bufferValues, queued.size());
+        for (size_t i = 0; i < n; i++)
+        {
+            played.push_back({queued.front(), rateHz});
+            queued.pop_front();
+        }
+        callbacks.on_sent(nullptr, nullptr, callbackCtx);
+    }
+}
+
+// The receive channel: a microphone, that fills one DMA buffer per ms with the next values of a sequence
+namespace Rx
+{
+    std::atomic<bool> enabled{false};
+    int16_t next{0};
+    i2s_chan_handle_t Handle() { return (i2s_chan_handle_t)&enabled; }
+}
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t *cfg, i2s_chan_handle_t *tx, i2s_chan_handle_t *rx)
+{
+    Dma::bufferValues = 2 * cfg->dma_frame_num;
+    Dma::capacityValues = cfg->dma_desc_num * Dma::bufferValues;
+    *tx = (i2s_chan_handle_t)&Dma::queued;
+    if (rx)
+        *rx = Rx::Handle();
+    return ESP_OK;
+}
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t, const i2s_std_config_t *cfg)
+{
+    Dma::rateHz = cfg->clk_cfg.sample_rate_hz;
+    return ESP_OK;
+}
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t h, const i2s_event_callbacks_t *cbs, void *ctx)
+{
+    if (h == Rx::Handle())
+        return ESP_OK;
+    Dma::callbacks = *cbs;
+    Dma::callbackCtx = ctx;
+    return ESP_OK;
+}
+esp_err_t i2s_channel_enable(i2s_chan_handle_t h)
+{
+    if (h == Rx::Handle())
+        Rx::enabled = true;
+    else
+        Dma::enabled = true;
+    return ESP_OK;
+}
+esp_err_t i2s_channel_disable(i2s_chan_handle_t h)
+{
+    if (h == Rx::Handle())
+    {
+        Rx::enabled = false;
+        return ESP_OK;
+    }
+    Dma::enabled = false;
+    Dma::dropped += Dma::queued.size(); // the driver resets the DMA descriptors
+    Dma::queued.clear();
+    return ESP_OK;
+}
+esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t, const i2s_std_clk_config_t *clk)
+{
+    Dma::rateHz = clk->sample_rate_hz;
+    return ESP_OK;
+}
+esp_err_t i2s_del_channel(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_write(i2s_chan_handle_t, const void *src, size_t size, size_t *written, uint32_t timeoutMs)
+{
+    Dma::blockingWrites += timeoutMs != 0;
+    const int16_t *values = (const int16_t *)src;
+    size_t n = size / sizeof(int16_t), done{0};
+    while (true)
+    {
+        while (done < n && Dma::queued.size() < Dma::capacityValues)
+            Dma::queued.push_back(values[done++]);
+        if (done == n || timeoutMs == 0)
+            break;
+        Dma::PlayBuffer();
+    }
+    *written = done * sizeof(int16_t);
+    return done == n ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+esp_err_t i2s_channel_read(i2s_chan_handle_t, void *dst, size_t size, size_t *read, uint32_t timeoutMs)
+{
+    if (!Rx::enabled)
+        return ESP_ERR_INVALID_STATE;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    int16_t *values = (int16_t *)dst;
+    const size_t n = std::min(size / sizeof(int16_t), Dma::bufferValues);
+    for (size_t i = 0; i < n; i++)
+        values[i] = Rx::next++;
+    *read = n * sizeof(int16_t);
+    return ESP_OK;
+}
+
+// A wait with a timeout is a wait for on_sent: the DMA plays a buffer meanwhile. Only the wait for the end of the capture task
+// (portMAX_DELAY) really blocks
+struct FakeSemaphore
+{
+    std::mutex m;
+    std::condition_variable cv;
+    bool given{false};
+};
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new FakeSemaphore; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t h)
+{
+    FakeSemaphore *s = static_cast<FakeSemaphore *>(h);
+    std::lock_guard<std::mutex> l(s->m);
+    s->given = true;
+    s->cv.notify_all();
+    return pdTRUE;
+}
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t h, BaseType_t *woken)
+{
+    *woken = pdFALSE;
+    return xSemaphoreGive(h);
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t h, TickType_t timeout)
+{
+    FakeSemaphore *s = static_cast<FakeSemaphore *>(h);
+    if (timeout == portMAX_DELAY)
+    {
+        std::unique_lock<std::mutex> l(s->m);
+        s->cv.wait(l, [s] { return s->given; });
+        s->given = false;
+        return pdTRUE;
+    }
+    bool given;
+    {
+        std::lock_guard<std::mutex> l(s->m);
+        given = s->given;
+    }
+    if (!given && timeout > 0)
+        Dma::PlayBuffer();
+    std::lock_guard<std::mutex> l(s->m);
+    given = s->given;
+    s->given = false;
+    return given ? pdTRUE : pdFALSE;
+}
+BaseType_t xTaskCreate(TaskFunction_t f, const char *, uint32_t, void *p, UBaseType_t, TaskHandle_t *)
+{
+    std::thread(f, p).detach();
+    return pdPASS;
+}
+void vTaskDelete(TaskHandle_t) { pthread_exit(nullptr); }
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+class TestCodec : public aI2sCodecManager
+{
+public:
+    ErrorCode SetPowerState(bool power) override { return ErrorCode::OK; }
+    ErrorCode SetVolume(uint8_t volume) override { return ErrorCode::OK; }
+    ErrorCode Init(gpio_num_t dataIn = GPIO_NUM_NC) { return InitI2sEsp32(GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, dataIn); }
+};
+
+// filled by the capture task, read by the test after StopCapture
+struct Captured
+{
+    std::atomic<size_t> buffers{0};
+    size_t frames{0};
+    size_t wrongSize{0};
+    size_t gaps{0};
+    size_t otherPointer{0};
+    const int16_t *first{nullptr};
+    int16_t next{0};
+};
+
+static void OnCaptured(const int16_t *frames, size_t frameCnt, void *userCtx)
+{
+    Captured *c = static_cast<Captured *>(userCtx);
+    c->wrongSize += frameCnt != c->frames;
+    if (c->buffers == 0)
+    {
+        c->first = frames;
+        c->next = frames[0];
+    }
+    c->otherPointer += frames != c->first;
+    for (size_t i = 0; i < 2 * frameCnt; i++)
+    {
+        c->gaps += frames[i] != c->next;
+        c->next = frames[i] + 1;
+    }
+    c->buffers++;
+}
+
+// captures at least 30 DMA buffers of the expected size, then stops
+static void Capture(TestCodec &codec, size_t frames)
+{
+    Captured c;
+    c.frames = frames;
+    CHECK(codec.StartCapture(OnCaptured, &c) == ErrorCode::OK && codec.IsCapturing(), "StartCapture failed");
+    CHECK(codec.StartCapture(OnCaptured, &c) == ErrorCode::INVALID_STATE, "a second StartCapture did not fail");
+    const DmaBuffering other{codec.GetDmaBuffering().count + 1, codec.GetDmaBuffering().frames};
+    CHECK(codec.SetDmaBuffering(other) == ErrorCode::INVALID_STATE, "SetDmaBuffering during a capture did not fail");
+    for (int i = 0; i < 5000 && c.buffers < 30; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(codec.StopCapture() == ErrorCode::OK && !codec.IsCapturing(), "StopCapture failed");
+    const size_t stopped = c.buffers;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(stopped >= 30 && c.buffers == stopped, "%zu buffers, %zu after StopCapture", stopped, c.buffers - stopped);
+    CHECK(c.wrongSize == 0 && c.gaps == 0 && c.otherPointer == 0, "%zu frames per buffer: %zu of another size, %zu gaps, %zu other pointers",
+          frames, c.wrongSize, c.gaps, c.otherPointer);
+    CHECK(codec.GetCaptureStatistics().buffers == stopped, "capture statistics: %lu buffers", (unsigned long)codec.GetCaptureStatistics().buffers);
+}
+
+static void TestCapture()
+{
+    TestCodec codec;
+    CHECK(codec.SetDmaBuffering(DMA_BUFFERING_LOW_LATENCY) == ErrorCode::OK, "SetDmaBuffering before Init failed");
+    CHECK(codec.Init(GPIO_NUM_0) == ErrorCode::OK, "full duplex Init failed");
+    CHECK(Dma::bufferValues == 2 * DMA_BUFFERING_LOW_LATENCY.frames && Dma::capacityValues == Dma::bufferValues * DMA_BUFFERING_LOW_LATENCY.count, "low latency: %zu frames per buffer",
+          Dma::bufferValues / 2);
+    Capture(codec, DMA_BUFFERING_LOW_LATENCY.frames);
+    // recreates the channels after the output has been played
+    CHECK(codec.SetDmaBuffering(DMA_BUFFERING_DEFAULT) == ErrorCode::OK && Dma::bufferValues == 2 * DMA_BUFFERING_DEFAULT.frames,
+          "SetDmaBuffering after the capture failed");
+    Capture(codec, DMA_BUFFERING_DEFAULT.frames);
+}
+
+int main()
+{
+    TestCodec codec;
+    CHECK(codec.Init() == ErrorCode::OK, "Init failed");
+    const size_t block = 4 * 1152; // the block of AudioPlayer: 4 MP3 frames
+    CHECK(Dma::capacityValues >= 2 * block, "the default DMA buffering holds %zu frames, less than one block", Dma::capacityValues / 2);
+
+    struct Write
+    {
+        size_t frames;
+        uint32_t rateHz;
+    };
+    const Write writes[] = {{block, 44100}, {block, 44100}, {100, 44100}, {1024, 44100}, {block, 22050}, {576, 22050},
+                            {block, 48000}, {block, 48000}, {block, 44100}, {37, 44100}, {block, 44100}};
+    std::vector<Dma::Played> expected;
+    int16_t next{0}; // wraps around, the sequence is still unique within the DMA
+    size_t shortOverlap{0};
+    for (const Write &w : writes)
+    {
+        std::vector<int16_t> buf(2 * w.frames);
+        for (auto &v : buf)
+        {
+            v = next++;
+            expected.push_back({v, w.rateHz});
+        }
+        CHECK(codec.WriteAudioData(eChannels::TWO, eSampleBits::SIXTEEN, w.rateHz, w.frames, buf.data()) == ErrorCode::OK, "write failed");
+        // the DMA plays at least a block less one DMA buffer (the write fills freed buffers until the tail fits), while the caller
+        // decodes the next one
+        shortOverlap += w.frames == block && Dma::queued.size() < Dma::capacityValues - Dma::bufferValues;
+    }
+    while (!Dma::queued.empty())
+        Dma::PlayBuffer();
+
+    CHECK(Dma::dropped == 0, "%zu queued values dropped", Dma::dropped);
+    CHECK(shortOverlap == 0, "%zu blocks returned with less than the DMA capacity queued", shortOverlap);
+    size_t wrong{0};
+    for (size_t i = 0; i < std::min(expected.size(), Dma::played.size()); i++)
+    {
+        wrong += expected[i].value != Dma::played[i].value || expected[i].rateHz != Dma::played[i].rateHz;
+    }
+    CHECK(expected.size() == Dma::played.size() && wrong == 0, "played %zu of %zu values, %zu wrong or with another sample rate",
+          Dma::played.size(), expected.size(), wrong);
+    CHECK(codec.GetOutputStatistics().blocks == sizeof(writes) / sizeof(writes[0]), "block count %lu", (unsigned long)codec.GetOutputStatistics().blocks);
+    CHECK(codec.GetOutputStatistics().waits > 0, "no write had to wait for the DMA");
+    CHECK(Dma::blockingWrites == 0, "%zu calls of i2s_channel_write with a timeout", Dma::blockingWrites);
+
+    // a stalled DMA (no on_sent): the write returns TIMEOUT instead of hanging
+    Dma::enabled = false;
+    std::vector<int16_t> stalled(2 * block);
+    CHECK(codec.WriteAudioData(eChannels::TWO, eSampleBits::SIXTEEN, 44100, block, stalled.data()) == ErrorCode::OK, "write into the empty DMA failed");
+    CHECK(codec.WriteAudioData(eChannels::TWO, eSampleBits::SIXTEEN, 44100, block, stalled.data()) == ErrorCode::TIMEOUT, "write into the stalled DMA did not time out");
+    Dma::queued.clear();
+    Dma::enabled = true;
+
+    for (int i = 0; i < 5; i++)
+        Dma::callbacks.on_send_q_ovf(nullptr, nullptr, Dma::callbackCtx);
+    CHECK(codec.GetUnderrunCount() == 5 && codec.GetOutputStatistics().underruns == 5, "underruns %lu", (unsigned long)codec.GetUnderrunCount());
+
+    TestCapture();
+    return HostTestResult("codec_output_test");
+}
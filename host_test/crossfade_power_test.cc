@@ -0,0 +1,96 @@
+// AudioPlayer::Player with crossfade: Stop fades the music out with the codec powered and powers it down after the fade;
+// an order started during the fade keeps it powered; Stop without crossfade powers down at once
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <AudioPlayer.hh>
+
+using namespace AudioPlayer;
+
+class PowerCodec : public CodecManager::aCodecManager
+{
+public:
+    bool powered{false};
+    size_t framesUnpowered{0}; // written while powered down, i.e. muted
+    size_t framesPowered{0};
+    int powerDowns{0};
+
+    ErrorCode WriteAudioData(CodecManager::eChannels ch, CodecManager::eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) override
+    {
+        (powered ? framesPowered : framesUnpowered) += sampleCnt;
+        return ErrorCode::OK;
+    }
+    ErrorCode SetPowerState(bool power) override
+    {
+        powerDowns += powered && !power;
+        powered = power;
+        return ErrorCode::OK;
+    }
+    ErrorCode SetVolume(uint8_t volume) override { return ErrorCode::OK; }
+
+protected:
+    ErrorCode SetSampleRate(uint32_t sampleRateHz) override { return ErrorCode::OK; }
+};
+
+static std::vector<uint8_t> Load(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void Loops(Player &player, int n)
+{
+    for (int i = 0; i < n; i++)
+        player.Loop();
+}
+
+int main()
+{
+    const std::vector<uint8_t> music = Load(REPO_DIR "/audio/music/fanfare.mp3");
+    const std::vector<uint8_t> other = Load(REPO_DIR "/audio/music/siren.mp3");
+    const uint16_t fadeMs = 500;
+    const size_t fadeFrames = fadeMs * 44100 / 1000;
+
+    {
+        PowerCodec codec;
+        Player player(&codec);
+        player.SetCrossfade(fadeMs);
+        player.PlayMP3(music.data(), music.size(), 0, false);
+        Loops(player, 5);
+        player.Stop();
+        codec.framesPowered = 0;
+        player.Loop(); // takes the stop order and writes the first block of the fade
+        CHECK(codec.powered, "codec powered down at the start of the crossfade");
+        Loops(player, 100);
+        CHECK(codec.framesUnpowered == 0, "%zu frames of the fade written to the powered down codec", codec.framesUnpowered);
+        CHECK(codec.framesPowered >= fadeFrames, "only %zu frames of the %zu frame fade written", codec.framesPowered, fadeFrames);
+        CHECK(!codec.powered && codec.powerDowns == 1, "codec not powered down once after the fade (%d power downs)", codec.powerDowns);
+    }
+    {
+        // a new order during the fade: the codec stays on, also after the fade has ended
+        PowerCodec codec;
+        Player player(&codec);
+        player.SetCrossfade(fadeMs);
+        player.PlayMP3(music.data(), music.size(), 0, false);
+        Loops(player, 5);
+        player.Stop();
+        player.Loop();
+        player.PlayMP3(other.data(), other.size(), 0, false);
+        Loops(player, 30);
+        CHECK(codec.powered && codec.powerDowns == 0, "codec powered down while the next order plays (%d power downs)", codec.powerDowns);
+    }
+    {
+        PowerCodec codec;
+        Player player(&codec);
+        player.PlayMP3(music.data(), music.size(), 0, false);
+        Loops(player, 5);
+        player.Stop();
+        player.Loop();
+        CHECK(!codec.powered && codec.powerDowns == 1, "Stop without crossfade did not power down");
+    }
+    return HostTestResult("crossfade_power_test");
+}
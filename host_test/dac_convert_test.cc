@@ -0,0 +1,124 @@
+// InternalDacWithPotentiometer: the 8 bit values of the plain conversion (truncation, volume, mono mix of stereo) exactly; the
+// dithered conversions with a bounded error (TPDF: below 1.5 LSB, shaped: below 3 LSB) and without DC error, measured on constant
+// levels between two codes and on a sine, in blocks larger than the conversion buffer
+#include <cmath>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <driver/i2s_std.h>
+#include <codec_manager_internal_dac.hh>
+
+using namespace CodecManager;
+
+// the DAC: collects the written bytes
+static std::vector<uint8_t> dacOut;
+esp_err_t dac_continuous_new_channels(const dac_continuous_config_t *, dac_continuous_handle_t *handle)
+{
+    *handle = (dac_continuous_handle_t)&dacOut;
+    return ESP_OK;
+}
+esp_err_t dac_continuous_enable(dac_continuous_handle_t) { return ESP_OK; }
+esp_err_t dac_continuous_disable(dac_continuous_handle_t) { return ESP_OK; }
+esp_err_t dac_continuous_del_channels(dac_continuous_handle_t) { return ESP_OK; }
+esp_err_t dac_continuous_write(dac_continuous_handle_t, uint8_t *buf, size_t size, size_t *written, int)
+{
+    dacOut.insert(dacOut.end(), buf, buf + size);
+    *written = size;
+    return ESP_OK;
+}
+
+static constexpr uint32_t RATE = 24000;
+
+static std::vector<uint8_t> Write(InternalDacWithPotentiometer &dac, std::vector<int16_t> in, eChannels ch)
+{
+    dacOut.clear();
+    const size_t frames = in.size() / (size_t)ch;
+    CHECK(dac.WriteAudioData(ch, eSampleBits::SIXTEEN, RATE, frames, in.data()) == ErrorCode::OK, "WriteAudioData failed");
+    CHECK(dacOut.size() == frames, "%zu bytes for %zu frames", dacOut.size(), frames);
+    return dacOut;
+}
+
+static void TestConvert()
+{
+    InternalDacWithPotentiometer dac;
+    CHECK(dac.Init() == ErrorCode::OK, "Init failed");
+    dac.SetDither(eDither::NONE);
+    dac.SetVolume(255); // 1.0
+    const std::vector<int16_t> in{-32768, -32767, -257, -256, -255, -1, 0, 1, 255, 256, 16384, 32512, 32767};
+    const std::vector<uint8_t> unity{0, 0, 126, 127, 127, 127, 128, 128, 128, 129, 192, 255, 255};
+    CHECK(Write(dac, in, eChannels::ONE) == unity, "volume 255: wrong 8 bit values");
+
+    dac.SetVolume(128); // 129/256
+    const std::vector<uint8_t> half{63, 63, 127, 127, 127, 127, 128, 128, 128, 128, 160, 191, 192};
+    CHECK(Write(dac, in, eChannels::ONE) == half, "volume 128: wrong 8 bit values");
+    dac.SetVolume(0);
+    CHECK(Write(dac, in, eChannels::ONE) == std::vector<uint8_t>(in.size(), 128), "volume 0 is not silence");
+
+    // stereo is mixed to mono: (L + R) >> 1
+    dac.SetVolume(255);
+    const std::vector<int16_t> stereo{32767, -32768, 32767, 32767, -32768, -32768, 1000, 3000, -256, 0};
+    const std::vector<uint8_t> mixed{127, 255, 0, 135, 127};
+    CHECK(Write(dac, stereo, eChannels::TWO) == mixed, "stereo: wrong 8 bit values");
+
+    // the whole range, over several conversion chunks
+    std::vector<int16_t> ramp;
+    for (int32_t v = INT16_MIN; v <= INT16_MAX; v += 7)
+        ramp.push_back((int16_t)v);
+    const std::vector<uint8_t> out = Write(dac, ramp, eChannels::ONE);
+    size_t wrong{0};
+    for (size_t i = 0; i < ramp.size() && i < out.size(); i++)
+        wrong += out[i] != (ramp[i] + 0x8000) >> 8;
+    CHECK(wrong == 0, "ramp: %zu of %zu values differ from (v + 0x8000) >> 8", wrong, ramp.size());
+}
+
+struct ErrorStats
+{
+    double mean{0};
+    double maxAbs{0};
+};
+
+// error of the output against the exact value (v + 0x8000) / 256, in LSB
+static ErrorStats Errors(const std::vector<int16_t> &in, const std::vector<uint8_t> &out)
+{
+    ErrorStats s;
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        const double e = out[i] - (in[i] + 32768.0) / 256;
+        s.mean += e;
+        s.maxAbs = std::max(s.maxAbs, std::fabs(e));
+    }
+    s.mean /= in.size();
+    return s;
+}
+
+static void TestDithered(eDither dither, const char *name, double bound)
+{
+    InternalDacWithPotentiometer dac;
+    CHECK(dac.Init() == ErrorCode::OK, "Init failed");
+    dac.SetDither(dither);
+    dac.SetVolume(255);
+    const size_t n = 100000;
+    // constant levels on a code and between two codes: the mean of the output has to show the level between the codes
+    for (int16_t level : {-12800, -12736, 1000, 1128, 20000 + 192})
+    {
+        const std::vector<int16_t> in(n, level);
+        const ErrorStats s = Errors(in, Write(dac, in, eChannels::ONE));
+        CHECK(s.maxAbs < bound, "%s, level %d: error %.2f LSB", name, level, s.maxAbs);
+        CHECK(std::fabs(s.mean) < 0.01, "%s, level %d: mean error %.4f LSB", name, level, s.mean);
+    }
+    // a sine of 3/4 full scale, which covers all codes in between
+    std::vector<int16_t> sine(n);
+    for (size_t i = 0; i < n; i++)
+        sine[i] = (int16_t)lrint(24000 * sin(2 * M_PI * 997 * i / RATE));
+    const ErrorStats s = Errors(sine, Write(dac, sine, eChannels::ONE));
+    CHECK(s.maxAbs < bound && std::fabs(s.mean) < 0.01, "%s, sine: error %.2f LSB, mean %.4f LSB", name, s.maxAbs, s.mean);
+}
+
+int main()
+{
+    TestConvert();
+    TestDithered(eDither::TPDF, "TPDF", 1.5);
+    TestDithered(eDither::TPDF_SHAPED, "TPDF_SHAPED", 3.0);
+    return HostTestResult("dac_convert_test");
+}
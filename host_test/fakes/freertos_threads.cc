@@ -0,0 +1,206 @@
+// Host fake of the FreeRTOS functions used by the components: tasks are threads, queues, semaphores and stream buffers share one
+// mutex and condition variable. Ticks are milliseconds. Enough to run the task interplay of a component, not a scheduler model
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+#include <esp_cpu.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+
+using namespace std::chrono;
+
+static std::mutex lock;
+static std::condition_variable changed;
+
+template <typename P>
+static bool WaitFor(std::unique_lock<std::mutex> &l, TickType_t ticks, P ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        changed.wait(l, ready);
+        return true;
+    }
+    return changed.wait_for(l, milliseconds(ticks), ready);
+}
+
+struct Queue
+{
+    size_t itemSize;
+    size_t length;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(int length, int itemSize) { return new Queue{(size_t)itemSize, (size_t)length, {}}; }
+
+static BaseType_t Send(QueueHandle_t h, const void *item, TickType_t ticks, bool front)
+{
+    Queue *q = (Queue *)h;
+    std::unique_lock<std::mutex> l(lock);
+    if (!WaitFor(l, ticks, [&] { return q->items.size() < q->length; }))
+        return pdFALSE;
+    std::vector<uint8_t> v((const uint8_t *)item, (const uint8_t *)item + q->itemSize);
+    if (front)
+        q->items.push_front(std::move(v));
+    else
+        q->items.push_back(std::move(v));
+    changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t h, const void *item, TickType_t ticks) { return Send(h, item, ticks, false); }
+BaseType_t xQueueSend(QueueHandle_t h, const void *item, TickType_t ticks) { return Send(h, item, ticks, false); }
+BaseType_t xQueueSendToFront(QueueHandle_t h, const void *item, TickType_t ticks) { return Send(h, item, ticks, true); }
+BaseType_t xQueueSendFromISR(QueueHandle_t h, const void *item, BaseType_t *) { return Send(h, item, 0, false); }
+
+BaseType_t xQueueOverwrite(QueueHandle_t h, const void *item)
+{
+    {
+        std::unique_lock<std::mutex> l(lock);
+        ((Queue *)h)->items.clear();
+    }
+    return Send(h, item, 0, false);
+}
+
+static BaseType_t Receive(QueueHandle_t h, void *item, TickType_t ticks, bool remove)
+{
+    Queue *q = (Queue *)h;
+    std::unique_lock<std::mutex> l(lock);
+    if (!WaitFor(l, ticks, [&] { return !q->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, q->items.front().data(), q->itemSize);
+    if (remove)
+    {
+        q->items.pop_front();
+        changed.notify_all();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t h, void *item, TickType_t ticks) { return Receive(h, item, ticks, true); }
+BaseType_t xQueuePeek(QueueHandle_t h, void *item, TickType_t ticks) { return Receive(h, item, ticks, false); }
+BaseType_t xQueueReceiveFromISR(QueueHandle_t h, void *item, BaseType_t *) { return Receive(h, item, 0, true); }
+
+BaseType_t xQueueReset(QueueHandle_t h)
+{
+    std::unique_lock<std::mutex> l(lock);
+    ((Queue *)h)->items.clear();
+    changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t h)
+{
+    std::unique_lock<std::mutex> l(lock);
+    return ((Queue *)h)->items.size();
+}
+
+struct Semaphore
+{
+    int count;
+    int max;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new Semaphore{1, 1}; }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new Semaphore{0, 1}; }
+SemaphoreHandle_t xSemaphoreCreateCounting(int max, int initial) { return new Semaphore{initial, max}; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t h, TickType_t ticks)
+{
+    Semaphore *s = (Semaphore *)h;
+    std::unique_lock<std::mutex> l(lock);
+    if (!WaitFor(l, ticks, [&] { return s->count > 0; }))
+        return pdFALSE;
+    s->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t h)
+{
+    Semaphore *s = (Semaphore *)h;
+    std::unique_lock<std::mutex> l(lock);
+    if (s->count >= s->max)
+        return pdFALSE;
+    s->count++;
+    changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t h, BaseType_t *) { return xSemaphoreGive(h); }
+
+struct StreamBuffer
+{
+    size_t capacity;
+    std::deque<uint8_t> bytes;
+};
+
+StreamBufferHandle_t xStreamBufferCreate(size_t capacity, size_t) { return new StreamBuffer{capacity, {}}; }
+
+size_t xStreamBufferSend(StreamBufferHandle_t h, const void *data, size_t n, TickType_t ticks)
+{
+    StreamBuffer *b = (StreamBuffer *)h;
+    std::unique_lock<std::mutex> l(lock);
+    if (!WaitFor(l, ticks, [&] { return b->bytes.size() < b->capacity; }))
+        return 0;
+    size_t k = std::min(n, b->capacity - b->bytes.size());
+    b->bytes.insert(b->bytes.end(), (const uint8_t *)data, (const uint8_t *)data + k);
+    changed.notify_all();
+    return k;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t h, void *data, size_t n, TickType_t ticks)
+{
+    StreamBuffer *b = (StreamBuffer *)h;
+    std::unique_lock<std::mutex> l(lock);
+    if (!WaitFor(l, ticks, [&] { return !b->bytes.empty(); }))
+        return 0;
+    size_t k = std::min(n, b->bytes.size());
+    std::copy(b->bytes.begin(), b->bytes.begin() + k, (uint8_t *)data);
+    b->bytes.erase(b->bytes.begin(), b->bytes.begin() + k);
+    changed.notify_all();
+    return k;
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t h)
+{
+    std::unique_lock<std::mutex> l(lock);
+    ((StreamBuffer *)h)->bytes.clear();
+    changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t h)
+{
+    std::unique_lock<std::mutex> l(lock);
+    return ((StreamBuffer *)h)->bytes.empty();
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t h)
+{
+    std::unique_lock<std::mutex> l(lock);
+    return ((StreamBuffer *)h)->bytes.size();
+}
+
+// tasks run detached until they delete themselves; the endless ones end with the process
+BaseType_t xTaskCreate(TaskFunction_t f, const char *, uint32_t, void *p, UBaseType_t, TaskHandle_t *)
+{
+    std::thread(f, p).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) { pthread_exit(nullptr); }
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(milliseconds(ticks)); }
+TickType_t xTaskGetTickCount() { return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count(); }
+int64_t esp_timer_get_time() { return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count(); }
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); }
+const char *esp_err_to_name(esp_err_t) { return ""; }
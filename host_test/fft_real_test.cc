@@ -0,0 +1,113 @@
+// arduinoFFT_t<int16_t/int32_t>::ComputeReal against the double ComputeReal, with full scale input: square waves and random
+// samples of +-32767 used to overflow the packed complex values after a twiddle rotation. Errors in LSB of the 16 bit input.
+// And the shared tables: the constructor builds the half size table of ComputeReal, tasks racing on the first use get one table
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "host_test.hh"
+#include "arduinoFFT.h"
+#include "arduinoFFT_t.h"
+
+template <typename T, typename S>
+static double MaxErrorLsb(const std::vector<S> &samples, uint8_t windowType)
+{
+    const uint16_t n = samples.size();
+    std::vector<double> dr(n / 2 + 2), di(n / 2 + 2);
+    arduinoFFT ref(dr.data(), di.data(), n, 1000);
+    ref.ComputeReal(samples.data(), windowType);
+
+    std::vector<T> qr(n / 2 + 2), qi(n / 2 + 2);
+    arduinoFFT_t<T> fft(qr.data(), qi.data(), n, 1000);
+    fft.ComputeReal(samples.data(), windowType);
+
+    // fixed point returns X[k]/samples; Q31 has the 16 bit samples in the upper half
+    const double scale = std::is_same<T, int16_t>::value ? 1.0 : 65536.0;
+    double err{0};
+    for (int k = 0; k <= n / 2 + 1; k++)
+    {
+        err = std::fmax(err, std::hypot(qr[k] / scale - dr[k] / n, qi[k] / scale - di[k] / n));
+    }
+    return err; // in LSB of the 16 bit input
+}
+
+static void TestTables()
+{
+    // 2^13 and 2^12 are not used elsewhere in this test
+    using K = arduinoFFT_kernel<float>;
+    CHECK(!K::HasTable(13) && !K::HasTable(12), "tables of 2^13 and 2^12 before the first FFT of that size");
+    std::vector<float> re(8192), im(8192);
+    arduinoFFT_t<float> fft(re.data(), im.data(), 8192, 1000);
+    CHECK(K::HasTable(13) && K::HasTable(12), "the constructor did not build the tables of Compute and ComputeReal");
+    const float *full = K::Table(13).re, *half = K::Table(12).re;
+    using D = arduinoFFT_kernel<double>;
+    CHECK(!D::HasTable(13) && !D::HasTable(12), "double tables of 2^13 and 2^12 before the first FFT of that size");
+    arduinoFFT dfft(nullptr, nullptr, 8192, 1000);
+    CHECK(D::HasTable(13) && D::HasTable(12), "the constructor of arduinoFFT did not build the tables of Compute and ComputeReal");
+
+    std::vector<const float *> windows(8), tables(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&, i] {
+            windows[i] = K::Window(FFT_WIN_TYP_BLACKMAN, 11);
+            tables[i] = K::Table(11).re;
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    bool same{true};
+    for (size_t i = 1; i < 8; i++)
+        same &= windows[i] == windows[0] && tables[i] == tables[0];
+    CHECK(same && windows[0] && tables[0], "tasks racing on the first use got different tables");
+    CHECK(K::Table(13).re == full && K::Table(12).re == half, "the tables were rebuilt");
+}
+
+int main()
+{
+    TestTables();
+    srand(1);
+    for (uint16_t n : {8, 64, 256, 1024})
+    {
+        for (double f : {0.0806, 0.25, 0.3711})
+        {
+            std::vector<int16_t> square(n);
+            for (int i = 0; i < n; i++)
+            {
+                square[i] = std::fmod(i * f, 1.0) < 0.5 ? 32767 : -32767;
+            }
+            // hamming reaches exactly 1.0; the hann window of arduinoFFT reaches 1.08 and saturates full scale input
+            for (uint8_t w : {FFT_WIN_TYP_RECTANGLE, FFT_WIN_TYP_HAMMING})
+            {
+                double e16 = MaxErrorLsb<int16_t>(square, w), e32 = MaxErrorLsb<int32_t>(square, w);
+                CHECK(e16 < 8, "square n=%u f=%.4f window=%u: Q15 error %.1f LSB", n, f, w, e16);
+                CHECK(e32 < 0.01, "square n=%u f=%.4f window=%u: Q31 error %.4f LSB", n, f, w, e32);
+            }
+        }
+        {
+            // unsigned full scale with a mean of 32767.5, so nothing saturates after the mean removal
+            std::vector<uint16_t> squareAdc(n), adc12(n);
+            for (int i = 0; i < n; i++)
+            {
+                squareAdc[i] = (i & 2) ? 65535 : 0;
+                adc12[i] = rand() % 4096;
+            }
+            double e16 = MaxErrorLsb<int16_t>(squareAdc, FFT_WIN_TYP_RECTANGLE), e32 = MaxErrorLsb<int32_t>(squareAdc, FFT_WIN_TYP_RECTANGLE);
+            CHECK(e16 < 8, "uint16 square n=%u: Q15 error %.1f LSB", n, e16);
+            CHECK(e32 < 1, "uint16 square n=%u: Q31 error %.4f LSB", n, e32); // the integer mean is 0.5 LSB off
+            e16 = MaxErrorLsb<int16_t>(adc12, FFT_WIN_TYP_HAMMING);
+            CHECK(e16 < 8, "12 bit ADC n=%u: Q15 error %.1f LSB", n, e16);
+        }
+        for (int run = 0; run < 20; run++)
+        {
+            std::vector<int16_t> noise(n);
+            for (auto &s : noise)
+            {
+                s = (rand() & 1) ? 32767 : -32767 + (rand() % 3) - 1; // full scale with both signs, some -32768
+            }
+            double e16 = MaxErrorLsb<int16_t>(noise, FFT_WIN_TYP_RECTANGLE), e32 = MaxErrorLsb<int32_t>(noise, FFT_WIN_TYP_RECTANGLE);
+            CHECK(e16 < 8, "random n=%u: Q15 error %.1f LSB", n, e16);
+            CHECK(e32 < 0.01, "random n=%u: Q31 error %.4f LSB", n, e32);
+        }
+    }
+    return HostTestResult("fft_real_test");
+}
@@ -0,0 +1,72 @@
+// Compute of arduinoFFT (double) and arduinoFFT_t<float/int16_t/int32_t> at 256, 512 and 1024 points. The host only shows
+// the relation of the types; on the ESP32 double is emulated in software and the differences are much larger
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "host_test.hh"
+#include "arduinoFFT.h"
+#include "arduinoFFT_t.h"
+
+using namespace std::chrono;
+
+// best of 5 runs, microseconds per call
+template <typename F>
+static double Measure(F f, uint16_t n)
+{
+    const int reps = 400000 / n;
+    double best{1e9};
+    for (int run = 0; run < 5; run++)
+    {
+        auto t0 = steady_clock::now();
+        for (int r = 0; r < reps; r++)
+        {
+            f();
+        }
+        best = std::min(best, duration<double, std::micro>(steady_clock::now() - t0).count() / reps);
+    }
+    return best;
+}
+
+template <typename T>
+static double Bench(const std::vector<double> &signal)
+{
+    const uint16_t n = signal.size();
+    std::vector<T> re(n), im(n);
+    const double fullScale = std::is_integral<T>::value ? std::ldexp(1.0, arduinoFFT_kernel<T>::FRACTION_BITS) - 1.0 : 1.0;
+    auto fill = [&]
+    {
+        for (int i = 0; i < n; i++)
+        {
+            re[i] = std::is_integral<T>::value ? (T)std::lrint(signal[i] * fullScale) : (T)signal[i];
+            im[i] = 0;
+        }
+    };
+    arduinoFFT_t<T> fft(re.data(), im.data(), n, 1000);
+    return Measure([&] { fill(); fft.Compute(FFT_FORWARD); }, n) - Measure(fill, n);
+}
+
+int main()
+{
+    printf("%6s %10s %10s %10s %10s   (us per forward Compute)\n", "points", "double", "float", "Q15", "Q31");
+    for (uint16_t n : {256, 512, 1024})
+    {
+        std::vector<double> signal(n);
+        for (int i = 0; i < n; i++)
+        {
+            signal[i] = 0.45 * std::sin(2 * M_PI * 37.3 * i / n) + 0.3 * std::sin(2 * M_PI * (n / 10 + 0.7) * i / n + 1);
+        }
+        std::vector<double> re(n), im(n);
+        arduinoFFT ref(re.data(), im.data(), n, 1000);
+        auto fill = [&]
+        {
+            std::copy(signal.begin(), signal.end(), re.begin());
+            std::fill(im.begin(), im.end(), 0.0);
+        };
+        const double tDouble = Measure([&] { fill(); ref.Compute(FFT_FORWARD); }, n) - Measure(fill, n);
+        const double tFloat = Bench<float>(signal), tQ15 = Bench<int16_t>(signal), tQ31 = Bench<int32_t>(signal);
+        printf("%6u %10.2f %10.2f %10.2f %10.2f\n", n, tDouble, tFloat, tQ15, tQ31);
+        CHECK(tDouble > 0 && tFloat > 0 && tQ15 > 0 && tQ31 > 0, "implausible timing at n=%u", n);
+    }
+    return HostTestResult("fft_t_bench");
+}
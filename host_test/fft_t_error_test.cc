@@ -0,0 +1,89 @@
+// The error bounds documented in arduinoFFT_t.h: Compute of float, Q15 and Q31 against the double arduinoFFT, relative to the
+// largest magnitude, up to 1024 points; plus the scaling of the fixed point reverse transform
+#include <cmath>
+#include <random>
+#include <vector>
+#include "host_test.hh"
+#include "arduinoFFT.h"
+#include "arduinoFFT_t.h"
+
+template <typename T>
+static double FullScale()
+{
+    return std::is_integral<T>::value ? std::ldexp(1.0, arduinoFFT_t<T>::FRACTION_BITS) - 1.0 : 1.0;
+}
+
+template <typename T>
+static T FromDouble(double v)
+{
+    if constexpr (std::is_integral<T>::value)
+        return (T)std::lrint(v * FullScale<T>());
+    else
+        return (T)v;
+}
+
+// fixed point values are X[k]/samples in units of full scale
+template <typename T>
+static double ToDouble(T v, uint16_t samples)
+{
+    if constexpr (std::is_integral<T>::value)
+        return (double)v * samples / FullScale<T>();
+    else
+        return v;
+}
+
+template <typename T>
+static void CheckForward(const std::vector<double> &signal, double bound, const char *name)
+{
+    const uint16_t n = signal.size();
+    std::vector<double> rr(signal), ri(n, 0.0);
+    arduinoFFT ref(rr.data(), ri.data(), n, 1000);
+    ref.Compute(FFT_FORWARD);
+
+    std::vector<T> re(n), im(n, 0);
+    for (int i = 0; i < n; i++)
+    {
+        re[i] = FromDouble<T>(signal[i]);
+    }
+    arduinoFFT_t<T> fft(re.data(), im.data(), n, 1000);
+    fft.Compute(FFT_FORWARD);
+
+    double err{0}, largest{0};
+    for (int k = 0; k < n; k++)
+    {
+        err = std::fmax(err, std::hypot(ToDouble(re[k], n) - rr[k], ToDouble(im[k], n) - ri[k]));
+        largest = std::fmax(largest, std::hypot(rr[k], ri[k]));
+    }
+    CHECK(err / largest < bound, "%s n=%u: forward error %.2e of the largest magnitude, documented %.0e", name, n, err / largest, bound);
+
+    // reverse of the forward result: floating point returns x[n], fixed point x[n]/samples
+    fft.Compute(FFT_REVERSE);
+    double roundtrip{0};
+    for (int i = 0; i < n; i++)
+    {
+        const double x = std::is_integral<T>::value ? (double)re[i] * n / FullScale<T>() : re[i];
+        roundtrip = std::fmax(roundtrip, std::fabs(x - signal[i]));
+    }
+    // the fixed point roundtrip keeps log2(samples) bits less than the type
+    const double roundtripBound = std::is_integral<T>::value ? n * 4.0 / FullScale<T>() : 1e-5;
+    CHECK(roundtrip < roundtripBound, "%s n=%u: roundtrip error %.2e, bound %.2e", name, n, roundtrip, roundtripBound);
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> noise(-1, 1);
+    for (uint16_t n : {8, 16, 64, 128, 256, 512, 1024})
+    {
+        // tones below full scale plus noise; real input, so the complex magnitude stays below full scale
+        std::vector<double> signal(n);
+        for (int i = 0; i < n; i++)
+        {
+            signal[i] = 0.45 * std::sin(2 * M_PI * 3.3 * i / n) + 0.3 * std::sin(2 * M_PI * (n / 10 + 0.7) * i / n + 1) + 0.05 * noise(rng);
+        }
+        CheckForward<float>(signal, 1e-6, "float");
+        CheckForward<int16_t>(signal, 1e-3, "Q15");
+        CheckForward<int32_t>(signal, 1e-8, "Q31");
+    }
+    return HostTestResult("fft_t_error_test");
+}
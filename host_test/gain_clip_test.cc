@@ -0,0 +1,187 @@
+// aCodecManager::GainAndClipToStereo: gain and clipping against a reference, mono to stereo expansion, unity gain, gain ramps;
+// and the time per block against the former two-pass implementation (mono expansion, then gain and clip)
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <driver/i2s_std.h>
+#include <codec_manager.hh>
+
+using namespace CodecManager;
+using namespace std::chrono;
+
+class TestCodec : public aCodecManager
+{
+public:
+    ErrorCode WriteAudioData(eChannels ch, eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) override { return ErrorCode::OK; }
+    ErrorCode SetPowerState(bool power) override { return ErrorCode::OK; }
+    ErrorCode SetVolume(uint8_t volume) override { return ErrorCode::OK; }
+
+    using aCodecManager::GainAndClipToStereo;
+    using aCodecManager::SetDigitalVolume;
+    using aCodecManager::SetGain;
+
+    ScaledGain CurrentGain() const { return gainScaled; }
+    bool Ramping() const { return gainCurrent != gainTarget; }
+
+    // the implementation before the fused pass: expand mono in a separate loop, then gain and clip every value
+    void TwoPass(int16_t *buf, size_t frames, eChannels ch)
+    {
+        if (ch == eChannels::ONE)
+        {
+            for (size_t i = frames; i-- > 0;)
+            {
+                buf[2 * i] = buf[i];
+                buf[2 * i + 1] = buf[i];
+            }
+        }
+        const ScaledGain g = gainScaled;
+        for (size_t i = 0; i < 2 * frames; i++)
+        {
+            int32_t v = (buf[i] * g.mant) >> g.shift;
+            buf[i] = v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v);
+        }
+    }
+
+protected:
+    ErrorCode SetSampleRate(uint32_t sampleRateHz) override { return ErrorCode::OK; }
+};
+
+static int16_t Reference(int16_t x, float gain)
+{
+    const double v = std::floor(x * (double)gain);
+    return (int16_t)std::clamp(v, (double)INT16_MIN, (double)INT16_MAX);
+}
+
+static std::vector<int16_t> Random(size_t n, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<int16_t> v(n);
+    for (auto &x : v)
+    {
+        x = (int16_t)rng();
+    }
+    v[0] = INT16_MIN;
+    v[1] = INT16_MAX;
+    return v;
+}
+
+static void TestStaticGain()
+{
+    const size_t frames = 1152;
+    for (float gain : {0.0f, 0.25f, 0.5f, 1.0f, 1.7f, 3.99f})
+    {
+        TestCodec codec;
+        codec.SetGain(gain);
+        codec.SetDigitalVolume(255, false); // no ramp: the gain applies from the first frame
+        const float effective = ((int)(gain * 64)) / 64.0f;  // F2P6
+
+        const std::vector<int16_t> src = Random(2 * frames, 1);
+        std::vector<int16_t> stereo(src);
+        codec.GainAndClipToStereo(stereo.data(), frames, eChannels::TWO);
+        int wrong{0};
+        for (size_t i = 0; i < 2 * frames; i++)
+        {
+            wrong += std::abs(stereo[i] - Reference(src[i], effective)) > 1;
+        }
+        CHECK(wrong == 0, "stereo gain %.2f: %d values differ from the reference by more than 1 LSB", gain, wrong);
+
+        std::vector<int16_t> mono(src);
+        codec.GainAndClipToStereo(mono.data(), frames, eChannels::ONE);
+        wrong = 0;
+        for (size_t i = 0; i < frames; i++)
+        {
+            wrong += mono[2 * i] != mono[2 * i + 1] || std::abs(mono[2 * i] - Reference(src[i], effective)) > 1;
+        }
+        CHECK(wrong == 0, "mono gain %.2f: %d frames wrong", gain, wrong);
+
+        // bit-identical to the former two-pass implementation
+        std::vector<int16_t> twoPass(src);
+        codec.TwoPass(twoPass.data(), frames, eChannels::ONE);
+        CHECK(twoPass == mono, "mono gain %.2f: differs from the two-pass implementation", gain);
+        twoPass = src;
+        codec.TwoPass(twoPass.data(), frames, eChannels::TWO);
+        CHECK(twoPass == stereo, "stereo gain %.2f: differs from the two-pass implementation", gain);
+    }
+
+    // unity: stereo data is not touched, full scale values stay full scale
+    TestCodec codec;
+    CHECK(codec.CurrentGain().IsUnity(), "default gain is not unity");
+    const std::vector<int16_t> src = Random(2 * 256, 2);
+    std::vector<int16_t> buf(src);
+    codec.GainAndClipToStereo(buf.data(), 256, eChannels::TWO);
+    CHECK(buf == src, "unity gain changed stereo data");
+}
+
+static void TestRamp()
+{
+    TestCodec codec;
+    codec.SetDigitalVolume(255, false);
+    codec.SetDigitalVolume(255 - 80, true); // -20dB, ramped
+    CHECK(codec.Ramping(), "volume change without ramp");
+
+    // constant input: the output must fall monotonically to 0.1 of the input and stay there, L == R for mono
+    const size_t frames = 512;
+    std::vector<int16_t> buf(2 * frames);
+    int16_t previous{INT16_MAX};
+    bool monotonic{true}, equal{true};
+    for (int block = 0; block < 20; block++)
+    {
+        std::fill(buf.begin(), buf.begin() + frames, 20000);
+        codec.GainAndClipToStereo(buf.data(), frames, eChannels::ONE);
+        for (size_t i = 0; i < frames; i++)
+        {
+            monotonic &= buf[2 * i] <= previous;
+            equal &= buf[2 * i] == buf[2 * i + 1];
+            previous = buf[2 * i];
+        }
+    }
+    CHECK(monotonic, "ramp down is not monotonic");
+    CHECK(equal, "mono ramp produced different channels");
+    CHECK(!codec.Ramping(), "ramp did not reach the target after 10240 frames");
+    CHECK(std::abs(previous - 2000) <= 2, "ramp ended at %d instead of 2000", previous);
+}
+
+static void Bench()
+{
+    const size_t frames = 4608;
+    const std::vector<int16_t> src = Random(2 * frames, 3);
+    std::vector<int16_t> buf(2 * frames);
+    TestCodec codec;
+    codec.SetGain(1.7f);
+    codec.SetDigitalVolume(255, false);
+    for (eChannels ch : {eChannels::TWO, eChannels::ONE})
+    {
+        double best[2]{1e9, 1e9};
+        for (int run = 0; run < 5; run++)
+        {
+            for (int fused = 0; fused < 2; fused++)
+            {
+                auto t0 = steady_clock::now();
+                for (int k = 0; k < 2000; k++)
+                {
+                    memcpy(buf.data(), src.data(), 2 * frames * sizeof(int16_t));
+                    if (fused)
+                        codec.GainAndClipToStereo(buf.data(), frames, ch);
+                    else
+                        codec.TwoPass(buf.data(), frames, ch);
+                }
+                best[fused] = std::min(best[fused], duration<double, std::micro>(steady_clock::now() - t0).count() / 2000);
+            }
+        }
+        printf("%s, %zu frames, gain 1.7: two-pass %.2fus, fused %.2fus per block (including a reset memcpy)\n",
+               ch == eChannels::TWO ? "stereo" : "mono", frames, best[0], best[1]);
+    }
+}
+
+int main()
+{
+    TestStaticGain();
+    TestRamp();
+    Bench();
+    return HostTestResult("gain_clip_test");
+}
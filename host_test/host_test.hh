@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks for the host tests: a failed CHECK prints its location and the test exits with 1 at the end
+inline int &HostTestFailures()
+{
+    static int failures{0};
+    return failures;
+}
+
+#define CHECK(cond, ...)                                                    \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__);                                            \
+            printf("\n");                                                   \
+            HostTestFailures()++;                                           \
+        }                                                                   \
+    } while (0)
+
+inline int HostTestResult(const char *name)
+{
+    printf("%s: %s\n", name, HostTestFailures() ? "FAILED" : "passed");
+    return HostTestFailures() ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+// filter::KalmanN<N> against N scalar filter::Kalman: equivalence of angle and rate per axis, and the time per sample of both
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "host_test.hh"
+#include "kalman.hh"
+
+using namespace std::chrono;
+
+template <size_t N>
+static void Run(size_t samples)
+{
+    const float dt = 0.005f;
+    std::mt19937 rng(N);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> angles(samples * N), rates(samples * N);
+    for (size_t s = 0; s < samples; s++)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            const float t = s * dt;
+            angles[s * N + i] = 30.0f * std::sin(0.7f * t + i) + 0.5f * noise(rng);
+            rates[s * N + i] = 21.0f * std::cos(0.7f * t + i) + 0.8f + 0.2f * noise(rng); // with a gyro bias
+        }
+    }
+
+    filter::Kalman scalar[N];
+    filter::KalmanN<N> vector(dt);
+    for (size_t i = 0; i < N; i++)
+    {
+        scalar[i].setQbias(0.003f + 0.001f * i); // different tuning per axis
+        vector.setQbias(i, 0.003f + 0.001f * i);
+    }
+    std::vector<float> out(N);
+    double maxAngleDiff{0}, maxRateDiff{0};
+    for (size_t s = 0; s < samples; s++)
+    {
+        vector.update(&angles[s * N], &rates[s * N], out.data());
+        for (size_t i = 0; i < N; i++)
+        {
+            const float a = scalar[i].getAngle(angles[s * N + i], rates[s * N + i], dt);
+            maxAngleDiff = std::max(maxAngleDiff, (double)std::fabs(a - out[i]));
+            maxRateDiff = std::max(maxRateDiff, (double)std::fabs(scalar[i].getRate() - vector.getRate(i)));
+        }
+    }
+    // KalmanN reorders the float operations (precomputed dt terms, one division), so the results differ by rounding only
+    CHECK(maxAngleDiff < 1e-4, "N=%zu: angle differs by %.2e degrees", N, maxAngleDiff);
+    CHECK(maxRateDiff < 1e-4, "N=%zu: rate differs by %.2e degrees/s", N, maxRateDiff);
+
+    volatile float sink{0}; // keeps the timed calls
+    double tScalar{1e9}, tVector{1e9};
+    for (int run = 0; run < 5; run++)
+    {
+        auto t0 = steady_clock::now();
+        for (size_t s = 0; s < samples; s++)
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                sink = sink + scalar[i].getAngle(angles[s * N + i], rates[s * N + i], dt);
+            }
+        }
+        auto t1 = steady_clock::now();
+        vector.updateBatch(angles.data(), rates.data(), samples, nullptr);
+        sink = sink + vector.getAngle(0);
+        auto t2 = steady_clock::now();
+        tScalar = std::min(tScalar, duration<double, std::nano>(t1 - t0).count() / samples);
+        tVector = std::min(tVector, duration<double, std::nano>(t2 - t1).count() / samples);
+    }
+    printf("N=%zu: max difference angle %.1e rate %.1e; %zu x Kalman %.1fns, KalmanN %.1fns per sample (%.2fx)\n", N, maxAngleDiff, maxRateDiff,
+           N, tScalar, tVector, tScalar / tVector);
+}
+
+int main()
+{
+    Run<2>(20000);
+    Run<3>(20000);
+    Run<6>(20000);
+    Run<8>(20000);
+    return HostTestResult("kalman_n_bench");
+}
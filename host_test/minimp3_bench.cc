@@ -0,0 +1,127 @@
+// minimp3 with the options of AudioPlayer.hh (scalar path, as on the ESP32 targets): decoding speed over all MP3 files of audio/,
+// and the PCM conversion, which compares in float instead of double, against the former double compares for every float of the
+// relevant range
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "host_test.hh"
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NO_SIMD
+#define MINIMP3_NONSTANDARD_BUT_LOGICAL
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+
+using namespace std::chrono;
+
+// mp3d_scale_pcm before the float constants
+static int16_t ScalePcmDouble(float sample)
+{
+    if (sample >= 32766.5) return (int16_t)32767;
+    if (sample <= -32767.5) return (int16_t)-32768;
+    int16_t s = (int16_t)(sample + .5f);
+    s -= (s < 0);
+    return s;
+}
+
+static std::vector<std::vector<uint8_t>> LoadMp3Files()
+{
+    std::vector<std::vector<uint8_t>> files;
+    for (const char *dir : {REPO_DIR "/audio/music", REPO_DIR "/audio/speech_de"})
+    {
+        DIR *d = opendir(dir);
+        if (!d)
+            continue;
+        while (dirent *e = readdir(d))
+        {
+            std::string name(e->d_name);
+            if (name.size() < 4 || name.compare(name.size() - 4, 4, ".mp3") != 0)
+                continue;
+            std::ifstream f(std::string(dir) + "/" + name, std::ios::binary);
+            files.emplace_back(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        }
+        closedir(d);
+    }
+    return files;
+}
+
+static size_t DecodeFile(const std::vector<uint8_t> &file, std::vector<int16_t> *pcm)
+{
+    mp3dec_t dec;
+    mp3dec_frame_info_t info;
+    int16_t frame[MINIMP3_MAX_SAMPLES_PER_FRAME];
+    mp3dec_init(&dec);
+    size_t pos{0}, frames{0};
+    while (pos < file.size())
+    {
+        int samples = mp3dec_decode_frame(&dec, file.data() + pos, file.size() - pos, frame, &info);
+        if (info.frame_bytes == 0)
+            break;
+        pos += info.frame_bytes;
+        frames++;
+        if (pcm)
+            pcm->insert(pcm->end(), frame, frame + samples * info.channels);
+    }
+    return frames;
+}
+
+// best of 5 runs, frames per second
+static double FramesPerSecond(const std::vector<std::vector<uint8_t>> &files)
+{
+    double best{0};
+    for (int run = 0; run < 5; run++)
+    {
+        size_t frames{0};
+        auto t0 = steady_clock::now();
+        for (const auto &f : files)
+        {
+            frames += DecodeFile(f, nullptr);
+        }
+        best = std::max(best, frames / duration<double>(steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+static void TestScalePcm()
+{
+    // every float with 2^-2 <= |x| < 2^17 (this covers both clipping thresholds), zero, infinity and NaN
+    size_t wrong{0};
+    for (uint32_t bits = 0x3E800000u; bits < 0x48000000u; bits++)
+    {
+        for (uint32_t sign : {0u, 0x80000000u})
+        {
+            float x;
+            uint32_t b = bits | sign;
+            memcpy(&x, &b, sizeof(x));
+            wrong += mp3d_scale_pcm(x) != ScalePcmDouble(x);
+        }
+    }
+    for (float x : {0.0f, -0.0f, INFINITY, -INFINITY, NAN})
+    {
+        wrong += mp3d_scale_pcm(x) != ScalePcmDouble(x);
+    }
+    CHECK(wrong == 0, "float compares convert %zu values differently than double compares", wrong);
+}
+
+int main()
+{
+    TestScalePcm();
+
+    const auto files = LoadMp3Files();
+    CHECK(files.size() > 0, "no MP3 files found in %s/audio", REPO_DIR);
+    size_t samples{0};
+    for (const auto &f : files)
+    {
+        std::vector<int16_t> pcm;
+        DecodeFile(f, &pcm);
+        samples += pcm.size();
+    }
+    CHECK(samples > 0, "nothing decoded");
+    printf("%zu files, %zu samples: %.0f frames/s\n", files.size(), samples, FramesPerSecond(files));
+    return HostTestResult("minimp3_bench");
+}
@@ -0,0 +1,183 @@
+// AudioPlayer::Mixer: Mix and MixRamped against an integer reference, saturation at both ends, unity gain, the end values of
+// gain ramps; and the time per 1152-frame block of 4 streams
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "host_test.hh"
+#include <mixer.hh>
+
+using namespace AudioPlayer;
+using namespace std::chrono;
+
+static std::vector<int16_t> Random(size_t n, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<int16_t> v(n);
+    for (auto &x : v)
+    {
+        x = (int16_t)rng();
+    }
+    return v;
+}
+
+static int16_t Reference(const std::vector<std::vector<int16_t>> &in, const uint16_t *gainQ15, size_t i)
+{
+    int64_t sum{0};
+    for (size_t k = 0; k < in.size(); k++)
+    {
+        sum += (in[k][i] * (int32_t)gainQ15[k]) >> 15;
+    }
+    return (int16_t)std::clamp<int64_t>(sum, INT16_MIN, INT16_MAX);
+}
+
+static void TestMix()
+{
+    const size_t samples = 2 * 1152 + 7; // not a multiple of the chunk
+    std::vector<std::vector<int16_t>> in;
+    for (uint32_t k = 0; k < MIXER_STREAMS; k++)
+        in.push_back(Random(samples, k + 1));
+    const int16_t *ptrs[MIXER_STREAMS];
+    for (size_t k = 0; k < MIXER_STREAMS; k++)
+        ptrs[k] = in[k].data();
+
+    const uint16_t gains[MIXER_STREAMS] = {GAIN_UNITY_Q15, GAIN_UNITY_Q15 / 2, 5000, 65535};
+    std::vector<int16_t> out(samples);
+    Mixer::Mix(out.data(), ptrs, gains, MIXER_STREAMS, samples);
+    size_t wrong{0}, clipped{0};
+    for (size_t i = 0; i < samples; i++)
+    {
+        const int16_t r = Reference(in, gains, i);
+        wrong += out[i] != r;
+        clipped += r == INT16_MAX || r == INT16_MIN;
+    }
+    CHECK(wrong == 0, "Mix: %zu of %zu values differ from the reference", wrong, samples);
+    CHECK(clipped > 0, "the random input does not reach the clipping thresholds");
+
+    // unity gain of a single stream, in place: unchanged
+    std::vector<int16_t> single(in[0]);
+    const int16_t *one[] = {single.data()};
+    const uint16_t unity[] = {GAIN_UNITY_Q15};
+    Mixer::Mix(single.data(), one, unity, 1, samples);
+    CHECK(single == in[0], "unity gain changed the stream");
+
+    // saturation at both ends
+    const std::vector<int16_t> high(samples, INT16_MAX), low(samples, INT16_MIN);
+    const int16_t *highs[] = {high.data(), high.data(), high.data(), high.data()};
+    const int16_t *lows[] = {low.data(), low.data(), low.data(), low.data()};
+    const uint16_t full[] = {65535, 65535, 65535, 65535};
+    Mixer::Mix(out.data(), highs, full, MIXER_STREAMS, samples);
+    CHECK(std::all_of(out.begin(), out.end(), [](int16_t v) { return v == 32767; }), "4 x 32767 did not saturate to 32767");
+    Mixer::Mix(out.data(), lows, full, MIXER_STREAMS, samples);
+    CHECK(std::all_of(out.begin(), out.end(), [](int16_t v) { return v == -32768; }), "4 x -32768 did not saturate to -32768");
+    const int16_t *single16[] = {low.data()};
+    Mixer::Mix(out.data(), single16, unity, 1, samples);
+    CHECK(out[0] == -32768, "-32768 at unity gain became %d", out[0]);
+}
+
+static void TestRamps()
+{
+    const size_t frames = 1152;
+    const std::vector<int16_t> constant(2 * frames, 20000);
+    const int16_t *in[] = {constant.data()};
+    std::vector<int16_t> out(2 * frames);
+
+    // without ramp and at unity, MixRamped equals Mix
+    Mixer::GainRamp ramp;
+    Mixer::GainRamp *ramps[] = {&ramp};
+    CHECK(ramp.IsUnity(), "a new ramp is not at unity");
+    Mixer::MixRamped(out.data(), in, ramps, 1, frames);
+    CHECK(out == constant, "unity ramp changed the stream");
+
+    // fade out over 1000 frames, split over blocks of different sizes: monotonic, exactly 0 at the end, L == R
+    ramp.RampTo(0, 1000);
+    int16_t previous{INT16_MAX};
+    bool monotonic{true}, equal{true};
+    size_t done{0};
+    for (size_t block : {100, 333, 1, 700})
+    {
+        Mixer::MixRamped(out.data(), in, ramps, 1, block);
+        for (size_t i = 0; i < block; i++)
+        {
+            monotonic &= out[2 * i] <= previous;
+            equal &= out[2 * i] == out[2 * i + 1];
+            previous = out[2 * i];
+        }
+        done += block;
+    }
+    CHECK(monotonic && equal, "fade out is not monotonic or not equal on both channels");
+    CHECK(ramp.Current() == 0 && ramp.IsSilent() && previous == 0, "fade out ended at gain %u, value %d", ramp.Current(), previous);
+
+    // fade in from 0 to unity over 999 frames: the first value is 0, the value after the ramp is the input
+    ramp.RampTo(GAIN_UNITY_Q15, 999);
+    Mixer::MixRamped(out.data(), in, ramps, 1, frames);
+    CHECK(out[0] == 0, "fade in starts at %d", out[0]);
+    CHECK(out[2 * 998] < 20000 && out[2 * 998] > 19900, "last ramped value %d", out[2 * 998]);
+    CHECK(std::all_of(out.begin() + 2 * 999, out.end(), [](int16_t v) { return v == 20000; }) && ramp.IsUnity(), "fade in did not end at unity");
+
+    // ramp to an odd target: no rounding drift
+    ramp.RampTo(12345, 777);
+    Mixer::MixRamped(out.data(), in, ramps, 1, frames);
+    CHECK(ramp.Current() == 12345 && !ramp.IsRamping(), "ramp ended at %u instead of 12345", ramp.Current());
+    CHECK(out[2 * frames - 1] == (20000 * 12345) >> 15, "value after the ramp %d", out[2 * frames - 1]);
+}
+
+static void Bench()
+{
+    const size_t frames = 1152;
+    std::vector<std::vector<int16_t>> in;
+    for (uint32_t k = 0; k < MIXER_STREAMS; k++)
+        in.push_back(Random(2 * frames, 10 + k));
+    const int16_t *ptrs[MIXER_STREAMS];
+    for (size_t k = 0; k < MIXER_STREAMS; k++)
+        ptrs[k] = in[k].data();
+    const uint16_t gains[MIXER_STREAMS] = {GAIN_UNITY_Q15, 20000, 10000, 5000};
+    Mixer::GainRamp ramps[MIXER_STREAMS];
+    Mixer::GainRamp *rampPtrs[MIXER_STREAMS];
+    for (size_t k = 0; k < MIXER_STREAMS; k++)
+        rampPtrs[k] = &ramps[k];
+    std::vector<int16_t> out(2 * frames);
+    volatile int16_t sink{0}; // keeps the timed calls
+
+    const int runs = 5, iterations = 2000;
+    double tMix{1e9}, tStatic{1e9}, tRamping{1e9};
+    for (int run = 0; run < runs; run++)
+    {
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            Mixer::Mix(out.data(), ptrs, gains, MIXER_STREAMS, 2 * frames);
+            sink = sink + out[i % out.size()];
+        }
+        auto t1 = steady_clock::now();
+        for (size_t k = 0; k < MIXER_STREAMS; k++)
+            ramps[k].Set(gains[k]);
+        for (int i = 0; i < iterations; i++)
+        {
+            Mixer::MixRamped(out.data(), ptrs, rampPtrs, MIXER_STREAMS, frames);
+            sink = sink + out[i % out.size()];
+        }
+        auto t2 = steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            for (size_t k = 0; k < MIXER_STREAMS; k++)
+                ramps[k].RampTo(i & 1 ? 0 : GAIN_UNITY_Q15, 2 * frames); // ramping during the whole block
+            Mixer::MixRamped(out.data(), ptrs, rampPtrs, MIXER_STREAMS, frames);
+            sink = sink + out[i % out.size()];
+        }
+        auto t3 = steady_clock::now();
+        tMix = std::min(tMix, duration<double, std::nano>(t1 - t0).count() / iterations);
+        tStatic = std::min(tStatic, duration<double, std::nano>(t2 - t1).count() / iterations);
+        tRamping = std::min(tRamping, duration<double, std::nano>(t3 - t2).count() / iterations);
+    }
+    printf("%zu streams, %zu stereo frames: Mix %.0fns, MixRamped %.0fns (static gains), %.0fns (all ramping) per block\n", MIXER_STREAMS, frames,
+           tMix, tStatic, tRamping);
+}
+
+int main()
+{
+    TestMix();
+    TestRamps();
+    Bench();
+    return HostTestResult("mixer_bench");
+}
@@ -0,0 +1,49 @@
+// AudioPlayer::Mp3IndexCache: hits, LRU replacement, and that the index in use is never chosen as victim, even if it is
+// the least recently used one (the player still reads it while the successor of a gapless transition is indexed)
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NONSTANDARD_BUT_LOGICAL
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+#include "mp3_index.hh"
+
+using namespace AudioPlayer;
+
+static std::vector<uint8_t> Load(const char *name)
+{
+    std::ifstream f(std::string(REPO_DIR "/audio/music/") + name, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+int main()
+{
+    const std::vector<uint8_t> a = Load("ding-dong.mp3"), b = Load("positive.mp3"), c = Load("negative.mp3"), d = Load("fanfare.mp3");
+    CHECK(!a.empty() && !b.empty() && !c.empty() && !d.empty(), "MP3 files missing");
+
+    Mp3IndexCache<2> cache;
+    const Mp3Index *ia = cache.Get(a.data(), a.size(), nullptr);
+    CHECK(ia->IsFor(a.data(), a.size()) && ia->GetFrameCount() > 0, "index of a not built");
+    const Mp3Index *ib = cache.Get(b.data(), b.size(), ia);
+    CHECK(ib != ia && ib->IsFor(b.data(), b.size()), "index of b replaced a");
+    CHECK(cache.Get(a.data(), a.size(), ib) == ia, "a was not a cache hit");
+
+    // b is the least recently used entry now; a new file replaces it
+    const Mp3Index *ic = cache.Get(c.data(), c.size(), ia);
+    CHECK(ic == ib && ic->IsFor(c.data(), c.size()), "c did not replace the least recently used entry");
+    CHECK(ia->IsFor(a.data(), a.size()), "a was replaced");
+
+    // a is the least recently used entry, but in use: d has to replace c instead
+    const uint32_t framesOfA = ia->GetFrameCount();
+    const int32_t lastOffsetOfA = ia->OffsetOfFrame(framesOfA - 1);
+    const Mp3Index *id = cache.Get(d.data(), d.size(), ia);
+    CHECK(id != ia, "the index in use was rebuilt");
+    CHECK(ia->IsFor(a.data(), a.size()) && ia->GetFrameCount() == framesOfA && ia->OffsetOfFrame(framesOfA - 1) == lastOffsetOfA,
+          "the index in use changed");
+    CHECK(id->IsFor(d.data(), d.size()), "index of d not built");
+    return HostTestResult("mp3_index_test");
+}
@@ -0,0 +1,155 @@
+// nau88c22::M against a mock register file: a sleep/wake cycle returns to the register image before the sleep with only the power
+// and speaker volume registers written, a volume change during the standby costs no transaction and is written on wake, and
+// RestoreRegisters after a simulated supply loss (registers back at their defaults) writes every changed register once and gives
+// the image before the loss, awake and in standby
+#include <algorithm>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <driver/i2s_std.h>
+#include <driver/i2c_master.h>
+#include <nau88c22.hh>
+
+using namespace nau88c22;
+
+// the I2S output and the power down pin are not used here
+esp_err_t gpio_set_level(gpio_num_t, int) { return ESP_OK; }
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t) { return ESP_OK; }
+esp_err_t gpio_reset_pin(gpio_num_t) { return ESP_OK; }
+esp_err_t i2s_new_channel(const i2s_chan_config_t *, i2s_chan_handle_t *, i2s_chan_handle_t *) { return ESP_OK; }
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t, const i2s_std_config_t *) { return ESP_OK; }
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t, const i2s_event_callbacks_t *, void *) { return ESP_OK; }
+esp_err_t i2s_channel_enable(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_disable(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t, const i2s_std_clk_config_t *) { return ESP_OK; }
+esp_err_t i2s_del_channel(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_write(i2s_chan_handle_t, const void *, size_t size, size_t *written, uint32_t)
+{
+    *written = size;
+    return ESP_OK;
+}
+
+// The codec: 9 bit registers, written as 7 bit address and 9 bit data; writing register 0 resets all registers
+namespace Nau
+{
+    struct Write
+    {
+        uint8_t reg;
+        uint16_t value;
+    };
+    uint16_t regs[REGISTER_COUNT];
+    std::vector<Write> writes;
+
+    std::vector<uint16_t> Image() { return std::vector<uint16_t>(regs, regs + REGISTER_COUNT); }
+    void LoseSupply() { std::copy(REGISTER_DEFAULTS, REGISTER_DEFAULTS + REGISTER_COUNT, regs); }
+    size_t WritesTo(uint8_t reg) { return std::count_if(writes.begin(), writes.end(), [reg](const Write &w) { return w.reg == reg; }); }
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t, const i2c_device_config_t *cfg, i2c_master_dev_handle_t *dev)
+{
+    *dev = (i2c_master_dev_handle_t)Nau::regs;
+    return cfg->device_address == NAU8822_I2C_ADDRESS ? ESP_OK : ESP_FAIL;
+}
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t, uint16_t address, int) { return address == NAU8822_I2C_ADDRESS ? ESP_OK : ESP_FAIL; }
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t, const uint8_t *buf, size_t len, int)
+{
+    if (len != 2)
+        return ESP_FAIL;
+    const uint8_t reg = buf[0] >> 1;
+    const uint16_t value = ((buf[0] & 1) << 8) | buf[1];
+    Nau::writes.push_back({reg, value});
+    if (reg == 0)
+        Nau::LoseSupply();
+    else if (reg < REGISTER_COUNT)
+        Nau::regs[reg] = value;
+    return ESP_OK;
+}
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t, const uint8_t *w, size_t, uint8_t *r, size_t, int)
+{
+    const uint16_t v = Nau::regs[w[0] >> 1];
+    r[0] = v >> 8;
+    r[1] = v & 0xFF;
+    return ESP_OK;
+}
+
+static constexpr uint8_t POWER_1 = 1, POWER_2 = 2, POWER_3 = 3, SPEAKER_L = 54, SPEAKER_R = 55, PGA_L = 45, PGA_R = 46;
+
+static uint16_t SpeakerVolume(uint8_t volume0_255) { return 0x100 | (volume0_255 >> 2); }
+
+static void TestSleepWake(M &codec)
+{
+    const std::vector<uint16_t> awake = Nau::Image();
+    CHECK(awake[SPEAKER_L] == SpeakerVolume(127) && awake[SPEAKER_R] == SpeakerVolume(127) && awake[POWER_1] == 0x1FD,
+          "after Init: speaker 0x%03X, power 1 0x%03X", awake[SPEAKER_L], awake[POWER_1]);
+
+    Nau::writes.clear();
+    CHECK(codec.SetPowerState(false) == ErrorCode::OK, "standby failed");
+    CHECK(Nau::regs[POWER_2] == 0 && Nau::regs[POWER_3] == 0 && Nau::regs[POWER_1] == (0x1FD & ~0x1F4),
+          "standby: power 1-3 0x%03X 0x%03X 0x%03X, VMID and bias must stay on", Nau::regs[POWER_1], Nau::regs[POWER_2], Nau::regs[POWER_3]);
+    CHECK(Nau::regs[SPEAKER_L] == 0x140 && Nau::regs[SPEAKER_R] == 0x140, "standby: speakers not muted");
+    CHECK(Nau::writes.size() == 5, "standby: %zu writes instead of 5", Nau::writes.size());
+
+    // stored for the wake, no transaction
+    Nau::writes.clear();
+    CHECK(codec.SetVolume(200) == ErrorCode::OK && Nau::writes.empty(), "SetVolume in standby: %zu writes", Nau::writes.size());
+    CHECK(codec.SetPowerState(false) == ErrorCode::OK && Nau::writes.empty(), "a second standby wrote %zu registers", Nau::writes.size());
+
+    CHECK(codec.SetPowerState(true) == ErrorCode::OK, "wake failed");
+    std::vector<uint16_t> expected = awake;
+    expected[SPEAKER_L] = expected[SPEAKER_R] = SpeakerVolume(200);
+    CHECK(Nau::Image() == expected, "the image after the wake differs from the one before the standby");
+    size_t other{0};
+    for (const auto &w : Nau::writes)
+        other += w.reg != POWER_1 && w.reg != POWER_2 && w.reg != POWER_3 && w.reg != SPEAKER_L && w.reg != SPEAKER_R;
+    CHECK(Nau::writes.size() == 5 && other == 0, "wake: %zu writes, %zu to other registers than power 1-3 and the speakers", Nau::writes.size(), other);
+    // the right register carries the update bit, so it comes last
+    CHECK(Nau::writes.back().reg == SPEAKER_R, "wake: the last write goes to register %u", Nau::writes.back().reg);
+
+    Nau::writes.clear();
+    CHECK(codec.SetVolume(200) == ErrorCode::OK && Nau::writes.empty(), "an unchanged volume wrote %zu registers", Nau::writes.size());
+}
+
+// supply loss, then RestoreRegisters: the software reset first, then each register, that differs from its default, exactly once
+static void LoseAndRestore(M &codec, const char *state)
+{
+    const std::vector<uint16_t> before = Nau::Image();
+    Nau::LoseSupply();
+    Nau::writes.clear();
+    CHECK(codec.RestoreRegisters() == ErrorCode::OK, "%s: RestoreRegisters failed", state);
+    CHECK(Nau::Image() == before, "%s: the restored image differs", state);
+    size_t unchanged{0}, twice{0};
+    for (uint8_t reg = 1; reg < REGISTER_COUNT; reg++)
+    {
+        const size_t n = Nau::WritesTo(reg);
+        unchanged += n > 0 && before[reg] == REGISTER_DEFAULTS[reg];
+        twice += n > 1;
+    }
+    CHECK(!Nau::writes.empty() && Nau::writes[0].reg == 0 && Nau::WritesTo(0) == 1, "%s: no software reset first", state);
+    CHECK(unchanged == 0 && twice == 0, "%s: %zu default registers written, %zu registers written twice", state, unchanged, twice);
+}
+
+static void TestRestore(M &codec)
+{
+    CHECK(codec.SetMicGain(30) == ErrorCode::OK, "SetMicGain failed");
+    CHECK(Nau::regs[PGA_L] == (0x080 | 30) && Nau::regs[PGA_R] == (0x180 | 30), "mic gain 0x%03X 0x%03X", Nau::regs[PGA_L], Nau::regs[PGA_R]);
+    LoseAndRestore(codec, "awake");
+
+    // in standby, the restored codec is still in standby and muted; the wake works as usual
+    CHECK(codec.SetPowerState(false) == ErrorCode::OK, "standby failed");
+    LoseAndRestore(codec, "standby");
+    CHECK(Nau::regs[SPEAKER_L] == 0x140 && Nau::regs[POWER_2] == 0, "standby: RestoreRegisters woke up the codec");
+    CHECK(codec.SetPowerState(true) == ErrorCode::OK && Nau::regs[SPEAKER_L] == SpeakerVolume(200) && Nau::regs[POWER_2] != 0,
+          "wake after the restore: speaker 0x%03X", Nau::regs[SPEAKER_L]);
+}
+
+int main()
+{
+    Nau::LoseSupply();
+    M codec(nullptr, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, 127, 44100, GPIO_NUM_0);
+    CHECK(codec.RestoreRegisters() == ErrorCode::NOT_YET_INITIALIZED, "RestoreRegisters before Init did not fail");
+    CHECK(codec.Init() == ErrorCode::OK, "Init failed");
+    TestSleepWake(codec);
+    TestRestore(codec);
+    return HostTestResult("nau88c22_registers_test");
+}
@@ -0,0 +1,174 @@
+// AudioPlayer::Player scheduling: an announcement pre-empts music, which resumes at the interrupted position afterwards; music
+// orders queue up unless they cancel the previous one; two queued MP3 orders of the same format play gapless; and the state
+// queried by other tasks (IsEmittingSamples, GetPositionMs) is read from another thread while the Loop runs
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <AudioPlayer.hh>
+
+using namespace AudioPlayer;
+
+static const std::string MUSIC = REPO_DIR "/audio/music/";
+
+static std::vector<uint8_t> Load(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+// every block written by the player: its length and its first left sample
+class BlockCodec : public CodecManager::aCodecManager
+{
+public:
+    struct Block
+    {
+        size_t frames;
+        int16_t first;
+    };
+    std::vector<Block> blocks;
+    size_t frames{0};
+    ErrorCode WriteAudioData(CodecManager::eChannels ch, CodecManager::eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) override
+    {
+        blocks.push_back({sampleCnt, ((const int16_t *)buf)[0]});
+        frames += sampleCnt;
+        return ErrorCode::OK;
+    }
+    ErrorCode SetPowerState(bool power) override { return ErrorCode::OK; }
+    ErrorCode SetVolume(uint8_t volume) override { return ErrorCode::OK; }
+
+protected:
+    ErrorCode SetSampleRate(uint32_t sampleRateHz) override { return ErrorCode::OK; }
+};
+
+static void PlayToEnd(Player &player)
+{
+    for (int i = 0; i < 10000 && (i < 2 || player.IsEmittingSamples()); i++)
+        player.Loop();
+}
+
+static constexpr size_t FULL_BLOCK = MP3::FRAMES_IN_BUFFER * MP3::SAMPLES_PER_FRAME;
+
+static void TestPreemptAndResume(const std::vector<uint8_t> &music)
+{
+    // 0.2s of a constant value, which no MP3 block starts with
+    const int16_t MARK = 1234;
+    const std::vector<int16_t> announcement(2 * 8820, MARK);
+    BlockCodec codec;
+    Player player(&codec);
+    player.PlayMP3(music.data(), music.size(), 0, false);
+    for (int i = 0; i < 10; i++)
+        player.Loop();
+    const uint32_t interruptedMs = player.GetPositionMs();
+    CHECK(interruptedMs > 500 && player.IsEmittingSamples(), "music at %ums before the announcement", interruptedMs);
+
+    player.PlayPCM((const uint8_t *)announcement.data(), announcement.size() * sizeof(int16_t), 44100, 0, false, Priority::ANNOUNCEMENT);
+    const size_t before = codec.blocks.size();
+    player.Loop();
+    CHECK(codec.blocks.size() == before + 1 && codec.blocks.back().first == MARK, "the announcement did not pre-empt the music");
+    CHECK(player.GetPositionMs() == 0 && player.IsEmittingSamples(), "position %ums during the announcement", player.GetPositionMs());
+    // a music order without cancelPrevious waits, also after the announcement: the interrupted music comes first
+    player.PlayMP3(music.data(), music.size(), 0, false);
+    while (codec.blocks.back().first == MARK)
+        player.Loop();
+    const uint32_t resumedMs = player.GetPositionMs();
+    // the first block after the resume: pre-roll plus the rest of the block
+    CHECK(resumedMs >= interruptedMs && resumedMs < interruptedMs + 150, "resumed at %ums, interrupted at %ums", resumedMs, interruptedMs);
+    size_t markBlocks{0};
+    for (const auto &b : codec.blocks)
+        markBlocks += b.first == MARK;
+    CHECK(markBlocks * FULL_BLOCK >= announcement.size() / 2, "only %zu blocks of the announcement", markBlocks);
+}
+
+static void TestMusicQueue(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+    uint32_t durationA, durationB;
+    {
+        BlockCodec codec;
+        Player player(&codec);
+        player.PlayMP3(b.data(), b.size(), 0, false);
+        player.Loop();
+        durationB = player.GetDurationMs();
+    }
+    BlockCodec codec;
+    Player player(&codec);
+    player.PlayMP3(a.data(), a.size(), 0, false);
+    player.Loop();
+    durationA = player.GetDurationMs();
+    CHECK(durationA != durationB && durationA > 0 && durationB > 0, "durations %u and %u", durationA, durationB);
+    player.PlayMP3(b.data(), b.size(), 0, false);
+    for (int i = 0; i < 3; i++)
+        player.Loop();
+    CHECK(player.GetDurationMs() == durationA, "a queued music order interrupted the current one");
+    player.PlayMP3(b.data(), b.size(), 0, true);
+    player.Loop();
+    CHECK(player.GetDurationMs() == durationB && player.GetPositionMs() < 150, "cancelPrevious did not start the new order at once");
+}
+
+// two queued orders of the same MP3 at the output rate (no resampler between decoder and codec): one block sequence without a partial block at the transition, as many frames as both alone
+static void TestGapless(const std::vector<uint8_t> &mp3)
+{
+    BlockCodec single;
+    {
+        Player player(&single);
+        player.PlayMP3(mp3.data(), mp3.size(), 0, false);
+        PlayToEnd(player);
+    }
+    CHECK(single.frames % FULL_BLOCK != 0, "the file ends with a full block, so the test can not see the transition");
+
+    BlockCodec both;
+    Player player(&both);
+    player.PlayMP3(mp3.data(), mp3.size(), 0, false);
+    player.PlayMP3(mp3.data(), mp3.size(), 0, false);
+    PlayToEnd(player);
+    size_t partial{0};
+    for (size_t i = 0; i + 1 < both.blocks.size(); i++)
+        partial += both.blocks[i].frames != FULL_BLOCK;
+    CHECK(both.frames == 2 * single.frames, "%zu frames instead of %zu", both.frames, 2 * single.frames);
+    CHECK(partial == 0, "%zu partial blocks before the last one: not gapless", partial);
+}
+
+// another task polls the published state while the Loop task plays: the position only grows and ends at 0
+static void TestQueriesFromAnotherTask(const std::vector<uint8_t> &music)
+{
+    BlockCodec codec;
+    Player player(&codec);
+    player.PlayMP3(music.data(), music.size(), 0, false);
+    player.Loop();
+    const uint32_t duration = player.GetDurationMs();
+    std::atomic<bool> done{false};
+    size_t backwards{0}, beyond{0}, polls{0};
+    std::thread poller([&] {
+        uint32_t last{0};
+        while (!done)
+        {
+            uint32_t ms = player.GetPositionMs();
+            backwards += ms < last && ms != 0;
+            beyond += ms > duration;
+            last = ms ? ms : last;
+            polls += player.IsEmittingSamples();
+        }
+    });
+    PlayToEnd(player);
+    done = true;
+    poller.join();
+    CHECK(backwards == 0 && beyond == 0, "position went backwards %zu times, beyond the duration %zu times", backwards, beyond);
+    CHECK(polls > 0 && !player.IsEmittingSamples() && player.GetPositionMs() == 0, "state after the end: emitting %d, %ums",
+          player.IsEmittingSamples(), player.GetPositionMs());
+}
+
+int main()
+{
+    const std::vector<uint8_t> fanfare = Load(MUSIC + "fanfare.mp3"), positive = Load(MUSIC + "positive.mp3"),
+                                dingDong = Load(MUSIC + "ding-dong.mp3");
+    TestPreemptAndResume(fanfare);
+    TestMusicQueue(fanfare, positive);
+    TestGapless(dingDong);
+    TestQueriesFromAnotherTask(fanfare);
+    return HostTestResult("player_schedule_test");
+}
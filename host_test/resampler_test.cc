@@ -0,0 +1,150 @@
+// AudioPlayer::Resampler with a 1kHz sine at 22.05->44.1kHz and 48->44.1kHz: the output follows the ideal sine, Flush delivers
+// the last frames, so the output has the full length, and nothing of a stream leaks into the next one; the same for PCM orders
+// of the player (flush at the end of an order, reset at the start of the next) and for ResamplingSource (flush on exhaustion)
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <AudioPlayer.hh>
+
+using namespace AudioPlayer;
+
+static constexpr double FREQ = 1000, AMPLITUDE = 16000;
+static constexpr uint32_t OUT_RATE = 44100;
+
+static std::vector<int16_t> Sine(uint32_t rate, size_t frames)
+{
+    std::vector<int16_t> v(2 * frames);
+    for (size_t i = 0; i < frames; i++)
+        v[2 * i] = v[2 * i + 1] = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * FREQ * i / rate));
+    return v;
+}
+
+// largest difference of the left channel to the ideal sine at OUT_RATE, without the first and last TAPS frames, where the
+// filter sees the silence before and after the stream
+static double MaxError(const std::vector<int16_t> &out)
+{
+    double err{0};
+    const size_t frames = out.size() / 2;
+    for (size_t i = Resampler::TAPS; i + Resampler::TAPS < frames; i++)
+        err = std::max(err, std::fabs(out[2 * i] - AMPLITUDE * sin(2 * M_PI * FREQ * i / OUT_RATE)));
+    return err;
+}
+
+static size_t ExpectedFrames(size_t inFrames, uint32_t inRate) { return (size_t)ceil((double)inFrames * OUT_RATE / inRate); }
+
+// the step is rounded down, so one more frame may fit
+static bool FullLength(size_t outFrames, size_t inFrames, uint32_t inRate)
+{
+    return outFrames == ExpectedFrames(inFrames, inRate) || outFrames == ExpectedFrames(inFrames, inRate) + 1;
+}
+
+static void TestResampler(uint32_t inRate)
+{
+    const size_t frames = inRate / 2;
+    const std::vector<int16_t> in = Sine(inRate, frames);
+    Resampler r;
+    r.Configure(inRate, OUT_RATE);
+    std::vector<int16_t> out, buf(2 * 1024);
+    for (size_t done = 0; done < frames;)
+    {
+        size_t used{0};
+        size_t n = r.Process(in.data() + 2 * done, std::min<size_t>(1152, frames - done), &used, buf.data(), 1024);
+        out.insert(out.end(), buf.begin(), buf.begin() + 2 * n);
+        done += used;
+    }
+    const size_t beforeFlush = out.size() / 2;
+    size_t n = r.Flush(buf.data(), 1024);
+    out.insert(out.end(), buf.begin(), buf.begin() + 2 * n);
+    const size_t expected = ExpectedFrames(frames, inRate);
+    CHECK(FullLength(out.size() / 2, frames, inRate), "%u->%u: %zu frames (%zu before Flush) instead of %zu", inRate, OUT_RATE,
+          out.size() / 2, beforeFlush, expected);
+    const double err = MaxError(out);
+    CHECK(err < AMPLITUDE * 0.005, "%u->%u: error %.0f", inRate, OUT_RATE, err);
+    // the tail is the end of the sine, not cut off: the last full period before the end has the full amplitude
+    int peak{0};
+    for (size_t i = out.size() / 2 - Resampler::TAPS - OUT_RATE / FREQ; i < out.size() / 2 - Resampler::TAPS; i++)
+        peak = std::max(peak, std::abs((int)out[2 * i]));
+    CHECK(std::abs(peak - AMPLITUDE) < AMPLITUDE * 0.01, "%u->%u: peak %d in the last period", inRate, OUT_RATE, peak);
+
+    // the next stream starts without the history of the previous one
+    const std::vector<int16_t> silence(2 * 1000, 0);
+    size_t used{0};
+    n = r.Process(silence.data(), 1000, &used, buf.data(), 1024);
+    CHECK(n > 0 && std::all_of(buf.begin(), buf.begin() + 2 * n, [](int16_t v) { return v == 0; }), "%u->%u: stale tail after Flush", inRate,
+          OUT_RATE);
+}
+
+// the overlay path: ResamplingSource over an exhausting source delivers the whole stream
+static void TestResamplingSource(uint32_t inRate)
+{
+    const size_t frames = inRate / 4;
+    const std::vector<int16_t> in = Sine(inRate, frames);
+    PcmSource pcm(in.data(), frames, 2, inRate);
+    ResamplingSource rs;
+    rs.SetSource(&pcm, OUT_RATE);
+    std::vector<int16_t> out, buf(2 * 256);
+    size_t n;
+    while ((n = rs.Read(buf.data(), 256)) > 0)
+        out.insert(out.end(), buf.begin(), buf.begin() + 2 * n);
+    CHECK(FullLength(out.size() / 2, frames, inRate), "ResamplingSource %u->%u: %zu frames instead of %zu", inRate, OUT_RATE, out.size() / 2,
+          ExpectedFrames(frames, inRate));
+    CHECK(MaxError(out) < AMPLITUDE * 0.005, "ResamplingSource %u->%u: error %.0f", inRate, OUT_RATE, MaxError(out));
+}
+
+class CollectingCodec : public CodecManager::aCodecManager
+{
+public:
+    std::vector<int16_t> out;
+    ErrorCode WriteAudioData(CodecManager::eChannels ch, CodecManager::eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) override
+    {
+        const int16_t *s = (const int16_t *)buf;
+        out.insert(out.end(), s, s + sampleCnt * (size_t)ch);
+        return ErrorCode::OK;
+    }
+    ErrorCode SetPowerState(bool power) override { return ErrorCode::OK; }
+    ErrorCode SetVolume(uint8_t volume) override { return ErrorCode::OK; }
+
+protected:
+    ErrorCode SetSampleRate(uint32_t sampleRateHz) override { return ErrorCode::OK; }
+};
+
+static void PlayToEnd(Player &player)
+{
+    for (int i = 0; i < 10000 && (i < 2 || player.IsEmittingSamples()); i++)
+        player.Loop();
+}
+
+// two PCM orders with the same rate: the first one is complete, the second (silence) gets nothing of the first one
+static void TestPlayer(uint32_t inRate)
+{
+    const size_t frames = inRate / 2;
+    const std::vector<int16_t> sine = Sine(inRate, frames), silence(2 * frames, 0);
+    CollectingCodec codec;
+    Player player(&codec);
+    player.PlayPCM((const uint8_t *)sine.data(), sine.size() * sizeof(int16_t), inRate, 0, false);
+    PlayToEnd(player);
+    const std::vector<int16_t> first = codec.out;
+    codec.out.clear();
+    player.PlayPCM((const uint8_t *)silence.data(), silence.size() * sizeof(int16_t), inRate, 0, false);
+    PlayToEnd(player);
+
+    CHECK(FullLength(first.size() / 2, frames, inRate), "player %u->%u: %zu frames instead of %zu", inRate, OUT_RATE, first.size() / 2,
+          ExpectedFrames(frames, inRate));
+    CHECK(MaxError(first) < AMPLITUDE * 0.005, "player %u->%u: error %.0f", inRate, OUT_RATE, MaxError(first));
+    const size_t stale = std::count_if(codec.out.begin(), codec.out.end(), [](int16_t v) { return v != 0; });
+    CHECK(!codec.out.empty() && stale == 0, "player %u->%u: %zu values of the previous order in the next one", inRate, OUT_RATE, stale);
+}
+
+int main()
+{
+    for (uint32_t rate : {22050u, 48000u})
+    {
+        TestResampler(rate);
+        TestResamplingSource(rate);
+        TestPlayer(rate);
+    }
+    return HostTestResult("resampler_test");
+}
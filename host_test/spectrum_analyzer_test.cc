@@ -0,0 +1,110 @@
+// SpectrumAnalyzer::M with known tones: OnCapture (interleaved stereo, the configured channel only) and FeedAdc (type 2
+// conversion results around the ADC midscale), fed in blocks of odd sizes; the number of frames and spectra follows from hop and
+// averages, the peak of every spectrum is at the tone
+#include <cmath>
+#include <vector>
+#include "host_test.hh"
+#include <spectrum_analyzer.hh>
+
+using namespace SpectrumAnalyzer;
+
+static constexpr float RATE = 16000;
+static constexpr uint16_t SAMPLES = 1024, HOP = 256, AVERAGES = 4;
+static constexpr size_t FED = 40000;
+
+struct Result
+{
+    uint32_t spectra{0};
+    uint32_t lastSequence{0};
+    float maxPeakError{0};
+    float expectedHz{0};
+    uint16_t bins{0};
+};
+
+static void OnSpectrum(const Spectrum &s, void *userCtx)
+{
+    Result *r = static_cast<Result *>(userCtx);
+    r->spectra++;
+    r->lastSequence = s.sequence;
+    r->bins = s.bins;
+    r->maxPeakError = std::max(r->maxPeakError, std::fabs(s.peakFrequencyHz - r->expectedHz));
+}
+
+static Config MakeConfig(uint8_t channel)
+{
+    return Config{SAMPLES, HOP, AVERAGES, RATE, FFT_WIN_TYP_HANN, 0.5f, channel};
+}
+
+// frames: every HOP samples, once the first SAMPLES samples are there
+static uint32_t ExpectedFrames(size_t fed) { return fed < SAMPLES ? 0 : (fed - SAMPLES) / HOP + 1; }
+
+static const size_t BLOCKS[] = {1, 333, 1024, 77, 4000};
+
+static void TestCapture()
+{
+    // the tone on the right channel, a louder one on the left channel
+    const float tone = 1234.5f, other = 3000;
+    std::vector<int16_t> frames(2 * FED);
+    for (size_t i = 0; i < FED; i++)
+    {
+        frames[2 * i] = (int16_t)lrintf(20000 * sinf(2 * (float)M_PI * other * i / RATE));
+        frames[2 * i + 1] = (int16_t)lrintf(8000 * sinf(2 * (float)M_PI * tone * i / RATE));
+    }
+    Result r;
+    r.expectedHz = tone;
+    M<int16_t> analyzer(MakeConfig(1), OnSpectrum, &r);
+    CHECK(analyzer.Init() == ErrorCode::OK, "Init failed");
+    for (size_t done = 0, k = 0; done < FED; k++)
+    {
+        const size_t n = std::min(BLOCKS[k % 5], FED - done);
+        M<int16_t>::OnCapture(frames.data() + 2 * done, n, &analyzer);
+        done += n;
+    }
+    const Statistics st = analyzer.GetStatistics();
+    CHECK(st.samples == FED && st.frames == ExpectedFrames(FED), "capture: %u samples, %u frames instead of %u", st.samples, st.frames,
+          ExpectedFrames(FED));
+    CHECK(st.spectra == st.frames / AVERAGES && r.spectra == st.spectra && r.lastSequence == st.spectra, "capture: %u spectra, %u callbacks",
+          st.spectra, r.spectra);
+    CHECK(r.bins == SAMPLES / 2 + 1, "capture: %u bins", r.bins);
+    CHECK(r.maxPeakError < RATE / SAMPLES / 4, "capture: peak %.2fHz off the tone", r.maxPeakError);
+}
+
+static void TestAdc()
+{
+    const float tone = 500;
+    std::vector<uint8_t> results(FED * SOC_ADC_DIGI_RESULT_BYTES);
+    for (size_t i = 0; i < FED; i++)
+    {
+        adc_digi_output_data_t d{};
+        d.type2.data = (uint32_t)lrintf(2048 + 1500 * sinf(2 * (float)M_PI * tone * i / RATE));
+        d.type2.channel = 3;
+        memcpy(&results[i * SOC_ADC_DIGI_RESULT_BYTES], &d, sizeof(d));
+    }
+    Result r;
+    r.expectedHz = tone;
+    M<uint16_t> analyzer(MakeConfig(0), OnSpectrum, &r);
+    CHECK(analyzer.Init() == ErrorCode::OK, "Init failed");
+    for (size_t done = 0, k = 0; done < FED; k++)
+    {
+        const size_t n = std::min(BLOCKS[k % 5], FED - done);
+        analyzer.FeedAdc(results.data() + done * SOC_ADC_DIGI_RESULT_BYTES, n * SOC_ADC_DIGI_RESULT_BYTES);
+        done += n;
+    }
+    const Statistics st = analyzer.GetStatistics();
+    CHECK(st.samples == FED && st.frames == ExpectedFrames(FED), "ADC: %u samples, %u frames instead of %u", st.samples, st.frames,
+          ExpectedFrames(FED));
+    CHECK(st.spectra == st.frames / AVERAGES && r.spectra == st.spectra, "ADC: %u spectra, %u callbacks", st.spectra, r.spectra);
+    // the midscale offset is removed, so the tone and not bin 0 is the peak
+    CHECK(r.maxPeakError < RATE / SAMPLES / 4, "ADC: peak %.2fHz off the tone", r.maxPeakError);
+
+    // a length that is not a multiple of the result size: the incomplete result is ignored
+    analyzer.FeedAdc(results.data(), SOC_ADC_DIGI_RESULT_BYTES + 3);
+    CHECK(analyzer.GetStatistics().samples == FED + 1, "ADC: %u samples after an incomplete result", analyzer.GetStatistics().samples);
+}
+
+int main()
+{
+    TestCapture();
+    TestAdc();
+    return HostTestResult("spectrum_analyzer_test");
+}
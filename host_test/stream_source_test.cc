@@ -0,0 +1,159 @@
+// AudioPlayer::StreamReader with FileSource on local files: the stream arrives complete, Stop returns while the reader task is
+// blocked in a slow Read (like HttpSource waiting for the network) and the next source gets none of its predecessor's data; and the
+// player: a streamed MP3 sounds exactly like the same file in memory, and stopping a slow stream does not block Loop
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <AudioPlayer.hh>
+
+using namespace AudioPlayer;
+using namespace std::chrono;
+
+static const std::string MUSIC = REPO_DIR "/audio/music/";
+
+static std::vector<uint8_t> Load(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+// a network source: every Read waits readMs, e.g. for the next TCP segment
+class SlowSource : public FileSource
+{
+    int readMs;
+
+public:
+    SlowSource(const char *path, int readMs) : FileSource(path), readMs(readMs) {}
+    int Read(uint8_t *buf, size_t len) override
+    {
+        vTaskDelay(pdMS_TO_TICKS(readMs));
+        return FileSource::Read(buf, std::min<size_t>(len, 300));
+    }
+};
+
+class CollectingCodec : public CodecManager::aCodecManager
+{
+public:
+    std::vector<int16_t> out;
+    ErrorCode WriteAudioData(CodecManager::eChannels ch, CodecManager::eSampleBits bits, uint32_t sampleRateHz, size_t sampleCnt, void *buf) override
+    {
+        const int16_t *s = (const int16_t *)buf;
+        out.insert(out.end(), s, s + sampleCnt * (size_t)ch);
+        return ErrorCode::OK;
+    }
+    ErrorCode SetPowerState(bool power) override { return ErrorCode::OK; }
+    ErrorCode SetVolume(uint8_t volume) override { return ErrorCode::OK; }
+
+protected:
+    ErrorCode SetSampleRate(uint32_t sampleRateHz) override { return ErrorCode::OK; }
+};
+
+// takes everything out of the reader, until it is exhausted
+static std::vector<uint8_t> ReadAll(StreamReader &reader)
+{
+    std::vector<uint8_t> got;
+    auto t0 = steady_clock::now();
+    while (!reader.IsExhausted() && steady_clock::now() - t0 < seconds(10))
+    {
+        const uint8_t *data;
+        size_t n = reader.Window(&data);
+        n = std::min<size_t>(n, 700); // like a decoder, which consumes frame by frame
+        got.insert(got.end(), data, data + n);
+        reader.Consume(n);
+    }
+    return got;
+}
+
+static void TestReader()
+{
+    const std::string a = MUSIC + "fanfare.mp3", b = MUSIC + "siren.mp3";
+    StreamReader reader;
+    CHECK(reader.Init() == ErrorCode::OK, "Init failed");
+
+    FileSource fa(a.c_str());
+    CHECK(reader.Start(&fa) == ErrorCode::OK, "Start failed");
+    CHECK(ReadAll(reader) == Load(a), "stream of %s differs from the file", a.c_str());
+    reader.Stop();
+
+    // stop while the task is in a 300ms Read: Stop must not wait for it, the next source starts after it, without stale data
+    SlowSource slow(a.c_str(), 300);
+    CHECK(reader.Start(&slow) == ErrorCode::OK, "Start of the slow source failed");
+    vTaskDelay(pdMS_TO_TICKS(350)); // the first chunk is in the ring, the task waits in the second Read
+    auto t0 = steady_clock::now();
+    reader.Stop();
+    const double stopMs = duration<double, std::milli>(steady_clock::now() - t0).count();
+    CHECK(stopMs < 50, "Stop blocked for %.0fms", stopMs);
+
+    FileSource fb(b.c_str());
+    CHECK(reader.Start(&fb) == ErrorCode::OK, "Start while the previous source is still being closed failed");
+    CHECK(!reader.IsExhausted(), "exhausted before the source has been started");
+    CHECK(ReadAll(reader) == Load(b), "stream after a stop differs from %s", b.c_str());
+    reader.Stop();
+
+    // stop and restart before the task has closed the first source: the second Start must not be lost
+    SlowSource slow2(a.c_str(), 200);
+    reader.Start(&slow2);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    reader.Stop();
+    FileSource fa2(a.c_str());
+    reader.Start(&fa2);
+    reader.Stop();
+    FileSource fb2(b.c_str());
+    reader.Start(&fb2);
+    CHECK(ReadAll(reader) == Load(b), "stream after two stops differs from %s", b.c_str());
+    reader.Stop();
+    vTaskDelay(pdMS_TO_TICKS(250)); // slow2 is closed before it goes out of scope
+}
+
+static void TestPlayer()
+{
+    const std::string path = MUSIC + "positive.mp3";
+    const std::vector<uint8_t> file = Load(path);
+
+    CollectingCodec memoryCodec, streamCodec;
+    {
+        Player player(&memoryCodec);
+        player.PlayMP3(file.data(), file.size(), 0, false);
+        for (int i = 0; i < 10000 && (i < 2 || player.IsEmittingSamples()); i++)
+            player.Loop();
+    }
+    FileSource source(path.c_str());
+    Player player(&streamCodec);
+    player.PlayMP3Stream(&source, 0, false);
+    for (int i = 0; i < 10000 && (i < 2 || player.IsEmittingSamples()); i++)
+        player.Loop();
+    CHECK(!memoryCodec.out.empty() && streamCodec.out == memoryCodec.out, "streamed MP3: %zu samples, from memory: %zu samples, or different",
+          streamCodec.out.size(), memoryCodec.out.size());
+
+    // stop a stream, whose source waits 500ms per Read; Loop must go on with the next order meanwhile
+    SlowSource slow(path.c_str(), 500);
+    player.PlayMP3Stream(&slow, 0, false);
+    for (int i = 0; i < 3; i++)
+        player.Loop();
+    vTaskDelay(pdMS_TO_TICKS(100));
+    player.Stop();
+    double longestLoopMs{0};
+    for (int i = 0; i < 5; i++)
+    {
+        auto t0 = steady_clock::now();
+        player.Loop();
+        longestLoopMs = std::max(longestLoopMs, duration<double, std::milli>(steady_clock::now() - t0).count());
+    }
+    CHECK(longestLoopMs < 100, "Loop blocked for %.0fms after stopping a slow stream", longestLoopMs);
+    vTaskDelay(pdMS_TO_TICKS(600)); // slow is closed before it goes out of scope
+}
+
+int main()
+{
+    TestReader();
+    TestPlayer();
+    fflush(stdout);
+    _exit(HostTestResult("stream_source_test")); // the reader tasks run forever
+}
@@ -0,0 +1,11 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+typedef struct dac_cont* dac_continuous_handle_t;
+typedef enum {DAC_CHANNEL_MASK_CH0=1} dac_channel_mask_t; typedef enum {DAC_DIGI_CLK_SRC_APLL} dac_clk_src_t; typedef enum {DAC_CHANNEL_MODE_SIMUL} dac_mode_t;
+typedef struct { dac_channel_mask_t chan_mask; uint32_t desc_num; size_t buf_size; uint32_t freq_hz; int8_t offset; dac_clk_src_t clk_src; dac_mode_t chan_mode;} dac_continuous_config_t;
+esp_err_t dac_continuous_new_channels(const dac_continuous_config_t*, dac_continuous_handle_t*);
+esp_err_t dac_continuous_enable(dac_continuous_handle_t); esp_err_t dac_continuous_disable(dac_continuous_handle_t); esp_err_t dac_continuous_del_channels(dac_continuous_handle_t);
+esp_err_t dac_continuous_write(dac_continuous_handle_t, uint8_t*, size_t, size_t*, int);
@@ -0,0 +1,7 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include "esp_err.h"
+typedef enum { GPIO_NUM_NC=-1, GPIO_NUM_0=0 } gpio_num_t;
+typedef enum { GPIO_PULLUP_ONLY } gpio_pull_mode_t;
+typedef enum { GPIO_MODE_INPUT, GPIO_MODE_OUTPUT } gpio_mode_t;
+esp_err_t gpio_set_level(gpio_num_t, int); esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t); esp_err_t gpio_reset_pin(gpio_num_t);
@@ -0,0 +1,31 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+typedef struct i2s_chan* i2s_chan_handle_t;
+typedef enum {I2S_NUM_0, I2S_NUM_AUTO} i2s_port_t; typedef enum {I2S_ROLE_MASTER} i2s_role_t;
+typedef enum {I2S_CLK_SRC_DEFAULT, I2S_CLK_SRC_APLL} i2s_clock_src_t; typedef enum {I2S_MCLK_MULTIPLE_256=256} i2s_mclk_multiple_t;
+typedef enum {I2S_DATA_BIT_WIDTH_16BIT=16} i2s_data_bit_width_t; typedef enum {I2S_SLOT_MODE_MONO=1, I2S_SLOT_MODE_STEREO=2} i2s_slot_mode_t;
+typedef struct { i2s_port_t id; i2s_role_t role; uint32_t dma_desc_num; uint32_t dma_frame_num; bool auto_clear; bool auto_clear_before_cb; int intr_priority;} i2s_chan_config_t;
+#define I2S_CHANNEL_DEFAULT_CONFIG(a,b) {a,b,6,240,false,false,0}
+typedef struct { uint32_t sample_rate_hz; i2s_clock_src_t clk_src; i2s_mclk_multiple_t mclk_multiple; uint32_t bclk_div;} i2s_std_clk_config_t;
+typedef struct { int a; } i2s_std_slot_config_t;
+#define I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(a,b) {0}
+typedef struct { bool mclk_inv, bclk_inv, ws_inv;} i2s_std_gpio_inv_t;
+typedef struct { gpio_num_t mclk, bclk, ws, dout, din; i2s_std_gpio_inv_t invert_flags;} i2s_std_gpio_config_t;
+typedef struct { i2s_std_clk_config_t clk_cfg; i2s_std_slot_config_t slot_cfg; i2s_std_gpio_config_t gpio_cfg;} i2s_std_config_t;
+typedef struct { void* dma_buf; size_t size; } i2s_event_data_t;
+typedef bool (*i2s_isr_callback_t)(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+typedef struct { i2s_isr_callback_t on_recv, on_recv_q_ovf, on_sent, on_send_q_ovf; } i2s_event_callbacks_t;
+esp_err_t i2s_new_channel(const i2s_chan_config_t*, i2s_chan_handle_t*, i2s_chan_handle_t*);
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t, const i2s_std_config_t*);
+esp_err_t i2s_channel_enable(i2s_chan_handle_t); esp_err_t i2s_channel_disable(i2s_chan_handle_t);
+esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t, const i2s_std_clk_config_t*);
+esp_err_t i2s_channel_write(i2s_chan_handle_t, const void*, size_t, size_t*, uint32_t);
+esp_err_t i2s_channel_read(i2s_chan_handle_t, void*, size_t, size_t*, uint32_t);
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t, const i2s_event_callbacks_t*, void*);
+esp_err_t i2s_del_channel(i2s_chan_handle_t);
+esp_err_t i2s_channel_preload_data(i2s_chan_handle_t, const void*, size_t, size_t*);
@@ -0,0 +1,26 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#define SOC_ADC_DIGI_RESULT_BYTES 4
+#define SOC_ADC_PATT_LEN_MAX 24
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW 611
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH 83333
+typedef struct adc_continuous_ctx_t* adc_continuous_handle_t;
+typedef enum {ADC_UNIT_1, ADC_UNIT_2} adc_unit_t; typedef enum {ADC_CHANNEL_0} adc_channel_t; typedef enum {ADC_ATTEN_DB_12=3} adc_atten_t;
+typedef enum {ADC_BITWIDTH_12=12} adc_bitwidth_t; typedef enum {ADC_CONV_SINGLE_UNIT_1=1} adc_digi_convert_mode_t; typedef enum {ADC_DIGI_OUTPUT_FORMAT_TYPE2=1} adc_digi_output_format_t;
+typedef struct { union { struct { uint32_t data:12; uint32_t reserved12:1; uint32_t channel:4; uint32_t unit:1; uint32_t reserved17_31:14; } type2; uint32_t val; }; } adc_digi_output_data_t;
+typedef struct { uint32_t max_store_buf_size; uint32_t conv_frame_size; } adc_continuous_handle_cfg_t;
+typedef struct { uint8_t atten; uint8_t channel; uint8_t unit; uint8_t bit_width; } adc_digi_pattern_config_t;
+typedef struct { uint32_t pattern_num; adc_digi_pattern_config_t *adc_pattern; uint32_t sample_freq_hz; adc_digi_convert_mode_t conv_mode; adc_digi_output_format_t format; } adc_continuous_config_t;
+typedef struct { uint8_t *conv_frame_buffer; uint32_t size; } adc_continuous_evt_data_t;
+typedef bool (*adc_continuous_callback_t)(adc_continuous_handle_t, const adc_continuous_evt_data_t*, void*);
+typedef struct { adc_continuous_callback_t on_conv_done, on_pool_ovf; } adc_continuous_evt_cbs_t;
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t*, adc_continuous_handle_t*);
+esp_err_t adc_continuous_config(adc_continuous_handle_t, const adc_continuous_config_t*);
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t, const adc_continuous_evt_cbs_t*, void*);
+esp_err_t adc_continuous_start(adc_continuous_handle_t); esp_err_t adc_continuous_stop(adc_continuous_handle_t); esp_err_t adc_continuous_deinit(adc_continuous_handle_t);
+esp_err_t adc_continuous_read(adc_continuous_handle_t, uint8_t*, uint32_t, uint32_t*, uint32_t);
+esp_err_t adc_continuous_io_to_channel(int, adc_unit_t*, adc_channel_t*);
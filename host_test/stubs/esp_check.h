@@ -0,0 +1,5 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include "esp_err.h"
+#include "esp_log.h"
+#define ESP_RETURN_ON_FALSE(a, err_code, log_tag, format, ...) do { if (!(a)) { return err_code; } } while (0)
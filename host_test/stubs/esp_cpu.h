@@ -0,0 +1,5 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include <stdint.h>
+typedef uint32_t esp_cpu_cycle_count_t;
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(); // host: nanoseconds
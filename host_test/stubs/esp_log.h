@@ -0,0 +1,7 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#define ESP_LOGI(tag, ...) 
+#define ESP_LOGW(tag, ...) 
+#define ESP_LOGE(tag, ...) 
+#define ESP_LOGD(tag, ...) 
+#define ESP_LOGV(tag, ...) 
@@ -0,0 +1,4 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include <stdint.h>
+int64_t esp_timer_get_time();
@@ -0,0 +1,18 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include <stdint.h>
+#include <stddef.h>
+typedef void* QueueHandle_t; typedef void* SemaphoreHandle_t; typedef void* TaskHandle_t; typedef int BaseType_t; typedef unsigned UBaseType_t; typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(x) (x)
+#define IRAM_ATTR
+QueueHandle_t xQueueCreate(int, int); BaseType_t xQueueOverwrite(QueueHandle_t, const void*); BaseType_t xQueueSendToBack(QueueHandle_t, const void*, TickType_t); BaseType_t xQueueSend(QueueHandle_t, const void*, TickType_t);BaseType_t xQueueSendToFront(QueueHandle_t, const void*, TickType_t);
+BaseType_t xQueueReceive(QueueHandle_t, void*, TickType_t); BaseType_t xQueuePeek(QueueHandle_t, void*, TickType_t); BaseType_t xQueueReset(QueueHandle_t); UBaseType_t uxQueueMessagesWaiting(QueueHandle_t);
+BaseType_t xQueueSendFromISR(QueueHandle_t, const void*, BaseType_t*); BaseType_t xQueueReceiveFromISR(QueueHandle_t, void*, BaseType_t*);
+SemaphoreHandle_t xSemaphoreCreateMutex(); SemaphoreHandle_t xSemaphoreCreateBinary(); SemaphoreHandle_t xSemaphoreCreateCounting(int,int); BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t); BaseType_t xSemaphoreGive(SemaphoreHandle_t); BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t, BaseType_t*);
+void vTaskDelay(TickType_t); TickType_t xTaskGetTickCount();
+#define portYIELD_FROM_ISR(x)
+#define unlikely(x) (x)
@@ -0,0 +1,3 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include "FreeRTOS.h"
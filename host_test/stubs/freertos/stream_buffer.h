@@ -0,0 +1,10 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include "FreeRTOS.h"
+typedef void* StreamBufferHandle_t;
+StreamBufferHandle_t xStreamBufferCreate(size_t, size_t);
+size_t xStreamBufferSend(StreamBufferHandle_t, const void*, size_t, TickType_t);
+size_t xStreamBufferReceive(StreamBufferHandle_t, void*, size_t, TickType_t);
+BaseType_t xStreamBufferReset(StreamBufferHandle_t);
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t);
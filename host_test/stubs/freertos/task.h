@@ -0,0 +1,6 @@
+#pragma once
+// Host stub: only the declarations the host tests need
+#include "FreeRTOS.h"
+typedef void (*TaskFunction_t)(void*);
+BaseType_t xTaskCreate(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t*);
+void vTaskDelete(TaskHandle_t);
@@ -0,0 +1,2 @@
+#pragma once
+// Host stub: no Kconfig options are set
@@ -0,0 +1,196 @@
+// AudioPlayer::Synthesizer: the ADSR stages seen in the output of a sine, note onsets, pitches and the end of an RTTTL song, the
+// voice stealing order; and the CPU time of 8 voices at 44.1kHz. The songs are included into a second namespace first, like in
+// ringtones/buzzer.cc, to make sure that synth.hh still gets its own copy
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "host_test.hh"
+
+namespace BUZZER
+{
+    struct Note
+    {
+        uint16_t freq;
+        uint16_t durationMs;
+    };
+#define END_OF_SONG {0, 0}
+#include <songs.hh.inc>
+#undef END_OF_SONG
+}
+
+#include <synth.hh>
+
+using namespace AudioPlayer;
+using namespace std::chrono;
+
+static constexpr uint32_t RATE = 44100;
+
+static uint32_t Frames(uint32_t ms) { return (uint64_t)ms * RATE / 1000; }
+
+// renders until the synthesizer is silent or maxFrames have been rendered; returns the left channel
+static std::vector<int16_t> Render(Synthesizer &synth, size_t maxFrames)
+{
+    std::vector<int16_t> left;
+    int16_t buf[2 * 1152];
+    while (left.size() < maxFrames)
+    {
+        size_t n = synth.Read(buf, std::min<size_t>(1152, maxFrames - left.size()));
+        for (size_t i = 0; i < n; i++)
+            left.push_back(buf[2 * i]);
+        if (n == 0)
+            break;
+    }
+    return left;
+}
+
+// largest absolute value in [fromMs, toMs)
+static int Peak(const std::vector<int16_t> &s, uint32_t fromMs, uint32_t toMs)
+{
+    int peak{0};
+    for (size_t i = Frames(fromMs); i < std::min<size_t>(Frames(toMs), s.size()); i++)
+        peak = std::max(peak, std::abs((int)s[i]));
+    return peak;
+}
+
+// frequency from the rising zero crossings in [from, to)
+static float Frequency(const std::vector<int16_t> &s, size_t from, size_t to)
+{
+    size_t first{0}, last{0}, crossings{0};
+    for (size_t i = from + 1; i < to; i++)
+    {
+        if (s[i - 1] < 0 && s[i] >= 0)
+        {
+            if (crossings++ == 0)
+                first = i;
+            last = i;
+        }
+    }
+    return crossings < 2 ? 0 : (float)(crossings - 1) * RATE / (last - first);
+}
+
+static void TestEnvelope()
+{
+    const Instrument &in = Instruments::SINE; // attack 5ms, decay 100ms to 26000, release 60ms
+    Synthesizer synth(RATE);
+    synth.NoteOn(1000, in, GAIN_UNITY_Q15);
+    std::vector<int16_t> s = Render(synth, Frames(400));
+    const int full = 32767, sustain = in.sustainQ15;
+
+    CHECK(Peak(s, 0, 1) < full / 4, "attack: %d after 1ms", Peak(s, 0, 1));
+    CHECK(Peak(s, 2, 3) > Peak(s, 0, 1) && Peak(s, 4, 5) > Peak(s, 2, 3), "attack does not rise");
+    CHECK(Peak(s, 4, 6) > full * 95 / 100, "attack ends at %d instead of full scale", Peak(s, 4, 6));
+    CHECK(Peak(s, 50, 52) < Peak(s, 6, 8) && Peak(s, 50, 52) > sustain, "decay: %d after 50ms", Peak(s, 50, 52));
+    CHECK(std::abs(Peak(s, 110, 112) - sustain) < sustain / 50 && std::abs(Peak(s, 390, 400) - sustain) < sustain / 50,
+          "sustain: %d after 110ms, %d after 390ms instead of %d", Peak(s, 110, 112), Peak(s, 390, 400), sustain);
+    CHECK(synth.IsActive(), "not active during sustain");
+
+    // linear release of 60ms: about a half after 30ms, 1/60 in the last ms, inactive after it
+    synth.NoteOff(0);
+    std::vector<int16_t> r = Render(synth, Frames(200));
+    CHECK(std::abs(Peak(r, 29, 31) - sustain / 2) < sustain / 20, "release: %d after 30ms", Peak(r, 29, 31));
+    CHECK(r.size() <= Frames(in.releaseMs) + 1 && r.size() >= Frames(in.releaseMs), "release lasted %zu frames instead of %u", r.size(),
+          Frames(in.releaseMs));
+    CHECK(!synth.IsActive() && Peak(r, 59, 60) <= sustain / 60 + 1, "active %d, %d in the last ms of the release", synth.IsActive(), Peak(r, 59, 60));
+
+    // an instrument with sustain 0 ends after the decay without NoteOff
+    synth.NoteOn(1000, Instruments::BELL);
+    std::vector<int16_t> b = Render(synth, Frames(2000));
+    CHECK(b.size() == Frames(Instruments::BELL.attackMs) + Frames(Instruments::BELL.decayMs), "bell lasted %zu frames", b.size());
+}
+
+static void TestSong()
+{
+    // POSITIVE: 262Hz, 330Hz, 392Hz for 188ms each, 523Hz for 750ms; every note is released NOTE_GAP_MS before the next one
+    const Note *song = Ringtones::POSITIVE;
+    CHECK(BUZZER::POSITIVE[3].freq == song[3].freq, "the copies of the songs differ");
+    Synthesizer synth(RATE);
+    CHECK(synth.PlayRingtone(Ringtones::RINGTONE_SONG::POSITIVE, Instruments::SINE), "PlayRingtone failed");
+    std::vector<int16_t> s = Render(synth, Frames(3000));
+
+    const uint32_t gap = Frames(Synthesizer::NOTE_GAP_MS), window = Frames(2);
+    size_t onset{0};
+    for (const Note *n = song; n->durationMs; n++)
+    {
+        const size_t frames = Frames(n->durationMs);
+        const float f = Frequency(s, onset + Frames(10), onset + frames - gap);
+        CHECK(std::fabs(f - n->freq) < n->freq * 0.005f, "note at %zu: %.1fHz instead of %u", onset, f, n->freq);
+        // held until the note off, then falling
+        auto peak = [&](size_t from) {
+            int p{0};
+            for (size_t i = from; i < std::min(from + window, s.size()); i++)
+                p = std::max(p, std::abs((int)s[i]));
+            return p;
+        };
+        const int held = peak(onset + frames - gap - window), released = peak(onset + frames - window);
+        CHECK(held > Instruments::SINE.sustainQ15 / 4 * 95 / 100, "note at %zu: %d before the note off", onset, held);
+        CHECK(released < held * 3 / 4, "note at %zu not released before the next one (%d, then %d)", onset, held, released);
+        onset += frames;
+    }
+    // the last note is released NOTE_GAP_MS before its end, the song ends with its release
+    const size_t expected = onset - gap + Frames(Instruments::SINE.releaseMs);
+    CHECK(s.size() == expected, "song lasted %zu frames instead of %zu", s.size(), expected);
+    CHECK(!synth.IsActive(), "active after the end of the song");
+}
+
+static void TestStealing()
+{
+    Synthesizer synth(RATE);
+    int16_t buf[2 * 1152];
+    for (int i = 0; i < (int)Synthesizer::VOICES; i++)
+    {
+        int v = synth.NoteOn(200 + 100 * i, i == 5 ? Instruments::EPIANO : Instruments::SINE); // EPIANO sustains at 8000
+        CHECK(v == i, "NoteOn %d got voice %d instead of a free one", i, v);
+    }
+    for (int i = 0; i < 40; i++)
+        synth.Read(buf, 1152); // all voices in sustain
+    synth.NoteOff(3);
+    CHECK(synth.NoteOn(1000, Instruments::EPIANO) == 3, "a released voice is not stolen first");
+    for (int i = 0; i < 40; i++)
+        synth.Read(buf, 1152);
+    // 3 and 5 are the quietest (EPIANO), 5 is older
+    CHECK(synth.NoteOn(1000, Instruments::SINE) == 5, "the older of the quietest voices is not stolen");
+    for (int i = 0; i < 40; i++)
+        synth.Read(buf, 1152);
+    CHECK(synth.NoteOn(1000, Instruments::SINE) == 3, "the quietest voice is not stolen");
+    // all at the sustain level of SINE now, 0 is the oldest
+    for (int i = 0; i < 40; i++)
+        synth.Read(buf, 1152);
+    CHECK(synth.NoteOn(1000, Instruments::SINE) == 0, "the oldest voice is not stolen");
+
+    synth.AllNotesOff();
+    while (synth.Read(buf, 1152) > 0)
+        ;
+    CHECK(synth.NoteOn(1000) == 0, "voice 0 not free after AllNotesOff");
+}
+
+static void Bench()
+{
+    // 8 FM voices held in sustain, 10s in blocks of 1152 frames, like the player
+    Synthesizer synth(RATE);
+    for (size_t i = 0; i < Synthesizer::VOICES; i++)
+        synth.NoteOn(220.0f * (i + 1), Instruments::EPIANO);
+    int16_t buf[2 * 1152];
+    synth.Read(buf, 1152);
+    synth.ResetStatistics();
+    auto t0 = steady_clock::now();
+    size_t frames{0};
+    while (frames < 10 * RATE)
+        frames += synth.Read(buf, 1152);
+    const double wallNs = duration<double, std::nano>(steady_clock::now() - t0).count();
+    SynthStatistics st = synth.GetStatistics();
+    CHECK(st.frames == frames && st.voiceFrames == Synthesizer::VOICES * frames, "statistics: %u frames, %u voice frames", st.frames, st.voiceFrames);
+    // the fake cycle counter of the host counts nanoseconds
+    printf("%zu voices at %uHz: %.0f cycles (host ns) per frame, %.2fns per voice-sample, %.0fx realtime\n", Synthesizer::VOICES, RATE,
+           (double)st.cycles / st.frames, (double)st.cycles / st.voiceFrames, frames * 1e9 / RATE / wallNs);
+}
+
+int main()
+{
+    TestEnvelope();
+    TestSong();
+    TestStealing();
+    Bench();
+    return HostTestResult("synth_test");
+}
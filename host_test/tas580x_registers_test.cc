@@ -0,0 +1,268 @@
+// TAS580x::M::transmitRegisters against a fake device, that models book/page selection, auto-increment and reset: the default
+// table leaves the same register image as one write per entry, runs within a page are coalesced into one write, redundant book/page
+// selections are skipped, the tracking ends on the page the device is on, META_BURST writes value-1 data bytes; and a resume after
+// a brown out restores the loaded presets
+#include <map>
+#include <tuple>
+#include <vector>
+#include "host_test.hh"
+#include <esp_log.h>
+#include <common-esp32.hh>
+#include <driver/i2s_std.h>
+#include <tas580x.hh>
+
+using namespace TAS580x;
+
+// the I2S output and the power down pin are not used here
+esp_err_t gpio_set_level(gpio_num_t, int) { return ESP_OK; }
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t) { return ESP_OK; }
+esp_err_t gpio_reset_pin(gpio_num_t) { return ESP_OK; }
+esp_err_t i2s_new_channel(const i2s_chan_config_t *, i2s_chan_handle_t *, i2s_chan_handle_t *) { return ESP_OK; }
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t, const i2s_std_config_t *) { return ESP_OK; }
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t, const i2s_event_callbacks_t *, void *) { return ESP_OK; }
+esp_err_t i2s_channel_enable(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_disable(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t, const i2s_std_clk_config_t *) { return ESP_OK; }
+esp_err_t i2s_del_channel(i2s_chan_handle_t) { return ESP_OK; }
+esp_err_t i2s_channel_write(i2s_chan_handle_t, const void *, size_t size, size_t *written, uint32_t)
+{
+    *written = size;
+    return ESP_OK;
+}
+
+class FakeTas : public i2c::iI2CDevice
+{
+public:
+    struct Write
+    {
+        int book, page;
+        uint8_t reg;
+        size_t len;
+        uint8_t value{0}; // first byte, not compared
+        bool operator==(const Write &o) const { return book == o.book && page == o.page && reg == o.reg && len == o.len; }
+    };
+    int book{0}, page{0};
+    std::map<std::tuple<int, int, int>, uint8_t> mem;
+    std::vector<Write> writes;
+
+    void Set(uint8_t reg, uint8_t value)
+    {
+        if (reg == R::SELECT_PAGE)
+            page = value;
+        else if (reg == R::SELECT_BOOK && page == 0)
+            book = value;
+        else if (reg == R::RESET_CTRL && book == 0 && page == 0 && (value & 0x11))
+            mem.clear(); // book and page stay 0
+        else
+            mem[{book, page, reg}] = value;
+        if (book == 0 && page == 0 && reg == R::DEVICE_CTRL_2)
+            mem[{0, 0, R::POWER_STATE}] = value & 0x03; // reached at once
+    }
+    ErrorCode WriteRegister(const uint8_t reg, const uint8_t *const data, const size_t len) override
+    {
+        writes.push_back({book, page, reg, len, len ? data[0] : (uint8_t)0});
+        for (size_t i = 0; i < len; i++)
+            Set(reg + i, data[i]);
+        return ErrorCode::OK;
+    }
+    ErrorCode WriteRegisterU8(const uint8_t reg, const uint8_t data) override { return WriteRegister(reg, &data, 1); }
+    ErrorCode ReadRegister(const uint8_t reg, uint8_t *data, size_t len) override
+    {
+        for (size_t i = 0; i < len; i++)
+            data[i] = mem[{book, page, reg + (int)i}];
+        return ErrorCode::OK;
+    }
+    ErrorCode ReadRegisterAddress16(const uint16_t, uint8_t *, size_t) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode ReadRegisterU16BE(const uint8_t, uint16_t *) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode ReadRegisterU32BE(const uint8_t, uint32_t *) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode ReadRaw(uint8_t *, size_t) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode WriteRegisterU16BE(const uint8_t, const uint16_t) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode WriteRegisterU32BE(const uint8_t, const uint32_t) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode WriteRaw(const uint8_t *const, const size_t) override { return ErrorCode::FUNCTION_NOT_AVAILABLE; }
+    ErrorCode Probe() override { return ErrorCode::OK; }
+};
+
+class FakeBus : public i2c::iI2CBus
+{
+public:
+    FakeTas device;
+    ErrorCode CreateDevice(const uint8_t, i2c::iI2CDevice **dev) override
+    {
+        *dev = &device;
+        return ErrorCode::OK;
+    }
+    i2c::iI2CDevice *GetGeneralCallDevice() override { return nullptr; }
+    ErrorCode ProbeAddress(const uint8_t) override { return ErrorCode::OK; }
+    ErrorCode Scan(FILE *, const char *) override { return ErrorCode::OK; }
+};
+
+class TestTas : public M
+{
+public:
+    TestTas(FakeBus *bus) : M(bus, ADDR7bit::DVDD_15k, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC) {}
+    using M::SwitchToBookAndPage;
+    using M::transmitRegisters;
+};
+
+using Table = std::vector<CFG::tas5805m_cfg_reg_t>;
+using Writes = std::vector<FakeTas::Write>;
+
+static void TestDefaultTable()
+{
+    const Table table(std::begin(CFG::tas5805m_registers), std::end(CFG::tas5805m_registers));
+    FakeTas reference;
+    for (const auto &e : table)
+    {
+        if (e.offset != CFG::META_DELAY && e.offset != CFG::META_SWITCH)
+            reference.WriteRegisterU8(e.offset, e.value);
+    }
+    FakeBus bus;
+    TestTas tas(&bus);
+    CHECK(tas.transmitRegisters(table.data(), table.size()) == ErrorCode::OK, "transmitRegisters failed");
+    CHECK(bus.device.mem == reference.mem, "register image differs from one write per entry");
+    CHECK(bus.device.writes.size() < reference.writes.size() / 10, "%zu transactions for %zu entries", bus.device.writes.size(), table.size());
+    printf("default table: %zu entries, %zu transactions (one per entry: %zu)\n", table.size(), bus.device.writes.size(), reference.writes.size());
+
+    // the tracked book/page is the one of the device: the switch back to book 0, page 0 has to arrive there
+    tas.SwitchToBookAndPage(0, 0);
+    CHECK(bus.device.book == 0 && bus.device.page == 0, "device on book %02X page %02X after the switch to 0/0", bus.device.book, bus.device.page);
+}
+
+static void TestCoalescing()
+{
+    FakeBus bus;
+    TestTas tas(&bus);
+    Table table{{0x00, 0x00}, {0x7f, 0x8c}, {0x00, 0x2a}};
+    for (uint8_t reg = 0x24; reg < 0x34; reg++)
+        table.push_back({reg, reg});
+    table.push_back({0x40, 0x01}); // gap: a write of its own
+    tas.transmitRegisters(table.data(), table.size());
+    Writes expected{{0, 0, 0x00, 1}, {0, 0, 0x7f, 1}, {0x8c, 0, 0x00, 1}, {0x8c, 0x2a, 0x24, 16}, {0x8c, 0x2a, 0x40, 1}};
+    CHECK(bus.device.writes == expected, "first run: write sequence differs (%zu writes, expected %zu)", bus.device.writes.size(), expected.size());
+
+    // again: page 0 has to be selected for the book register, the book itself is already selected
+    bus.device.writes.clear();
+    tas.transmitRegisters(table.data(), table.size());
+    expected = {{0x8c, 0x2a, 0x00, 1}, {0x8c, 0, 0x00, 1}, {0x8c, 0x2a, 0x24, 16}, {0x8c, 0x2a, 0x40, 1}};
+    CHECK(bus.device.writes == expected, "second run: write sequence differs (%zu writes, expected %zu)", bus.device.writes.size(), expected.size());
+
+    // a whole page: 0x7f is a coefficient outside of page 0
+    bus.device.writes.clear();
+    table.clear();
+    for (int reg = 0x08; reg <= 0x7f; reg++)
+        table.push_back({(uint8_t)reg, (uint8_t)reg});
+    tas.transmitRegisters(table.data(), table.size());
+    expected = {{0x8c, 0x2a, 0x08, 120}};
+    CHECK(bus.device.writes == expected && bus.device.book == 0x8c, "page 0x2a from 0x08 to 0x7f not written as one burst");
+}
+
+static void TestMetaBurst()
+{
+    FakeBus bus;
+    TestTas tas(&bus);
+    // 5 bytes: register 0x24 and 4 data bytes, then a normal entry
+    const Table table{{0x00, 0x00}, {0x7f, 0x00}, {0x00, 0x01}, {CFG::META_BURST, 5}, {0x24, 0x11}, {0x22, 0x33}, {0x44, 0x00}, {0x30, 0x55}};
+    tas.transmitRegisters(table.data(), table.size());
+    const Writes expected{{0, 0, 0x00, 1}, {0, 0, 0x7f, 1}, {0, 0, 0x00, 1}, {0, 1, 0x24, 4}, {0, 1, 0x30, 1}};
+    CHECK(bus.device.writes == expected, "write sequence differs (%zu writes, expected %zu)", bus.device.writes.size(), expected.size());
+    auto page1 = [&](int reg) { return bus.device.mem.count(std::make_tuple(0, 1, reg)) ? bus.device.mem[std::make_tuple(0, 1, reg)] : -1; };
+    const int data[] = {0x11, 0x22, 0x33, 0x44};
+    for (int i = 0; i < 4; i++)
+        CHECK(page1(0x24 + i) == data[i], "register %02X is %d", 0x24 + i, page1(0x24 + i));
+    CHECK(page1(0x28) == -1 && page1(0x30) == 0x55, "bytes after the burst written");
+}
+
+static void TestTracking()
+{
+    FakeBus bus;
+    TestTas tas(&bus);
+    // after a reset the device is on book 0, page 0, but the driver does not rely on that
+    const Table reset{{0x00, 0x00}, {0x7f, 0x00}, {0x00, 0x00}, {0x01, 0x11}};
+    tas.transmitRegisters(reset.data(), reset.size());
+    bus.device.writes.clear();
+    tas.SwitchToBookAndPage(0, 0);
+    CHECK(bus.device.writes.size() == 2, "%zu writes for the switch after a reset", bus.device.writes.size());
+    bus.device.writes.clear();
+    tas.SwitchToBookAndPage(0, 0);
+    CHECK(bus.device.writes.empty(), "redundant switch sent %zu writes", bus.device.writes.size());
+
+    // a book selection on an unknown page leaves the book unknown
+    FakeBus bus2;
+    TestTas tas2(&bus2);
+    const Table book{{0x7f, 0x8c}};
+    tas2.transmitRegisters(book.data(), book.size());
+    bus2.device.writes.clear();
+    tas2.SwitchToBookAndPage(0x8c, 0x2a);
+    const Writes expected{{0x8c, 0, 0x00, 1}, {0x8c, 0, 0x7f, 1}, {0x8c, 0, 0x00, 1}};
+    CHECK(bus2.device.writes == expected, "%zu writes for the switch after a book selection on an unknown page", bus2.device.writes.size());
+}
+
+static void TestResumeRestoresPresets()
+{
+    static const CFG::tas5805m_cfg_reg_t MUSIC_EQ[] = {{0x00, 0x00}, {0x7f, 0x8c}, {0x00, 0x2a}, {0x24, 0x5a}, {0x25, 0xa5}, {0x26, 0x5a}, {0x27, 0xa5}};
+    const DspPreset presets[] = {{"music", PresetKind::EQ, MUSIC_EQ, sizeof(MUSIC_EQ) / sizeof(MUSIC_EQ[0])}};
+    FakeBus bus;
+    TestTas tas(&bus);
+    CHECK(tas.Init() == ErrorCode::OK, "Init failed");
+    CHECK(tas.LoadDspPresets(presets, 1, "music") == ErrorCode::OK, "LoadDspPresets failed");
+    CHECK(tas.Suspend() == ErrorCode::OK, "Suspend failed");
+    bus.device.mem.clear(); // brown out: everything back to the reset values
+    bus.device.book = bus.device.page = 0;
+    CHECK(tas.Resume() == ErrorCode::OK, "Resume failed");
+    int wrong{0};
+    for (size_t i = 3; i < presets[0].count; i++)
+        wrong += bus.device.mem[std::make_tuple(0x8c, 0x2a, (int)MUSIC_EQ[i].offset)] != MUSIC_EQ[i].value;
+    CHECK(wrong == 0, "%d preset coefficients lost after the resume", wrong);
+    const char *active = tas.GetActivePreset(PresetKind::EQ);
+    CHECK(active && strcmp(active, "music") == 0, "active EQ preset after the resume: %s", active ? active : "none");
+    CHECK(bus.device.mem[std::make_tuple(0, 0, (int)R::POWER_STATE)] == (uint8_t)CTRL_STATE::PLAY, "not playing after the resume");
+}
+
+// by default, the device is soft muted before the first coefficient page and unmuted after the last one; without mute, DEVICE_CTRL_2
+// is not touched
+static void TestPresetMute()
+{
+    static const CFG::tas5805m_cfg_reg_t EQ_A[] = {{0x00, 0x00}, {0x7f, 0x8c}, {0x00, 0x2a}, {0x24, 0x11}, {0x25, 0x22}};
+    static const CFG::tas5805m_cfg_reg_t EQ_B[] = {{0x00, 0x00}, {0x7f, 0x8c}, {0x00, 0x2a}, {0x24, 0x33}, {0x25, 0x44}};
+    const DspPreset presets[] = {{"a", PresetKind::EQ, EQ_A, 5}, {"b", PresetKind::EQ, EQ_B, 5}};
+    FakeBus bus;
+    TestTas tas(&bus);
+    CHECK(tas.Init() == ErrorCode::OK, "Init failed");
+
+    // index of the first write matching, -1 if none
+    auto find = [&](auto match) {
+        const Writes &w = bus.device.writes;
+        for (size_t i = 0; i < w.size(); i++)
+            if (match(w[i]))
+                return (int)i;
+        return -1;
+    };
+    auto coefficients = [](const FakeTas::Write &w) { return w.book == 0x8c && w.page == 0x2a && w.reg == 0x24; };
+    auto mute = [](const FakeTas::Write &w) { return w.book == 0 && w.page == 0 && w.reg == R::DEVICE_CTRL_2 && (w.value & 0x08); };
+    auto unmute = [](const FakeTas::Write &w) { return w.book == 0 && w.page == 0 && w.reg == R::DEVICE_CTRL_2 && !(w.value & 0x08); };
+
+    bus.device.writes.clear();
+    CHECK(tas.LoadDspPresets(presets, 2, "a") == ErrorCode::OK, "LoadDspPresets failed");
+    const int m = find(mute), c = find(coefficients), u = find(unmute);
+    CHECK(m >= 0 && c > m && u > c, "default load: mute at %d, coefficients at %d, unmute at %d", m, c, u);
+
+    bus.device.writes.clear();
+    CHECK(tas.LoadDspPresets(presets, 2, "b", false) == ErrorCode::OK, "LoadDspPresets without mute failed");
+    CHECK(find(coefficients) >= 0 && find(mute) < 0 && find(unmute) < 0, "load without mute: coefficients at %d, mute at %d",
+          find(coefficients), find(mute));
+
+    bus.device.writes.clear();
+    CHECK(tas.LoadDspPresets(presets, 2, "b") == ErrorCode::OK, "reloading the active preset failed");
+    CHECK(bus.device.writes.empty() || find(mute) < 0, "reloading the active preset muted the output");
+}
+
+int main()
+{
+    TestDefaultTable();
+    TestCoalescing();
+    TestMetaBurst();
+    TestTracking();
+    TestResumeRestoresPresets();
+    TestPresetMute();
+    return HostTestResult("tas580x_registers_test");
+}
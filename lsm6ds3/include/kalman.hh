@@ -15,6 +15,7 @@
  Web      :  http://www.tkjelectronics.com
  e-mail   :  kristianl@tkjelectronics.com
  */
+#include <cstddef>
 
 namespace filter
 {
@@ -101,4 +102,116 @@ namespace filter
         float getQbias() { return this->Q_bias; };
         float getRmeasure() { return this->R_measure; };
     };
+
+    // Structure-of-arrays variant of Kalman for N independent axes that are sampled with a common, fixed period.
+    // All per-axis state lives in contiguous float arrays, so the update loop has no data dependencies between
+    // axes and can be unrolled/vectorized by the compiler. The dt dependent terms are computed once in setDt.
+    template <size_t N>
+    class KalmanN
+    {
+    private:
+        float Q_angle[N];
+        float Q_bias[N];
+        float R_measure[N];
+
+        float angle[N];
+        float bias[N];
+        float rate[N];
+
+        float P00[N];
+        float P01[N];
+        float P10[N];
+        float P11[N];
+
+        float dt{0.0f};
+        float dtQ_angle[N]; // dt*Q_angle
+        float dtQ_bias[N];  // dt*Q_bias
+
+    public:
+        KalmanN(float dt)
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                Q_angle[i] = 0.001f;
+                Q_bias[i] = 0.003f;
+                R_measure[i] = 0.03f;
+                angle[i] = bias[i] = rate[i] = 0.0f;
+                P00[i] = P01[i] = P10[i] = P11[i] = 0.0f;
+            }
+            setDt(dt);
+        }
+
+        void setDt(float dt)
+        {
+            this->dt = dt;
+            for (size_t i = 0; i < N; i++)
+            {
+                dtQ_angle[i] = dt * Q_angle[i];
+                dtQ_bias[i] = dt * Q_bias[i];
+            }
+        }
+
+        // Same algorithm as Kalman::getAngle for all axes. newAngle, newRate and outAngle point to N floats each;
+        // outAngle may be nullptr
+        void update(const float *__restrict newAngle, const float *__restrict newRate, float *__restrict outAngle)
+        {
+            const float dt = this->dt;
+            const float dt2 = dt * dt;
+            for (size_t i = 0; i < N; i++)
+            {
+                /* Step 1 */
+                const float r = newRate[i] - bias[i];
+                float a = angle[i] + dt * r;
+
+                /* Step 2 */
+                const float p11 = P11[i];
+                float p00 = P00[i] + dt2 * p11 - dt * (P01[i] + P10[i]) + dtQ_angle[i];
+                float p01 = P01[i] - dt * p11;
+                float p10 = P10[i] - dt * p11;
+                float q11 = p11 + dtQ_bias[i];
+
+                /* Step 4+5 */
+                const float invS = 1.0f / (p00 + R_measure[i]);
+                const float k0 = p00 * invS;
+                const float k1 = p10 * invS;
+
+                /* Step 3+6 */
+                const float y = newAngle[i] - a;
+                a += k0 * y;
+                bias[i] += k1 * y;
+
+                /* Step 7 */
+                P00[i] = p00 - k0 * p00;
+                P01[i] = p01 - k0 * p01;
+                P10[i] = p10 - k1 * p00;
+                P11[i] = q11 - k1 * p01;
+
+                angle[i] = a;
+                rate[i] = r;
+            }
+            if (outAngle)
+            {
+                for (size_t i = 0; i < N; i++)
+                    outAngle[i] = angle[i];
+            }
+        }
+
+        // Processes count consecutive samples. newAngle and newRate hold count blocks of N floats (sample-major)
+        void updateBatch(const float *newAngle, const float *newRate, size_t count, float *outAngle)
+        {
+            for (size_t s = 0; s < count; s++)
+            {
+                update(newAngle + s * N, newRate + s * N, outAngle ? outAngle + s * N : nullptr);
+            }
+        }
+
+        void setAngle(size_t axis, float angle) { this->angle[axis] = angle; }
+        float getAngle(size_t axis) { return this->angle[axis]; }
+        float getRate(size_t axis) { return this->rate[axis]; }
+
+        /* These are used to tune the Kalman filter */
+        void setQangle(size_t axis, float Q_angle) { this->Q_angle[axis] = Q_angle; setDt(dt); };
+        void setQbias(size_t axis, float Q_bias) { this->Q_bias[axis] = Q_bias; setDt(dt); };
+        void setRmeasure(size_t axis, float R_measure) { this->R_measure[axis] = R_measure; };
+    };
 }
\ No newline at end of file
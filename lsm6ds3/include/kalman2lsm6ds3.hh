@@ -1,52 +1,98 @@
 #pragma once
 
-#include <cstring>
-#include <math.h>
-
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include <cstddef>
+#include <cmath>
 
 #include "esp_timer.h"
-#include "esp_log.h"
 
 #include "lsm6ds3.hh"
 #include "kalman.hh"
 
 #define RESTRICT_PITCH // Comment out to restrict roll to ±90deg instead
-#define RAD_TO_DEG (180.0 / M_PI)
-#define DEG_TO_RAD 0.0174533
 
 namespace imu_kalmanXY
 {
+    constexpr float RAD_TO_DEG_F{57.2957795f};
+    constexpr float PI_F{3.14159265f};
+    constexpr float PI_2_F{1.57079633f};
+
+    // atan for |x|<=1, minimax polynomial, max error approx. 1e-5rad
+    inline float atanUnitf(float x)
+    {
+        const float x2 = x * x;
+        return x * (0.99997726f + x2 * (-0.33262347f + x2 * (0.19354346f + x2 * (-0.11643287f + x2 * (0.05265332f + x2 * -0.01172120f)))));
+    }
+
+    // float-only replacement for atan2, no libm call, result in radians
+    inline float fastAtan2f(float y, float x)
+    {
+        const float ax = fabsf(x);
+        const float ay = fabsf(y);
+        if (ax == 0.0f && ay == 0.0f)
+            return 0.0f;
+        float r;
+        if (ay <= ax)
+        {
+            r = atanUnitf(ay / ax);
+        }
+        else
+        {
+            r = PI_2_F - atanUnitf(ax / ay);
+        }
+        if (x < 0.0f)
+            r = PI_F - r;
+        return y < 0.0f ? -r : r;
+    }
+
     class M
     {
     private:
-        Kalman kalmanX; // Create the Kalman instances
-        Kalman kalmanY;
+        filter::Kalman kalmanX; // Create the Kalman instances
+        filter::Kalman kalmanY;
         int64_t lastTime{0};
 
-        double roll, pitch;          // Roll and pitch are calculated using the accelerometer
-        double kalAngleX, kalAngleY; // Calculated angle using a Kalman filter
+        float roll, pitch;          // Roll and pitch are calculated using the accelerometer
+        float kalAngleX, kalAngleY; // Calculated angle using a Kalman filter
+
+        void update(const float *acc, const float *gyro, float dt)
+        {
+            getRollPitch(acc, &roll, &pitch);
+
+            /* Roll and pitch estimation */
+            float gyroXrate = gyro[0];
+            float gyroYrate = gyro[1];
+
+            // This fixes the transition problem when the accelerometer angle jumps between -180 and 180 degrees
+            if ((roll < -90.0f && kalAngleX > 90.0f) || (roll > 90.0f && kalAngleX < -90.0f))
+            {
+                kalmanX.setAngle(roll);
+                kalAngleX = roll;
+            }
+            else
+                kalAngleX = kalmanX.getAngle(roll, gyroXrate, dt); // Calculate the angle using a Kalman filter
+
+            if (fabsf(kalAngleX) > 90.0f)
+                gyroYrate = -gyroYrate; // Invert rate, so it fits the restriced accelerometer reading
+            kalAngleY = kalmanY.getAngle(pitch, gyroYrate, dt);
+        }
+
     public:
-        void getRollPitch(const float *acc, double *roll, double *pitch)
+        static void getRollPitch(const float *acc, float *roll, float *pitch)
         {
-            // atan2 outputs the value of - to	(radians) - see http://en.wikipedia.org/wiki/Atan2
+            // atan2 outputs the value of -pi to pi (radians) - see http://en.wikipedia.org/wiki/Atan2
             // It is then converted from radians to degrees
 #ifdef RESTRICT_PITCH // Eq. 25 and 26
-            *roll = atan2(acc[1], acc[2]) * RAD_TO_DEG;
-            *pitch = atan(-acc[0] / sqrt(acc[1] * acc[1] + acc[2] * acc[2])) * RAD_TO_DEG;
+            *roll = fastAtan2f(acc[1], acc[2]) * RAD_TO_DEG_F;
+            *pitch = fastAtan2f(-acc[0], sqrtf(acc[1] * acc[1] + acc[2] * acc[2])) * RAD_TO_DEG_F;
 #else // Eq. 28 and 29
-            *roll = atan(accY / sqrt(accX * accX + accZ * accZ)) * RAD_TO_DEG;
-            *pitch = atan2(-accX, accZ) * RAD_TO_DEG;
+            *roll = fastAtan2f(acc[1], sqrtf(acc[0] * acc[0] + acc[2] * acc[2])) * RAD_TO_DEG_F;
+            *pitch = fastAtan2f(-acc[0], acc[2]) * RAD_TO_DEG_F;
 #endif
         }
 
-        void processSetup(lsm6ds3::M *imu)
+        void processSetup(const float *acc)
         {
-
-            const float *acc = imu->GetAccXYZ();
-            const float *gyro = imu->GetGyroXYZ();
-            getRollPitch(accXYZ, &roll, &pitch);
+            getRollPitch(acc, &roll, &pitch);
             kalAngleX = roll;
             kalAngleY = pitch;
             kalmanX.setAngle(roll); // Set starting angle
@@ -54,32 +100,33 @@ namespace imu_kalmanXY
             lastTime = esp_timer_get_time();
         }
 
+        void processSetup(lsm6ds3::M *imu)
+        {
+            processSetup(imu->GetAccXYZ());
+        }
+
         void processLoop(lsm6ds3::M *imu)
         {
-            const float *acc = imu->GetAccXYZ();
-            const float *gyro = imu->GetGyroXYZ();
-            getRollPitch(accXYZ, &roll, &pitch);
             int64_t now = esp_timer_get_time();
-
-            double dt = (double)(now - lastTime) / 1000000; // Calculate delta time
+            float dt = (float)(now - lastTime) * 1e-6f; // Calculate delta time
             lastTime = now;
+            update(imu->GetAccXYZ(), imu->GetGyroXYZ(), dt);
+        }
 
-            /* Roll and pitch estimation */
-            double gyroXrate = gyro[0];
-            double gyroYrate = gyro[1];
-
-            // This fixes the transition problem when the accelerometer angle jumps between -180 and 180 degrees
-            if ((roll < -90 && kalAngleX > 90) || (roll > 90 && kalAngleX < -90))
+        // Processes count samples, e.g. read out of the sensor FIFO, that have been sampled with a fixed period dt (in seconds).
+        // acc and gyro are interleaved xyz vectors (3*count floats each)
+        void processBatch(const float *acc, const float *gyro, size_t count, float dt)
+        {
+            for (size_t i = 0; i < count; i++)
             {
-                kalmanX.setAngle(roll);
-                kalAngleX = roll;
+                update(acc + 3 * i, gyro + 3 * i, dt);
             }
-            else
-                kalAngleX = kalmanX.getAngle(roll, gyroXrate, dt); // Calculate the angle using a Kalman filter
-
-            if (abs(kalAngleX) > 90)
-                gyroYrate = -gyroYrate; // Invert rate, so it fits the restriced accelerometer reading
-            kalAngleY = kalmanY.getAngle(pitch, gyroYrate, dt);
+            lastTime = esp_timer_get_time();
         }
-    }
-}
\ No newline at end of file
+
+        float getKalAngleX() { return kalAngleX; }
+        float getKalAngleY() { return kalAngleY; }
+        float getRoll() { return roll; }
+        float getPitch() { return pitch; }
+    };
+}
@@ -18,30 +18,34 @@ namespace MAX98357
         VDD_through_100k_3dB=3,
 	};
 
+	// The volume is applied digitally in the sample path (0.25dB steps, ramped); the gain pin only sets the maximum level (headroom)
 	class M:public CodecManager::aI2sCodecManager
 	{
 	private:
         gpio_num_t gain_pin;
 		gpio_num_t shutdown_pin;
-        uint8_t volumeSpeakers = 127;
+        uint8_t volumeSpeakers = 255;
+        eGain maxGain;
 
 	public:
 		M(
             gpio_num_t gain_pin, 
             gpio_num_t shutdown_pin, 
-            uint8_t initialVolume = 127,
-            uint32_t initialSampleRateHz = 44100) :
+            uint8_t initialVolume = 255,
+            uint32_t initialSampleRateHz = 44100,
+            eGain maxGain = eGain::GND_12dB) :
             CodecManager::aI2sCodecManager(initialSampleRateHz, CodecManager::eChannels::ONE, CodecManager::eSampleBits::SIXTEEN),
             gain_pin(gain_pin), 
             shutdown_pin(shutdown_pin),
-            volumeSpeakers(initialVolume)
+            volumeSpeakers(initialVolume),
+            maxGain(maxGain)
 		{
 		}
 
+        // 255 is the level set by maxGain, every step below attenuates by 0.25dB, 0 mutes
         ErrorCode SetVolume(uint8_t volume) override{
-            if(volume>160) SetAnalogGain(eGain::GND_12dB);
-            else if(volume>80) SetAnalogGain(eGain::OPEN_9db);
-            else SetAnalogGain(eGain::VDD_6dB);
+            volumeSpeakers = volume;
+            SetDigitalVolume(volume);
             return ErrorCode::OK;
         }
 		
@@ -88,7 +92,8 @@ namespace MAX98357
                 gpio_set_level(shutdown_pin, 1);
                 gpio_set_direction(shutdown_pin, GPIO_MODE_OUTPUT);
             }
-			SetAnalogGain(eGain::GND_12dB);
+			SetAnalogGain(maxGain);
+			SetDigitalVolume(volumeSpeakers, false);
 			return ErrorCode::OK;
 		}
 	};
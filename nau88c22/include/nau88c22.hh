@@ -4,6 +4,7 @@
 #include <cmath>
 #include <cstring>
 #include <bit>
+#include <bitset>
 #include <algorithm>
 #include <sdkconfig.h>
 #include <freertos/FreeRTOS.h>
@@ -28,20 +29,45 @@ namespace nau88c22
     };
 
     constexpr uint8_t NAU8822_I2C_ADDRESS{0X1A};
+    // size of the read buffer of applications, that read the capture themselves; the driver's latency is set via SetDmaBuffering
     constexpr size_t AUDIO_BUFFER_SIZE_IN_SAMPLES{2048};
     constexpr size_t TARGET_CHANNELS{2};
 
+    constexpr uint8_t REGISTER_COUNT{0x50};
+    // power-on defaults of the datasheet, i.e. the register contents after a software reset. 0 is the reset register itself
+    constexpr uint16_t REGISTER_DEFAULTS[REGISTER_COUNT]{
+        0x000, 0x000, 0x000, 0x000, 0x050, 0x000, 0x140, 0x000, // 0x00: reset, power 1-3, audio interface, companding, clock, additional
+        0x000, 0x000, 0x000, 0x0FF, 0x0FF, 0x000, 0x100, 0x0FF, // 0x08: GPIO, jack detect 1, DAC control, DAC volume L/R, jack detect 2, ADC control, ADC volume L
+        0x0FF, 0x000, 0x12C, 0x02C, 0x02C, 0x02C, 0x02C, 0x000, // 0x10: ADC volume R, -, EQ1-5, -
+        0x032, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, // 0x18: DAC limiter 1/2, -, notch filter 1-4, -
+        0x038, 0x00B, 0x032, 0x010, 0x008, 0x00C, 0x093, 0x0E9, // 0x20: ALC 1-3, noise gate, PLL N, K1-3
+        0x000, 0x000, 0x000, 0x000, 0x033, 0x010, 0x010, 0x100, // 0x28: -, 3D, -, right speaker submixer, input control, PGA L/R, ADC boost L
+        0x100, 0x002, 0x001, 0x001, 0x039, 0x039, 0x039, 0x039, // 0x30: ADC boost R, output control, mixer L/R, headphone L/R, speaker L/R
+        0x001, 0x001, 0x000, 0x000, 0x020, 0x000, 0x07F, 0x01A, // 0x38: AUX2/AUX1 mixer, power 4, time slot L, misc, time slot R, revision, device id
+        0x000, 0x114, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, // 0x40: -, DAC dither, -, ...
+        0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, // 0x48: ALC enhancements, misc controls, output tie-off
+    };
+
     class M : public CodecManager::aI2sCodecManager
     {
     private:
         i2c_master_bus_handle_t bus_handle;
-        i2c_master_dev_handle_t dev_handle;
+        i2c_master_dev_handle_t dev_handle{nullptr};
         gpio_num_t power_down;
         gpio_num_t mclk;
         gpio_num_t bck;
         gpio_num_t ws;
         gpio_num_t data;
+        gpio_num_t dataIn;
         uint8_t volumeSpeakers = 127;
+        uint8_t micGain = 0x10;
+        // Shadow of all registers: the driver never has to read the codec. Changes are collected with setRegister/setBits and
+        // written with flush, each changed register exactly once, in ascending order. The order matters for the left/right volume
+        // pairs: the right register carries the update bit, that lets both channels take over their new value at the same time
+        uint16_t shadow[REGISTER_COUNT];
+        std::bitset<REGISTER_COUNT> dirty;
+        bool powered{true};
+        uint16_t savedPower[3]{}; // power management 1-3 before SetPowerState(false)
 
         esp_err_t i2cWriteNAU8822(uint8_t addr, int16_t data)
         {
@@ -58,6 +84,51 @@ namespace nau88c22
             return espRc;
         }
 
+        void setBits(uint8_t reg, uint16_t mask, uint16_t value)
+        {
+            uint16_t v = (shadow[reg] & ~mask) | (value & mask & 0x1FF);
+            if (v != shadow[reg])
+            {
+                shadow[reg] = v;
+                dirty.set(reg);
+            }
+        }
+
+        void setRegister(uint8_t reg, uint16_t value)
+        {
+            setBits(reg, 0x1FF, value);
+        }
+
+        // writes all dirty registers; a register, whose write fails, stays dirty and is written with the next flush
+        esp_err_t flush()
+        {
+            esp_err_t ret{ESP_OK};
+            for (uint8_t reg = 0; reg < REGISTER_COUNT && dirty.any(); reg++)
+            {
+                if (!dirty.test(reg))
+                {
+                    continue;
+                }
+                esp_err_t err = i2cWriteNAU8822(reg, shadow[reg]);
+                if (err == ESP_OK)
+                {
+                    dirty.reset(reg);
+                }
+                else
+                {
+                    ret = err;
+                }
+            }
+            return ret;
+        }
+
+        esp_err_t softwareReset()
+        {
+            std::copy(REGISTER_DEFAULTS, REGISTER_DEFAULTS + REGISTER_COUNT, shadow);
+            dirty.reset();
+            return i2cWriteNAU8822(0, 0x000);
+        }
+
         esp_err_t i2cCheckNAU8822()
         {
             esp_err_t err = i2c_master_probe(bus_handle, NAU8822_I2C_ADDRESS, 1000);
@@ -84,55 +155,81 @@ namespace nau88c22
         {
             uint16_t value = volume0_255 >> 2;
             ESP_LOGI(TAG, "Setting Speaker Volume to %ddB", value);
-            i2cWriteNAU8822(54, 0x100 | value);
-            i2cWriteNAU8822(55, 0x100 | value);
+            setRegister(54, 0x100 | value);
+            setRegister(55, 0x100 | value);
+            flush();
         }
 
         void muteSpeakers(void)
         {
             ESP_LOGI(TAG, "Mute Speakers");
-            i2cWriteNAU8822(54, 0x100 | 0x40);
-            i2cWriteNAU8822(55, 0x100 | 0x40);
+            setRegister(54, 0x100 | 0x40);
+            setRegister(55, 0x100 | 0x40);
+            flush();
         }
 
         void setHeadphonesVolume(uint8_t volume0_255)
         {
             uint16_t value = volume0_255 >> 2;
             ESP_LOGI(TAG, "Setting Headphones Volume to %ddB", value);
-            i2cWriteNAU8822(52, value);
-            i2cWriteNAU8822(53, 0x100 | value);
+            setRegister(52, value);
+            setRegister(53, 0x100 | value);
+            flush();
         }
 
         void muteHeadphones(void)
         {
             ESP_LOGI(TAG, "Mute Headphones");
-            i2cWriteNAU8822(52, 0x040);
-            i2cWriteNAU8822(53, 0x140);
+            setRegister(52, 0x040);
+            setRegister(53, 0x140);
+            flush();
         }
 
         void i2cSetupNAU8822Play(uint8_t initialVolume_0_255 = 255) // this is the hardware default volume
         {
             
-            ESP_ERROR_CHECK(i2cWriteNAU8822(0, 0x000)); // Software Reset
+            ESP_ERROR_CHECK(softwareReset());
             vTaskDelay(pdMS_TO_TICKS(100));
             muteSpeakers(); // according to datasheet power up procedure
             //muteHeadphones();
-            i2cWriteNAU8822(1, 0b1'1111'1101); // Enable Everything
+            setRegister(1, 0b1'1111'1101); // Enable Everything
+            flush();
             vTaskDelay(pdMS_TO_TICKS(250));    // according to datasheet power up procedure
-            i2cWriteNAU8822(2, 0b1'1000'0000); // Power 2: Enable Headphones
-            i2cWriteNAU8822(3, 0b1'1110'1111); // Power 3: Enable everything
-            i2cWriteNAU8822(4, 0b0'0001'0000); // Audio Interface: normal phase, 16bit (instead of default 24), standard I2S format
-            i2cWriteNAU8822(6, 0b0'0000'1100); // MCLK, pin#11 used as master clock, divided by 1, divide by 8, slave mode
-
-            i2cWriteNAU8822(43, 0b0'0001'0000); // Right Speaker Submixer -->BTL-Configuration
-            i2cWriteNAU8822(49, 0b0'0101'1110); //Output Control: Left DAC output to RMIX!. Außerdem: Thermal shutdown enable, Speaker für 5V Versorgungsspannung optimiert.
-            i2cWriteNAU8822(50, 0x1DD); //I wanna have it loud!
-            //i2cWriteNAU8822(51, 0x001);
+            setRegister(2, 0b1'1000'0000); // Power 2: Enable Headphones
+            setRegister(3, 0b1'1110'1111); // Power 3: Enable everything
+            setRegister(4, 0b0'0001'0000); // Audio Interface: normal phase, 16bit (instead of default 24), standard I2S format
+            setRegister(6, 0b0'0000'1100); // MCLK, pin#11 used as master clock, divided by 1, divide by 8, slave mode
+
+            setRegister(43, 0b0'0001'0000); // Right Speaker Submixer -->BTL-Configuration
+            setRegister(49, 0b0'0101'1110); //Output Control: Left DAC output to RMIX!. Außerdem: Thermal shutdown enable, Speaker für 5V Versorgungsspannung optimiert.
+            setRegister(50, 0x1DD); //I wanna have it loud!
+            //setRegister(51, 0x001);
         
-            setSpeakersVolume(initialVolume_0_255);
+            setSpeakersVolume(initialVolume_0_255); // flushes everything above in one go
             //setHeadphonesVolume(initialVolume_0_255);
         }
 
+        // ADC path for full duplex: mic bias (already on via register 1), both PGAs with the differential mic inputs, +20dB boost, ADCs
+        void i2cSetupNAU8822Record()
+        {
+            setBits(2, 0b0'0011'1111, 0b0'0011'1111); // Power 2: Boost L/R, PGA L/R, ADC L/R
+            setRegister(14, 0b1'0000'1000); // ADC Control: high pass filter (removes DC), 128x oversampling for better SNR
+            setRegister(44, 0b0'0011'0011); // Input Control: LMICP/LMICN to left PGA, RMICP/RMICN to right PGA
+            setRegister(47, 0b1'0000'0000); // Left ADC Boost: PGA +20dB, line and aux inputs off
+            setRegister(48, 0b1'0000'0000); // Right ADC Boost
+            setMicGain(micGain);
+        }
+
+        // PGA gain 0...63: -12dB...+35.25dB in 0.75dB steps; 0x10 is 0dB. Zero crossing detection avoids clicks
+        void setMicGain(uint8_t gain0_63)
+        {
+            uint16_t value = gain0_63 & 0x3F;
+            ESP_LOGI(TAG, "Setting Mic PGA Gain to %d", value);
+            setBits(45, 0x0BF, 0x080 | value); // keep the mute bit
+            setBits(46, 0x1BF, 0x180 | value); // update bit: both channels take over the gain now
+            flush();
+        }
+
     public:
         M(
             i2c_master_bus_handle_t bus_handle,
@@ -141,13 +238,82 @@ namespace nau88c22
             gpio_num_t ws,
             gpio_num_t data,
             uint8_t initialVolume = 127,
-            uint32_t initialSampleRateHz=44100) : CodecManager::aI2sCodecManager(initialSampleRateHz), bus_handle(bus_handle), mclk(mclk), bck(bck), ws(ws), data(data), volumeSpeakers(initialVolume)
+            uint32_t initialSampleRateHz=44100,
+            gpio_num_t dataIn = GPIO_NUM_NC,
+            CodecManager::DmaBuffering buffering = CodecManager::DMA_BUFFERING_DEFAULT) : CodecManager::aI2sCodecManager(initialSampleRateHz), bus_handle(bus_handle), mclk(mclk), bck(bck), ws(ws), data(data), dataIn(dataIn), volumeSpeakers(initialVolume)
         {
+            std::copy(REGISTER_DEFAULTS, REGISTER_DEFAULTS + REGISTER_COUNT, shadow);
+            SetDmaBuffering(buffering);
+        }
+
+        // only with dataIn; takes effect immediately
+        ErrorCode SetMicGain(uint8_t gain0_63)
+        {
+            if (dataIn == GPIO_NUM_NC)
+            {
+                return ErrorCode::FUNCTION_NOT_AVAILABLE;
+            }
+            micGain = gain0_63 & 0x3F;
+            if (dev_handle)
+            {
+                setMicGain(micGain);
+            }
+            return ErrorCode::OK;
         }
 
+        // Standby keeps VMID and the analog bias on, so the registers (and the shadow) stay valid and powering up needs no settling time.
+        // Volume changes during standby only change volumeSpeakers; the shadow and the speaker volume registers keep the mute of the
+        // standby (so RestoreRegisters restores a muted codec), SetPowerState(true) writes the volume
         ErrorCode SetPowerState(bool power) override
         {
-            ESP_LOGW(TAG, "SetPowerState not yet supported");
+            if (power == powered || !dev_handle)
+            {
+                return ErrorCode::OK;
+            }
+            if (!power)
+            {
+                std::copy(shadow + 1, shadow + 4, savedPower);
+                muteSpeakers();
+                setRegister(3, 0x000);
+                setRegister(2, 0x000);
+                setBits(1, 0b1'1111'0100, 0); // keep REFIMP (VMID) and ABIASEN
+                RETURN_ERRORCODE_ON_ERROR(flush(), ErrorCode::GENERIC_ERROR);
+                powered = false;
+                return ErrorCode::OK;
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                setRegister(i + 1, savedPower[i]);
+            }
+            RETURN_ERRORCODE_ON_ERROR(flush(), ErrorCode::GENERIC_ERROR);
+            powered = true;
+            if (volumeSpeakers != 0)
+            {
+                setSpeakersVolume(volumeSpeakers);
+            }
+            return ErrorCode::OK;
+        }
+
+        // Writes the whole shadow again, e.g. after the codec has lost its supply: software reset, then every register that differs
+        // from its default, with the VMID settling time of the power up procedure
+        ErrorCode RestoreRegisters()
+        {
+            if (!dev_handle)
+            {
+                return ErrorCode::NOT_YET_INITIALIZED;
+            }
+            uint16_t target[REGISTER_COUNT];
+            std::copy(shadow, shadow + REGISTER_COUNT, target);
+            RETURN_ERRORCODE_ON_ERROR(softwareReset(), ErrorCode::DEVICE_NOT_RESPONDING);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            setRegister(1, target[1]);
+            RETURN_ERRORCODE_ON_ERROR(flush(), ErrorCode::GENERIC_ERROR);
+            vTaskDelay(pdMS_TO_TICKS(250));
+            for (uint8_t reg = 2; reg < REGISTER_COUNT; reg++)
+            {
+                setRegister(reg, target[reg]);
+            }
+            RETURN_ERRORCODE_ON_ERROR(flush(), ErrorCode::GENERIC_ERROR);
             return ErrorCode::OK;
         }
         ErrorCode SetVolume(uint8_t volume0_255) override
@@ -156,6 +322,11 @@ namespace nau88c22
             {
                 return ErrorCode::OK;
             }
+            if (!powered)
+            {
+                volumeSpeakers = volume0_255;
+                return ErrorCode::OK;
+            }
             if (volume0_255 == 0)
             {
                 muteSpeakers();
@@ -173,7 +344,7 @@ namespace nau88c22
         ErrorCode Init()
         {
             ESP_LOGI(TAG, "Setup I2S");
-            RETURN_ON_ERRORCODE(this->InitI2sEsp32(mclk, bck, ws, data));
+            RETURN_ON_ERRORCODE(this->InitI2sEsp32(mclk, bck, ws, data, dataIn));
             ESP_LOGI(TAG, "Setup of the NAU88C22 begins");
 
             i2c_device_config_t dev_cfg = {
@@ -190,6 +361,10 @@ namespace nau88c22
                 return ErrorCode::GENERIC_ERROR;
             }
             i2cSetupNAU8822Play(volumeSpeakers);
+            if (dataIn != GPIO_NUM_NC)
+            {
+                i2cSetupNAU8822Record();
+            }
             return ErrorCode::OK;
         }
     };
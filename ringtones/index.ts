@@ -13,7 +13,8 @@ fs.readdirSync(directoryPath).forEach((filename) => {
 
 })
 
-let output = "#pragma once\n"
+// no include guard: buzzer.cc and audio/synth.hh include the songs into their own namespaces, also both in the same translation unit
+let output = ""
 for (const s of songs) {
   output += `constexpr Note ${s2i(s.Name, CasingMode.UPPER)}[] = {`
   for (const note of s.Tones) {
@@ -23,7 +24,7 @@ for (const s of songs) {
 }
 output += "\n\n";
 
-output += "const Note *RINGTONE_SOUNDS[] = {0,"
+output += "constexpr const Note *RINGTONE_SOUNDS[] = {0,"
 for (const s of songs) {
  output+=`${s2i(s.Name, CasingMode.UPPER)},`
 } 
@@ -0,0 +1,353 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <type_traits>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_adc/adc_continuous.h>
+#include <esp_log.h>
+#include <driver/gpio.h>
+#include <errorcodes.hh>
+#include <arduinoFFT_t.h>
+#define TAG "SPECTRUM"
+
+/*
+    Streaming spectrum analyzer for machine condition monitoring.
+
+    The samples of a stream (I2S capture or continuous ADC) are written once into a history of twice the FFT size: sample i is
+    stored at i mod N and i mod N + N. So the last N samples are always contiguous at history + writePos, and every frame is
+    transformed directly from there (arduinoFFT_t::ComputeReal with the cached window). There is no frame buffer and no copy
+    per frame, however large the overlap is.
+
+    Every hop samples a frame is transformed, i.e. with a fixed frame rate of sampleRate/hop (hop = samples/2: 50% overlap,
+    samples/4: 75%). The magnitudes of averages frames are averaged into one spectrum (Welch), which is passed to the callback
+    together with the MajorPeak of the averaged spectrum and a smoothed peak frequency. Spectra come at sampleRate/(hop*averages).
+
+    Feed, the FFT and the callback run in the task of the producer (the capture task of the codec manager or the task of AdcSource).
+*/
+namespace SpectrumAnalyzer
+{
+    struct Config
+    {
+        uint16_t samples;    // FFT size, power of 2 from 8 to 4096
+        uint16_t hop;        // new samples per frame, 1..samples
+        uint16_t averages;   // frames per spectrum
+        float sampleRateHz;
+        uint8_t windowType;  // FFT_WIN_TYP_*
+        float peakSmoothing; // 0..1, weight of the tracked peak against the peak of the new spectrum
+        uint8_t channel;     // channel of interleaved stereo I2S frames: 0 left, 1 right
+    };
+
+    struct Spectrum
+    {
+        const float *magnitudes; // averaged magnitudes of the bins 0..bins-1 (bin k at k*binWidthHz), valid during the callback
+        uint16_t bins;           // samples/2 + 1
+        float binWidthHz;
+        float peakFrequencyHz;   // MajorPeak of the averaged spectrum, 0 without peak
+        float peakMagnitude;     // magnitude of the bin nearest to peakFrequencyHz
+        float trackedPeakHz;     // peakFrequencyHz smoothed with peakSmoothing
+        uint32_t sequence;       // number of spectra since Init
+    };
+
+    typedef void (*SpectrumCallback)(const Spectrum &spectrum, void *userCtx);
+
+    struct Statistics
+    {
+        uint32_t samples; // fed samples
+        uint32_t frames;  // transformed frames
+        uint32_t spectra; // callbacks
+    };
+
+    // S: int16_t for I2S (signed PCM), uint16_t for ADC data (the mean of every frame is removed)
+    template <typename S>
+    class M
+    {
+        static_assert(std::is_same<S, int16_t>::value || std::is_same<S, uint16_t>::value, "samples are int16_t or uint16_t");
+
+    public:
+        M(const Config &config, SpectrumCallback callback, void *userCtx) : config(config), callback(callback), userCtx(userCtx) {}
+
+        ~M()
+        {
+            delete fft;
+            delete[] history;
+            delete[] vReal;
+            delete[] vImag;
+            delete[] sum;
+        }
+
+        ErrorCode Init()
+        {
+            if (history)
+            {
+                return ErrorCode::INVALID_STATE;
+            }
+            const uint16_t n = config.samples;
+            if (n < 8 || n > 4096 || (n & (n - 1)) != 0 || config.hop == 0 || config.hop > n || config.averages == 0 ||
+                config.sampleRateHz <= 0 || config.windowType > FFT_WIN_TYP_WELCH || config.peakSmoothing < 0 || config.peakSmoothing >= 1 ||
+                config.channel > 1)
+            {
+                return ErrorCode::INVALID_ARGUMENT_VALUES;
+            }
+            bins = (n >> 1) + 1;
+            history = new S[2 * n];
+            vReal = new float[bins + 1]; // + bin N/2+1, which MajorPeak reads
+            vImag = new float[bins + 1];
+            sum = new float[bins];
+            fft = new arduinoFFT_t<float>(vReal, vImag, n, config.sampleRateHz);
+            // the constructor has built the twiddle tables; build the window table here as well, so that the first frame of the
+            // producer task neither allocates nor waits for another task creating it
+            arduinoFFT_kernel<float>::Window(config.windowType, fft->Exponent(n));
+            Reset();
+            ESP_LOGI(TAG, "%u point FFT every %u samples (%.1f frames/s), %u frames per spectrum, %.2fHz per bin", n, config.hop,
+                     config.sampleRateHz / config.hop, config.averages, config.sampleRateHz / n);
+            return ErrorCode::OK;
+        }
+
+        // forgets the history and the partial average, e.g. after a gap in the stream
+        void Reset()
+        {
+            writePos = 0;
+            filled = 0;
+            sinceFrame = 0;
+            framesInSum = 0;
+            memset(sum, 0, bins * sizeof(float));
+        }
+
+        // count samples, every stride-th of data
+        void Feed(const S *data, size_t count, size_t stride = 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                Push(data[i * stride]);
+            }
+        }
+
+        // conversion results as read by adc_continuous_read (output format type 2)
+        void FeedAdc(const uint8_t *result, uint32_t length)
+        {
+            static_assert(std::is_same<S, uint16_t>::value, "ADC data needs M<uint16_t>");
+            for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES)
+            {
+                const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&result[i];
+                Push((uint16_t)p->type2.data);
+            }
+        }
+
+        // CodecManager::CaptureCallback; userCtx is the analyzer, the frames are interleaved stereo
+        static void OnCapture(const int16_t *frames, size_t frameCnt, void *userCtx)
+        {
+            static_assert(std::is_same<S, int16_t>::value, "I2S data needs M<int16_t>");
+            M *myself = static_cast<M *>(userCtx);
+            myself->Feed(frames + myself->config.channel, frameCnt, 2);
+        }
+
+        Statistics GetStatistics() { return statistics; }
+
+        const Config &GetConfig() { return config; }
+
+    private:
+        const Config config;
+        SpectrumCallback callback;
+        void *userCtx;
+        arduinoFFT_t<float> *fft{nullptr};
+        S *history{nullptr}; // 2*samples, every sample twice
+        float *vReal{nullptr};
+        float *vImag{nullptr};
+        float *sum{nullptr}; // magnitudes of the frames so far
+        uint16_t bins{0};
+        uint16_t writePos{0};
+        uint16_t filled{0};
+        uint32_t sinceFrame{0};
+        uint16_t framesInSum{0};
+        float trackedPeakHz{0};
+        Statistics statistics{};
+
+        inline void Push(S v)
+        {
+            history[writePos] = v;
+            history[writePos + config.samples] = v;
+            if (++writePos == config.samples)
+            {
+                writePos = 0;
+            }
+            if (filled < config.samples)
+            {
+                filled++;
+            }
+            statistics.samples++;
+            if (++sinceFrame >= config.hop && filled == config.samples)
+            {
+                sinceFrame = 0;
+                ProcessFrame();
+            }
+        }
+
+        void ProcessFrame()
+        {
+            // the oldest of the last N samples is at writePos, the newest at writePos + N - 1
+            fft->ComputeReal(history + writePos, config.windowType);
+            fft->ComplexToMagnitude();
+            for (uint16_t k = 0; k < bins; k++)
+            {
+                sum[k] += vReal[k];
+            }
+            statistics.frames++;
+            if (++framesInSum < config.averages)
+            {
+                return;
+            }
+            // the average replaces the magnitudes of the last frame, so MajorPeak works on it without another buffer
+            const float scale = 1.0f / config.averages;
+            for (uint16_t k = 0; k < bins; k++)
+            {
+                vReal[k] = sum[k] * scale;
+                sum[k] = 0;
+            }
+            vReal[bins] = vReal[bins - 2];
+            framesInSum = 0;
+
+            Spectrum s;
+            s.magnitudes = vReal;
+            s.bins = bins;
+            s.binWidthHz = config.sampleRateHz / config.samples;
+            float v;
+            fft->MajorPeak(&s.peakFrequencyHz, &v);
+            const long peakBin = lrintf(s.peakFrequencyHz / s.binWidthHz);
+            s.peakMagnitude = vReal[peakBin < bins ? peakBin : bins - 1];
+            if (s.peakFrequencyHz > 0)
+            {
+                trackedPeakHz = trackedPeakHz > 0 ? config.peakSmoothing * trackedPeakHz + (1.0f - config.peakSmoothing) * s.peakFrequencyHz : s.peakFrequencyHz;
+            }
+            s.trackedPeakHz = trackedPeakHz;
+            s.sequence = ++statistics.spectra;
+            callback(s, userCtx);
+        }
+    };
+
+    // Reads one ADC1 channel in continuous mode and feeds the conversion results directly from the read buffer into the analyzer
+    class AdcSource
+    {
+    public:
+        static constexpr uint32_t RESULTS_PER_READ = 256;
+        static constexpr uint32_t READ_TIMEOUT_MS = 100; // the read task checks for Stop at least this often
+        static constexpr UBaseType_t TASK_PRIORITY = 10;
+
+        AdcSource(M<uint16_t> *analyzer) : analyzer(analyzer) {}
+
+        // the sample rate is the one of the analyzer config
+        ErrorCode Start(gpio_num_t gpio)
+        {
+            if (handle)
+            {
+                return ErrorCode::INVALID_STATE;
+            }
+            const uint32_t sampleRateHz = (uint32_t)analyzer->GetConfig().sampleRateHz;
+            if (sampleRateHz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || sampleRateHz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH)
+            {
+                return ErrorCode::INVALID_ARGUMENT_VALUES;
+            }
+            adc_channel_t adc_channel{ADC_CHANNEL_0};
+            adc_unit_t adc_unit{ADC_UNIT_1};
+            if (adc_continuous_io_to_channel(gpio, &adc_unit, &adc_channel) != ESP_OK || adc_unit != ADC_UNIT_1)
+            {
+                return ErrorCode::PIN_DOES_NOT_SUPPORT_MODE;
+            }
+
+            adc_continuous_handle_cfg_t adc_config = {};
+            adc_config.conv_frame_size = RESULTS_PER_READ * SOC_ADC_DIGI_RESULT_BYTES;
+            adc_config.max_store_buf_size = 4 * adc_config.conv_frame_size;
+            ESP_ERROR_CHECK(adc_continuous_new_handle(&adc_config, &handle));
+
+            adc_continuous_config_t dig_cfg = {};
+            dig_cfg.sample_freq_hz = sampleRateHz;
+            dig_cfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+            dig_cfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+        #pragma GCC diagnostic pop
+
+            adc_digi_pattern_config_t adc_pattern[SOC_ADC_PATT_LEN_MAX];
+            adc_pattern[0].atten = ADC_ATTEN_DB_12;
+            adc_pattern[0].channel = adc_channel;
+            adc_pattern[0].unit = ADC_UNIT_1;
+            adc_pattern[0].bit_width = ADC_BITWIDTH_12;
+            dig_cfg.pattern_num = 1;
+            dig_cfg.adc_pattern = adc_pattern;
+            ESP_ERROR_CHECK(adc_continuous_config(handle, &dig_cfg));
+
+            adc_continuous_evt_cbs_t cbs = {};
+            cbs.on_pool_ovf = OnPoolOverflow;
+            ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(handle, &cbs, this));
+
+            if (!stopped)
+            {
+                stopped = xSemaphoreCreateBinary();
+            }
+            overruns = 0;
+            ESP_ERROR_CHECK(adc_continuous_start(handle));
+            running = true;
+            if (xTaskCreate(ReadTask, "AdcSpectrum", 4096, this, TASK_PRIORITY, nullptr) != pdPASS)
+            {
+                running = false;
+                adc_continuous_stop(handle);
+                adc_continuous_deinit(handle);
+                handle = nullptr;
+                return ErrorCode::GENERIC_ERROR;
+            }
+            ESP_LOGI(TAG, "ADC spectrum source on GPIO %d with %luHz started", (int)gpio, (unsigned long)sampleRateHz);
+            return ErrorCode::OK;
+        }
+
+        // returns after the last spectrum callback has finished
+        ErrorCode Stop()
+        {
+            if (!handle)
+            {
+                return ErrorCode::OK;
+            }
+            running = false;
+            xSemaphoreTake(stopped, portMAX_DELAY);
+            ESP_ERROR_CHECK(adc_continuous_stop(handle));
+            ESP_ERROR_CHECK(adc_continuous_deinit(handle));
+            handle = nullptr;
+            return ErrorCode::OK;
+        }
+
+        // conversion results lost, because the read task did not keep up; the analyzer history then has a gap
+        uint32_t GetOverrunCount() { return overruns; }
+
+    private:
+        M<uint16_t> *analyzer;
+        adc_continuous_handle_t handle{nullptr};
+        std::atomic<bool> running{false}; // cleared by Stop, polled by the read task
+        SemaphoreHandle_t stopped{nullptr}; // given by the read task, when it ends
+        std::atomic<uint32_t> overruns{0}; // counted by the ADC driver callback, read by any task
+        uint8_t result[RESULTS_PER_READ * SOC_ADC_DIGI_RESULT_BYTES];
+
+        static bool IRAM_ATTR OnPoolOverflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+        {
+            static_cast<AdcSource *>(user_data)->overruns++;
+            return false;
+        }
+
+        static void ReadTask(void *p)
+        {
+            AdcSource *myself = static_cast<AdcSource *>(p);
+            while (myself->running)
+            {
+                uint32_t length{0};
+                if (adc_continuous_read(myself->handle, myself->result, sizeof(myself->result), &length, READ_TIMEOUT_MS) == ESP_OK)
+                {
+                    myself->analyzer->FeedAdc(myself->result, length);
+                }
+            }
+            xSemaphoreGive(myself->stopped);
+            vTaskDelete(nullptr);
+        }
+    };
+}
+#undef TAG
@@ -1,5 +1,6 @@
 #pragma once
 #include <inttypes.h>
+#include <cstring>
 #include "tas5805m_reg_cfg.h"
 #include "errorcodes.hh"
 #include "common.hh"
@@ -30,6 +31,42 @@ namespace TAS580x
 		_5330ms,
 	};
 
+	// DIG_VOL_CTRL2: the device ramps volume changes itself, one step every 1/2/4 sample periods
+	enum class VolumeRampSpeed{
+		EVERY_1_FS=0,
+		EVERY_2_FS=1,
+		EVERY_4_FS=2,
+		INSTANT=3,
+	};
+
+	enum class VolumeRampStep{
+		_4dB=0,
+		_2dB=1,
+		_1dB=2,
+		_0_5dB=3,
+	};
+
+	enum class PresetKind{
+		EQ,
+		DRC,
+	};
+	constexpr size_t PRESET_KINDS = 2;
+
+	// A set of DSP coefficients in the format of tas5805m_reg_cfg.h (as exported by PPC3): page/book selections followed by the
+	// coefficient registers of that page. The EQ and the DRC preset of one profile (e.g. "speech", "music") have the same name
+	struct DspPreset{
+		const char *name;
+		PresetKind kind;
+		const CFG::tas5805m_cfg_reg_t *regs;
+		size_t count;
+	};
+
+	enum class SuspendMode{
+		HI_Z,       // output stage off, DSP and clocks running: resumes within a few ms
+		DEEP_SLEEP, // lowest power with I2C alive; registers and DSP memory are retained
+		POWER_DOWN, // PDN pin low: the device loses everything, Resume replays the register table
+	};
+
 	enum class CTRL_STATE{
 		DEEP_SLEEP=0,
 		SLEEP=1,
@@ -99,7 +136,7 @@ namespace TAS580x
 		constexpr uint8_t SELECT_BOOK = 0x7F;
 	}
 
-	class M:public CodecManager::I2sWithHardwareVolume
+	class M:public CodecManager::aI2sCodecManager
 	{
 	private:
 		i2c::iI2CBus* i2c_bus;
@@ -111,6 +148,12 @@ namespace TAS580x
 		gpio_num_t ws;
 		gpio_num_t data;
 		uint8_t initialVolume=50;
+		uint8_t analogGain{16};            //last values written, restored after POWER_DOWN and read back to verify a resume
+		uint8_t digitalVolume{50};
+		int16_t deviceCtrl2{-1};           //cached DEVICE_CTRL_2 (control state, mute); -1: unknown
+		bool suspended{false};
+		SuspendMode suspendMode{SuspendMode::DEEP_SLEEP};
+		static constexpr TickType_t PLAY_STATE_TIMEOUT_TICKS = pdMS_TO_TICKS(50);
 
 		ErrorCode EnsureI2CDevice()
 		{
@@ -125,38 +168,305 @@ namespace TAS580x
 			return i2c_bus->CreateDevice((uint8_t)this->addr, &i2c_device);
 		}
 		
+		// The register table selects book and page itself. The selection is tracked, so that redundant selections are not sent again.
+		// -1 means unknown, e.g. after a reset
+		int16_t currentBook{-1};
+		int16_t currentPage{-1};
+
+		static constexpr size_t MAX_BURST_BYTES = 128; // one page
+		static constexpr uint16_t MUTE_FADING_MS[] = {11, 53, 106, 266, 535, 1065, 2665, 5330};
+
+		MuteFadingTime muteFadingTime{MuteFadingTime::_53ms};
+		const DspPreset *activePresets[PRESET_KINDS]{}; //coefficients, that are on the device; nullptr: those of the init table
+
+		// Coefficients of one page within a register table
+		struct PageSegment{
+			int16_t book;
+			int16_t page;
+			const CFG::tas5805m_cfg_reg_t *regs;
+			size_t count;
+		};
+
+		// Returns the next page segment of the table starting at *pos and advances *pos. Book and page selections are interpreted
+		// as in transmitRegisters; book/page are carried over between the calls. Returns false at the end of the table
+		static bool NextPageSegment(const CFG::tas5805m_cfg_reg_t *regs, size_t count, size_t *pos, int16_t *book, int16_t *page, PageSegment *seg)
+		{
+			size_t i = *pos;
+			while (i < count)
+			{
+				const uint8_t reg = regs[i].offset;
+				if (reg == R::SELECT_PAGE)
+				{
+					*page = regs[i].value;
+				}
+				else if (reg == R::SELECT_BOOK && *page == 0)
+				{
+					*book = regs[i].value;
+				}
+				else if (reg != CFG::META_DELAY && reg != CFG::META_SWITCH && reg != CFG::META_BURST)
+				{
+					break;
+				}
+				i++;
+			}
+			if (i >= count)
+			{
+				*pos = count;
+				return false;
+			}
+			size_t start = i;
+			while (i < count && regs[i].offset != R::SELECT_PAGE && !(regs[i].offset == R::SELECT_BOOK && *page == 0) && regs[i].offset != CFG::META_DELAY && regs[i].offset != CFG::META_SWITCH && regs[i].offset != CFG::META_BURST)
+			{
+				i++;
+			}
+			*seg = PageSegment{*book, *page, regs + start, i - start};
+			*pos = i;
+			return true;
+		}
+
+		// true, if the active preset has exactly these coefficients for the page
+		static bool PageIsLoaded(const DspPreset *active, const PageSegment &seg)
+		{
+			if (!active)
+			{
+				return false;
+			}
+			size_t pos{0};
+			int16_t book{-1}, page{-1};
+			PageSegment other;
+			while (NextPageSegment(active->regs, active->count, &pos, &book, &page, &other))
+			{
+				if (other.book == seg.book && other.page == seg.page && other.count == seg.count && memcmp(other.regs, seg.regs, seg.count * sizeof(CFG::tas5805m_cfg_reg_t)) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// writes the pages of preset, that differ from the active preset of its kind; *written counts the written pages.
+		// With mute, the device is soft muted before the first page is written, *muted tells the caller to unmute
+		ErrorCode TransmitPresetPages(const DspPreset &preset, bool mute, bool *muted, uint32_t *written)
+		{
+			size_t pos{0};
+			int16_t book{-1}, page{-1};
+			PageSegment seg;
+			while (NextPageSegment(preset.regs, preset.count, &pos, &book, &page, &seg))
+			{
+				if (book < 0 || page < 0)
+				{
+					ESP_LOGE(TAG, "Preset %s has coefficients before the first book/page selection", preset.name);
+					return ErrorCode::DATA_FORMAT_ERROR;
+				}
+				if (PageIsLoaded(activePresets[(size_t)preset.kind], seg))
+				{
+					continue;
+				}
+				if (mute && !*muted)
+				{
+					RETURN_ON_ERRORCODE(SwitchToBookAndPage(0, 0));
+					RETURN_ON_ERRORCODE(Mute(true));
+					vTaskDelay(pdMS_TO_TICKS(MUTE_FADING_MS[(size_t)muteFadingTime]));
+					*muted = true;
+				}
+				RETURN_ON_ERRORCODE(SwitchToBookAndPage(book, page));
+				RETURN_ON_ERRORCODE(transmitRegisters(seg.regs, seg.count));
+				(*written)++;
+			}
+			return ErrorCode::OK;
+		}
+
+		void ForgetBookAndPage()
+		{
+			currentBook = currentPage = -1;
+		}
+
+		// DEVICE_CTRL_2 is only read from the device, if the cached value is unknown. Book 0, page 0 has to be selected
+		ErrorCode ReadDeviceCtrl2()
+		{
+			if (deviceCtrl2 >= 0)
+			{
+				return ErrorCode::OK;
+			}
+			uint8_t reg = 0;
+			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::DEVICE_CTRL_2, &reg, 1));
+			deviceCtrl2 = reg;
+			return ErrorCode::OK;
+		}
+
+		ErrorCode WriteDeviceCtrl2(uint8_t reg)
+		{
+			if (deviceCtrl2 == reg)
+			{
+				return ErrorCode::OK;
+			}
+			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			deviceCtrl2 = -1; // unknown, if the write fails
+			RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::DEVICE_CTRL_2, reg));
+			deviceCtrl2 = reg;
+			return ErrorCode::OK;
+		}
+
+		// polls POWER_STATE until the device has reached the state; the transition from DEEP_SLEEP to PLAY takes a few ms
+		ErrorCode WaitForPowerState(CTRL_STATE state)
+		{
+			TickType_t start = xTaskGetTickCount();
+			uint8_t reg = 0;
+			while (true)
+			{
+				RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::POWER_STATE, &reg, 1));
+				if ((reg & 0x03) == (uint8_t)state)
+				{
+					return ErrorCode::OK;
+				}
+				if (xTaskGetTickCount() - start > PLAY_STATE_TIMEOUT_TICKS)
+				{
+					ESP_LOGW(TAG, "Device did not reach state %d, POWER_STATE=%02X", (int)state, reg);
+					return ErrorCode::TIMEOUT;
+				}
+				vTaskDelay(1);
+			}
+		}
+
+		// Everything after the release of PDN: register table, the active presets, then gain, volume, ramp and fading time with their last values
+		ErrorCode Configure()
+		{
+			//set the device into HiZ state and enable DSP via the I2C control port.
+			//Wait 5ms at least. Then initialize the DSP Coefficient
+			deviceCtrl2 = -1;
+			RETURN_ON_ERRORCODE(SwitchToBookAndPage(0, 0));
+			RETURN_ON_ERRORCODE(SetControlState(CTRL_STATE::Hi_Z));
+			vTaskDelay(pdMS_TO_TICKS(10));
+			const DspPreset *presets[PRESET_KINDS];
+			for (size_t k = 0; k < PRESET_KINDS; k++)
+			{
+				presets[k] = activePresets[k];
+				activePresets[k] = nullptr; // the table overwrites the coefficients
+			}
+			RETURN_ON_ERRORCODE(transmitRegisters(CFG::tas5805m_registers, sizeof(CFG::tas5805m_registers) / sizeof(CFG::tas5805m_registers[0])));
+			//presets loaded before a brown out or POWER_DOWN; still in HiZ, so without mute
+			for (size_t k = 0; k < PRESET_KINDS; k++)
+			{
+				if (!presets[k])
+				{
+					continue;
+				}
+				bool muted{false};
+				uint32_t written{0};
+				RETURN_ON_ERRORCODE(TransmitPresetPages(*presets[k], false, &muted, &written));
+				activePresets[k] = presets[k];
+			}
+			//Reset pointers to book 0, page 0, aka. the main control port...
+			RETURN_ON_ERRORCODE(SwitchToBookAndPage(0,0));
+			RETURN_ON_ERRORCODE(SetAnalogGain(analogGain));
+			RETURN_ON_ERRORCODE(SetDigitalVolumeRamp());
+			RETURN_ON_ERRORCODE(SetDigitalVolume(digitalVolume));
+			RETURN_ON_ERRORCODE(SetMuteFadingTime(muteFadingTime));
+			//set the device to Play state.
+			return SetControlState(CTRL_STATE::PLAY);
+		}
+
+	protected:
+		ErrorCode WriteBurst(uint8_t startReg, const uint8_t *data, size_t len)
+		{
+			if (len == 0)
+			{
+				return ErrorCode::OK;
+			}
+			if (len == 1)
+			{
+				return i2c_device->WriteRegisterU8(startReg, data[0]);
+			}
+			return i2c_device->WriteRegister(startReg, data, len);
+		}
+
+		// Sends a register table. Runs of consecutive registers within a page are coalesced into one auto-increment write,
+		// and book/page selections, that do not change anything, are skipped. This reduces the 1600 single writes of the default
+		// table to a few hundred transactions
 		ErrorCode transmitRegisters(const CFG::tas5805m_cfg_reg_t *conf_buf, int size)
 		{
+			deviceCtrl2 = -1; // the table may write DEVICE_CTRL_2
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			uint8_t burst[MAX_BURST_BYTES];
+			size_t burstLen{0};
+			uint8_t burstStart{0};
 			int i = 0;
 			while (i < size)
 			{
-				switch (conf_buf[i].offset)
+				const uint8_t reg = conf_buf[i].offset;
+				const uint8_t value = conf_buf[i].value;
+				bool isData = reg != CFG::META_SWITCH && reg != CFG::META_DELAY && reg != CFG::META_BURST && reg != R::SELECT_PAGE && !(reg == R::SELECT_BOOK && currentPage <= 0) && !(reg == R::RESET_CTRL && currentBook == 0 && currentPage == 0);
+				if (isData && burstLen > 0 && reg == burstStart + burstLen && burstLen < MAX_BURST_BYTES)
+				{
+					burst[burstLen++] = value;
+					i++;
+					continue;
+				}
+				RETURN_ON_ERRORCODE(WriteBurst(burstStart, burst, burstLen));
+				burstLen = 0;
+				if (isData)
+				{
+					burstStart = reg;
+					burst[burstLen++] = value;
+					i++;
+					continue;
+				}
+				switch (reg)
 				{
 				case CFG::META_SWITCH:
 					// Used in legacy applications.  Ignored here.
 					break;
 				case CFG::META_DELAY:
-					vTaskDelay(pdMS_TO_TICKS(conf_buf[i].value));
+					vTaskDelay(pdMS_TO_TICKS(value));
 					break;
 				case CFG::META_BURST:
-					RETURN_ON_ERRORCODE(i2c_device->WriteRegister(conf_buf[i + 1].offset, (unsigned char *)(&conf_buf[i + 1].value), conf_buf[i].value));
-					i += (conf_buf[i].value / 2) + 1;
+					// value bytes follow: the register address and value-1 data bytes
+					RETURN_ON_ERRORCODE(i2c_device->WriteRegister(conf_buf[i + 1].offset, &conf_buf[i + 1].value, value - 1));
+					i += (value / 2) + 1;
+					break;
+				case R::SELECT_PAGE:
+					if (currentPage != value)
+					{
+						RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_PAGE, value));
+						currentPage = value;
+					}
+					break;
+				case R::SELECT_BOOK:
+					// the book register exists on page 0 only; with an unknown page the write is sent, but the book stays unknown
+					if (currentPage != 0 || currentBook != value)
+					{
+						RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_BOOK, value));
+						currentBook = currentPage == 0 ? value : -1;
+					}
 					break;
-				default:
-					RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(conf_buf[i].offset, conf_buf[i].value));
+				default: // RESET_CTRL
+					RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(reg, value));
+					ForgetBookAndPage();
 					break;
 				}
 				i++;
 			}
-			return ErrorCode::OK;
+			return WriteBurst(burstStart, burst, burstLen);
 		}
 
 		ErrorCode SwitchToBookAndPage(uint8_t book, uint8_t page){
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
-			RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_PAGE, 0));
-			RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_BOOK, book));
-			RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_PAGE, page));
+			if (currentBook != book)
+			{
+				if (currentPage != 0)
+				{
+					RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_PAGE, 0));
+					currentPage = 0;
+				}
+				RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_BOOK, book));
+				currentBook = book;
+			}
+			if (currentPage != page)
+			{
+				RETURN_ON_ERRORCODE(i2c_device->WriteRegisterU8(R::SELECT_PAGE, page));
+				currentPage = page;
+			}
 			return ErrorCode::OK;
 		}
 
@@ -170,7 +480,7 @@ namespace TAS580x
 			gpio_num_t ws, 
 			gpio_num_t data,
 			uint8_t initialVolume=50
-			) : i2c_bus(i2c_bus), i2c_device(nullptr), addr(addr), power_down(power_down), mclk(mclk), bck(bck), ws(ws), data(data), initialVolume(initialVolume)
+			) : i2c_bus(i2c_bus), i2c_device(nullptr), addr(addr), power_down(power_down), mclk(mclk), bck(bck), ws(ws), data(data), initialVolume(initialVolume), digitalVolume(initialVolume)
 		{
 		}
 		
@@ -178,41 +488,38 @@ namespace TAS580x
 		ErrorCode SetAnalogGain(uint8_t gain_0to31=0x00)
 		{
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
-			return i2c_device->WriteRegisterU8(R::AGAIN, gain_0to31 & 0x1F);
+			analogGain = gain_0to31 & 0x1F;
+			return i2c_device->WriteRegisterU8(R::AGAIN, analogGain);
 		}
 		// 0=MAX Volume, 254=MIN Volume, 255=Mute, 50 is loud, 120 is quiet
 		ErrorCode SetDigitalVolume(uint8_t volume = 0b00110000)
 		{
 			ESP_LOGI(TAG, "SetDigitalVolume: Writing %02X to DIG_VOL_CTRL", volume);
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			digitalVolume = volume;
 			return i2c_device->WriteRegisterU8(R::DIG_VOL_CTRL, volume);
 		}
 
+		// Ramp for volume changes via DIG_VOL_CTRL, used for up and down. The reset value (0x33) is 0.5dB every sample, i.e. 24dB in 1ms, which
+		// still clicks, when the player changes the volume between two orders. The default 0.5dB every 4 samples (0xBB) takes 4ms for 24dB
+		// and 21ms for the full range
+		ErrorCode SetDigitalVolumeRamp(VolumeRampSpeed speed=VolumeRampSpeed::EVERY_4_FS, VolumeRampStep step=VolumeRampStep::_0_5dB)
+		{
+			uint8_t ramp = ((uint8_t)speed << 2) | (uint8_t)step;
+			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			return i2c_device->WriteRegisterU8(R::DIG_VOL_CTRL2, (ramp << 4) | ramp);
+		}
+
 		ErrorCode GetDigitalVolume(uint8_t *volume)
 		{
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
 			return i2c_device->ReadRegister(R::DIG_VOL_CTRL, volume, 1);
 		}
 
+		// The player switches the power on with every order and off, when it is stopped: Resume/Suspend(DEEP_SLEEP), which costs no I2C
+		// traffic, if nothing changes. Switching off blocks for the mute fading time, see Suspend
 		ErrorCode SetPowerState(bool power) override{
-			uint8_t reg = 0;
-			RETURN_ON_ERRORCODE(EnsureI2CDevice());
-			RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::DEVICE_CTRL_2, &reg, 1));
-			if((power && ((reg&0x03)==0x03)) || (!power && ((reg&0x03)==0x00))){
-				//if power setting is as we want to have it --> return!
-				return ErrorCode::OK;
-			}
-			if (power)
-			{
-				reg |= 0x3;
-			}
-			else
-			{
-				reg &= (~0x03);
-			}
-			
-			ESP_LOGI(TAG, "SetPowerState: Writing %02X to DEVICE_CTRL_2", reg);
-			return i2c_device->WriteRegisterU8(R::DEVICE_CTRL_2, reg);
+			return power ? Resume() : Suspend(SuspendMode::DEEP_SLEEP);
 		}
         
 		ErrorCode SetVolume(uint8_t volume) override{
@@ -221,20 +528,88 @@ namespace TAS580x
 
 		void PowerUp()
 		{
+			ForgetBookAndPage();
 			gpio_set_level(power_down, 1);
 		}
 
 		void PowerDown()
 		{
+			ForgetBookAndPage();
 			gpio_set_level(power_down, 0);
 		}
 
 		ErrorCode SetControlState(CTRL_STATE state){
-			uint8_t reg = 0;
+			RETURN_ON_ERRORCODE(ReadDeviceCtrl2());
+			return WriteDeviceCtrl2((deviceCtrl2 & 0xFC) | (uint8_t)state);
+		}
+
+		// Suspends the amplifier. HI_Z and DEEP_SLEEP keep the configuration on the device, so Resume only has to switch back to PLAY.
+		// The output is soft muted before, so the transition does not pop; the calling task (with SetPowerState(false) the player task)
+		// blocks for the mute fading time, 53ms by default
+		ErrorCode Suspend(SuspendMode mode=SuspendMode::DEEP_SLEEP)
+		{
+			if (suspended && (mode == suspendMode || suspendMode == SuspendMode::POWER_DOWN))
+			{
+				return ErrorCode::OK;
+			}
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
-			RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::DEVICE_CTRL_2, &reg, 1));
-			reg = (reg && 0xFC)|(uint8_t)state;
-			return i2c_device->WriteRegisterU8(R::DEVICE_CTRL_2, reg);
+			RETURN_ON_ERRORCODE(SwitchToBookAndPage(0, 0));
+			if (!suspended)
+			{
+				RETURN_ON_ERRORCODE(Mute(true));
+				vTaskDelay(pdMS_TO_TICKS(MUTE_FADING_MS[(size_t)muteFadingTime]));
+			}
+			suspended = true;
+			suspendMode = mode;
+			if (mode == SuspendMode::POWER_DOWN)
+			{
+				PowerDown();
+				deviceCtrl2 = -1;
+				return ErrorCode::OK;
+			}
+			return SetControlState(mode == SuspendMode::HI_Z ? CTRL_STATE::Hi_Z : CTRL_STATE::DEEP_SLEEP);
+		}
+
+		// Back to PLAY. After HI_Z/DEEP_SLEEP, the retained configuration is verified by reading back the gain and the volume; only if the
+		// device has lost it (e.g. brown out), or after POWER_DOWN, the register table and the active presets are replayed
+		ErrorCode Resume()
+		{
+			if (!suspended)
+			{
+				return ErrorCode::OK;
+			}
+			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			bool configurationLost{true};
+			if (suspendMode == SuspendMode::POWER_DOWN)
+			{
+				PowerUp();
+				vTaskDelay(pdMS_TO_TICKS(20));
+			}
+			else
+			{
+				RETURN_ON_ERRORCODE(SwitchToBookAndPage(0, 0));
+				uint8_t gain{0}, volume{0};
+				RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::AGAIN, &gain, 1));
+				RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::DIG_VOL_CTRL, &volume, 1));
+				configurationLost = gain != analogGain || volume != digitalVolume;
+				if (configurationLost)
+				{
+					ESP_LOGW(TAG, "Configuration lost during suspend, reconfiguring");
+					ForgetBookAndPage();
+				}
+			}
+			if (configurationLost)
+			{
+				RETURN_ON_ERRORCODE(Configure());
+			}
+			else
+			{
+				RETURN_ON_ERRORCODE(SetControlState(CTRL_STATE::PLAY));
+			}
+			RETURN_ON_ERRORCODE(WaitForPowerState(CTRL_STATE::PLAY));
+			RETURN_ON_ERRORCODE(Mute(false));
+			suspended = false;
+			return ErrorCode::OK;
 		}
 
 		ErrorCode Init()
@@ -250,23 +625,64 @@ namespace TAS580x
 			vTaskDelay(pdMS_TO_TICKS(20));
 			PowerUp();
 			vTaskDelay(pdMS_TO_TICKS(200));
-			//set the device into HiZ state and enable DSP via the I2C control port.
-			//Wait 5ms at least. Then initialize the DSP Coefficient
-			SetControlState(CTRL_STATE::Hi_Z);
-			vTaskDelay(pdMS_TO_TICKS(10));
-			RETURN_ON_ERRORCODE(transmitRegisters(CFG::tas5805m_registers, sizeof(CFG::tas5805m_registers) / sizeof(CFG::tas5805m_registers[0])));
-			//Reset pointers to book 0, page 0, aka. the main control port...
-			RETURN_ON_ERRORCODE(SwitchToBookAndPage(0,0));
-			RETURN_ON_ERRORCODE(SetAnalogGain(16));
-			RETURN_ON_ERRORCODE(SetDigitalVolume(initialVolume));
-			RETURN_ON_ERRORCODE(SetMuteFadingTime(MuteFadingTime::_53ms));
-			//set the device to Play state.
-			SetControlState(CTRL_STATE::PLAY);
-			return ErrorCode::OK;
+			suspended = false;
+			return Configure();
+		}
+
+		// Loads all presets with the given name (typically an EQ and a DRC preset) while playing. Only the pages, whose coefficients differ
+		// from the active preset of the same kind, are written. By default, the output is soft muted around the write: the audio fades
+		// out and in with the mute fading time (53ms by default, see SetMuteFadingTime) and is silent for the I2C transfer in between
+		// (about 3ms per page of 128 coefficient bytes at 400kHz); the calling task blocks for the fade out. Without mute, the
+		// coefficients are written live: the DSP reads them while they are written, so a biquad may run for a few samples with a mix of
+		// old and new coefficients, which can click with large changes. If no page differs, nothing is written and nothing is muted;
+		// while suspended, the output is muted anyway
+		ErrorCode LoadDspPresets(const DspPreset *presets, size_t count, const char *name, bool mute = true)
+		{
+			RETURN_ON_ERRORCODE(EnsureI2CDevice());
+			mute = mute && !suspended;
+			bool muted{false};
+			bool found{false};
+			uint32_t written{0};
+			ErrorCode err{ErrorCode::OK};
+			for (size_t i = 0; i < count && err == ErrorCode::OK; i++)
+			{
+				if (strcmp(presets[i].name, name) != 0)
+				{
+					continue;
+				}
+				found = true;
+				err = TransmitPresetPages(presets[i], mute, &muted, &written);
+				if (err == ErrorCode::OK)
+				{
+					activePresets[(size_t)presets[i].kind] = &presets[i];
+				}
+				else
+				{
+					activePresets[(size_t)presets[i].kind] = nullptr; //partially written
+				}
+			}
+			RETURN_ON_ERRORCODE(SwitchToBookAndPage(0, 0));
+			if (muted)
+			{
+				RETURN_ON_ERRORCODE(Mute(false));
+			}
+			ESP_LOGI(TAG, "Loaded DSP preset %s: %lu pages written", name, written);
+			if (!found)
+			{
+				return ErrorCode::NO_CONFIGURATION_FOUND;
+			}
+			return err;
+		}
+
+		// name of the active preset of the kind; nullptr, if the coefficients of the init table are active
+		const char *GetActivePreset(PresetKind kind)
+		{
+			return activePresets[(size_t)kind] ? activePresets[(size_t)kind]->name : nullptr;
 		}
 
 		ErrorCode SetMuteFadingTime(MuteFadingTime fadingTimeMs)
 		{
+			muteFadingTime = fadingTimeMs;
 			uint8_t fade_reg = (uint8_t)fadingTimeMs;
 			fade_reg |= (fade_reg << 4);
 			RETURN_ON_ERRORCODE(EnsureI2CDevice());
@@ -276,9 +692,8 @@ namespace TAS580x
 
 		ErrorCode Mute(bool mute)
 		{
-			uint8_t mute_reg = 0;
-			RETURN_ON_ERRORCODE(EnsureI2CDevice());
-			RETURN_ON_ERRORCODE(i2c_device->ReadRegister(R::DEVICE_CTRL_2, &mute_reg, 1));
+			RETURN_ON_ERRORCODE(ReadDeviceCtrl2());
+			uint8_t mute_reg = deviceCtrl2;
 			if (mute)
 			{
 				mute_reg |= 0x8;
@@ -287,7 +702,7 @@ namespace TAS580x
 			{
 				mute_reg &= (~0x08);
 			}
-			return i2c_device->WriteRegisterU8(R::DEVICE_CTRL_2, mute_reg);
+			return WriteDeviceCtrl2(mute_reg);
 		}
 	};
 }